@@ -0,0 +1,60 @@
+#!/bin/sh
+
+# The build.sh script implements the build process for GCC or Clang on Linux
+# and other POSIX platforms. It mirrors build.cmd.
+
+ROOTDIR=$(cd "$(dirname "$0")" && pwd)
+INCLUDESDIR="$ROOTDIR/include"
+RESOURCEDIR="$ROOTDIR/res"
+SOURCESDIR="$ROOTDIR/src"
+OUTPUTDIR="$ROOTDIR/build"
+
+# Process command line arguments passed to the script.
+BUILD_CONFIGURATION=release
+for arg in "$@"; do
+    case "$arg" in
+        debug)   BUILD_CONFIGURATION=debug ;;
+        release) BUILD_CONFIGURATION=release ;;
+    esac
+done
+
+# Specify compiler settings. CXX may be set to choose the compiler.
+CXX=${CXX:-g++}
+LIBRARIES="-lpthread"
+DEFINES_COMMON="-D__STDC_FORMAT_MACROS"
+DEFINES_COMMON_DEBUG="$DEFINES_COMMON -DDEBUG -D_DEBUG"
+DEFINES_COMMON_RELEASE="$DEFINES_COMMON -DNDEBUG -D_NDEBUG"
+INCLUDES_COMMON="-I$INCLUDESDIR -I$RESOURCEDIR -I$SOURCESDIR"
+CPPFLAGS_COMMON="$INCLUDES_COMMON -std=c++14 -Wall -Wextra -Werror -Wno-unused-function -g"
+CPPFLAGS_DEBUG="$CPPFLAGS_COMMON -O0"
+CPPFLAGS_RELEASE="$CPPFLAGS_COMMON -O2"
+
+# Specify build-configuration settings.
+if [ "$BUILD_CONFIGURATION" = "release" ]; then
+    DEFINES=$DEFINES_COMMON_RELEASE
+    CPPFLAGS=$CPPFLAGS_RELEASE
+else
+    DEFINES=$DEFINES_COMMON_DEBUG
+    CPPFLAGS=$CPPFLAGS_DEBUG
+fi
+
+# Ensure that the output directory exists.
+mkdir -p "$OUTPUTDIR"
+
+# Build all of the test drivers.
+BUILD_FAILED=
+for x in "$SOURCESDIR"/*.cc; do
+    name=$(basename "$x" .cc)
+    echo "$x"
+    if ! $CXX $CPPFLAGS $DEFINES "$x" -o "$OUTPUTDIR/$name" $LIBRARIES; then
+        echo "ERROR: Build failed for $name."
+        BUILD_FAILED=1
+    fi
+done
+
+if [ -n "$BUILD_FAILED" ]; then
+    echo "BUILD FAILED."
+    exit 1
+fi
+echo "BUILD SUCCEEDED."
+exit 0
@@ -1,12 +1,548 @@
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
 #include <vector>
+#include <assert.h>
+#include <ctype.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <inttypes.h>
+#include <string.h>
 #include <time.h>
 
+#if defined(_WIN32)
 #include <Windows.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+
+/// @summary Mark a function as compiled for a specific instruction set. MSVC
+/// permits intrinsics for any ISA in any function; GCC and Clang require the
+/// target to be declared so the rest of the file can stay baseline x86-64.
+#if defined(_MSC_VER)
+#define TARGET_SSE42
+#define TARGET_AVX2
+#define TARGET_AVX512
+#else
+#define TARGET_SSE42   __attribute__((target("sse4.2,popcnt")))
+#define TARGET_AVX2    __attribute__((target("avx2,popcnt")))
+#define TARGET_AVX512  __attribute__((target("avx512f,avx2,popcnt")))
+#endif
+
+/// @summary Keep a function out of line, so that the hot loop it contains does
+/// not share the register file with its caller.
+#if defined(_MSC_VER)
+#define NOINLINE       __declspec(noinline)
+#else
+#define NOINLINE       __attribute__((noinline))
+#endif
+
+/// @summary Start a function on a 64-byte boundary, so that the placement of
+/// its loops does not depend on the size of the code before it. MSVC has no
+/// per-function equivalent.
+#if defined(_MSC_VER)
+#define CODE_ALIGN
+#else
+#define CODE_ALIGN     __attribute__((aligned(64)))
+#endif
+
+/// @summary Mark a parameter as unused on a platform path.
+#define UNUSED(x)         (void)sizeof(x)
+
+/*//////////////////////
+//  Memory Regions    //
+//////////////////////*/
+/// @summary Define how large buffers are backed by physical memory.
+enum page_policy_e
+{
+    PAGE_POLICY_SMALL                  = 0, // base pages only (4 KB on x86-64)
+    PAGE_POLICY_HUGE                   = 1, // 2 MB pages where the OS provides them
+    PAGE_POLICY_COUNT                  = 2
+};
+
+/// @summary A lookup table of strings for pretty-printing page_policy_e values.
+static char const *Page_Policy_Names[PAGE_POLICY_COUNT] =
+{
+    "small",
+    "huge"
+};
+
+/// @summary The size of a huge page, and the granularity of every region.
+static const size_t Huge_Page_Size   = 2 * 1024 * 1024;
+
+/// @summary Allocations smaller than this come from the C runtime heap; a
+/// huge page would be mostly empty.
+static const size_t Region_Min_Bytes = Huge_Page_Size;
+
+/// @summary The page policy for buffers allocated with memory_alloc(). Set
+/// once at startup, before anything is allocated.
+static page_policy_e Page_Policy     = PAGE_POLICY_HUGE;
+
+/// @summary The number of threads that first touch newly committed memory.
+/// Each touches one contiguous share, matching the contiguous partitioning
+/// of the parallel kernels, so on NUMA systems pages land on the node of the
+/// thread that will scan them.
+static size_t Page_Touch_Threads     = 1;
+
+/// @summary A reserved range of address space, of which a prefix is
+/// committed (readable and writable). Regions are always a multiple of
+/// Huge_Page_Size in size and aligned to it.
+struct memory_region_t
+{
+    uint8_t      *base;      /// The start of the reserved range, or NULL
+    size_t        reserved;  /// The number of bytes of address space reserved
+    size_t        committed; /// The number of bytes at base that are committed
+    page_policy_e policy;    /// The page policy used for the range
+    bool          locked;    /// true if backed by explicitly reserved huge pages (MAP_HUGETLB / MEM_LARGE_PAGES), fully committed
+};
+
+/// @summary Rounds a size up to a whole number of huge pages.
+/// @param bytes The size to round, in bytes.
+/// @return The rounded size, in bytes.
+static inline size_t region_round(size_t bytes)
+{
+    return (bytes + Huge_Page_Size - 1) & ~(Huge_Page_Size - 1);
+}
+
+/// @summary Writes one byte per base page of a range so that the pages are
+/// faulted in now, by Page_Touch_Threads threads each taking a contiguous
+/// share. Under a first-touch placement policy this decides each page's
+/// NUMA node, and keeps page faults out of later timed scans.
+/// @param base The start of the range, aligned to Huge_Page_Size.
+/// @param bytes The size of the range, a multiple of Huge_Page_Size.
+static void region_touch(uint8_t *base, size_t bytes)
+{
+    size_t pages   = bytes / Huge_Page_Size;
+    size_t threads = std::min(Page_Touch_Threads, pages);
+    auto   touch   = [base](size_t first, size_t count)
+    {
+        for (size_t i = first * Huge_Page_Size, n = (first + count) * Huge_Page_Size; i < n; i += 4096)
+        {
+            ((volatile uint8_t*) base)[i] = 0;
+        }
+    };
+    if (threads <= 1)
+    {
+        touch(0, pages);
+        return;
+    }
+    std::vector<std::thread> workers;
+    workers.reserve(threads - 1);
+    for (size_t t = 1; t < threads; ++t)
+    {
+        size_t first = (pages * t) / threads;
+        size_t count = (pages * (t + 1)) / threads - first;
+        workers.push_back(std::thread(touch, first, count));
+    }
+    touch(0, pages / threads);
+    for (size_t t = 0; t < workers.size(); ++t)
+    {
+        workers[t].join();
+    }
+}
+
+/// @summary Applies a page policy to a committed range of a region.
+/// @param region The region.
+/// @param offset The byte offset of the range, a multiple of Huge_Page_Size.
+/// @param bytes The size of the range, a multiple of Huge_Page_Size.
+static void region_advise(memory_region_t const *region, size_t offset, size_t bytes)
+{
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    if (!region->locked)
+    {
+        // THP may be set to 'always', so small pages must be asked for too.
+        madvise(region->base + offset, bytes, region->policy == PAGE_POLICY_HUGE ? MADV_HUGEPAGE : MADV_NOHUGEPAGE);
+    }
+#else
+    UNUSED(region);
+    UNUSED(offset);
+    UNUSED(bytes);
+#endif
+}
+
+#if !defined(_WIN32)
+/// @summary Reserves inaccessible address space aligned to Huge_Page_Size, by
+/// over-reserving one huge page and trimming both ends.
+/// @param size The number of bytes to reserve, a multiple of Huge_Page_Size.
+/// @return The start of the range, or NULL.
+static uint8_t* region_reserve_aligned(size_t size)
+{
+    uint8_t *probe = (uint8_t*) mmap(NULL, size + Huge_Page_Size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (probe == (uint8_t*) MAP_FAILED)
+    {
+        return NULL;
+    }
+    uint8_t *aligned = (uint8_t*)(((uintptr_t) probe + Huge_Page_Size - 1) & ~(uintptr_t)(Huge_Page_Size - 1));
+    if (aligned > probe)
+    {
+        munmap(probe, (size_t)(aligned - probe));
+    }
+    munmap(aligned + size, (size_t)(probe + Huge_Page_Size - aligned));
+    return aligned;
+}
+#endif
+
+/// @summary Reserves address space for a region without committing any of
+/// it. With PAGE_POLICY_HUGE, explicitly reserved huge pages are tried first
+/// (these are committed in full, since they come from a fixed pool); if none
+/// are available, the range is reserved normally and transparent huge pages
+/// are requested for it as it is committed.
+/// @param region The region to initialize.
+/// @param bytes The number of bytes to reserve, rounded up to Huge_Page_Size.
+/// @param policy The page policy for the region.
+/// @return true if the address space was reserved.
+static bool region_reserve(memory_region_t *region, size_t bytes, page_policy_e policy)
+{
+    size_t size       = region_round(bytes ? bytes : 1);
+    region->base      = NULL;
+    region->reserved  = 0;
+    region->committed = 0;
+    region->policy    = policy;
+    region->locked    = false;
+#if defined(_WIN32)
+    void *base = NULL;
+    if (policy == PAGE_POLICY_HUGE && GetLargePageMinimum() == Huge_Page_Size)
+    {
+        // requires SeLockMemoryPrivilege; fails without it.
+        base = VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+        region->locked = base != NULL;
+    }
+    if (base == NULL)
+    {
+        // reservations are 64 KB aligned; over-reserve, then reserve the aligned part.
+        uint8_t *probe = (uint8_t*) VirtualAlloc(NULL, size + Huge_Page_Size, MEM_RESERVE, PAGE_NOACCESS);
+        if (probe == NULL)
+        {
+            return false;
+        }
+        VirtualFree(probe, 0, MEM_RELEASE);
+        uint8_t *aligned = (uint8_t*)(((uintptr_t) probe + Huge_Page_Size - 1) & ~(uintptr_t)(Huge_Page_Size - 1));
+        base = VirtualAlloc(aligned, size, MEM_RESERVE, PAGE_NOACCESS);
+        if (base == NULL && (base = VirtualAlloc(NULL, size, MEM_RESERVE, PAGE_NOACCESS)) == NULL)
+        {
+            return false;
+        }
+    }
+    region->base = (uint8_t*) base;
+#else
+#if defined(MAP_HUGETLB)
+    if (policy == PAGE_POLICY_HUGE)
+    {
+        // fails cleanly, at mmap time, unless vm.nr_hugepages can cover the range.
+        void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (base != MAP_FAILED)
+        {
+            region->base   = (uint8_t*) base;
+            region->locked = true;
+        }
+    }
+#endif
+    if (region->base == NULL && (region->base = region_reserve_aligned(size)) == NULL)
+    {
+        return false;
+    }
+#endif
+    region->reserved  = size;
+    region->committed = region->locked ? size : 0;
+    return true;
+}
+
+/// @summary Commits a prefix of a region's reserved range. Newly committed
+/// pages are advised per the region's page policy; physical pages are only
+/// assigned when the memory is first touched.
+/// @param region The region to update.
+/// @param bytes The number of bytes that must be committed, rounded up to
+/// Huge_Page_Size. Must not exceed the reserved size.
+/// @return true if at least bytes are committed.
+static bool region_commit(memory_region_t *region, size_t bytes)
+{
+    size_t size = region_round(bytes);
+    if (size <= region->committed)
+    {
+        return true;
+    }
+    if (size > region->reserved)
+    {
+        return false;
+    }
+    uint8_t *start = region->base + region->committed;
+    size_t   grow  = size - region->committed;
+#if defined(_WIN32)
+    if (VirtualAlloc(start, grow, MEM_COMMIT, PAGE_READWRITE) == NULL)
+    {
+        return false;
+    }
+#else
+    if (mprotect(start, grow, PROT_READ | PROT_WRITE) != 0)
+    {
+        return false;
+    }
+#endif
+    region_advise(region, region->committed, grow);
+    region->committed = size;
+    return true;
+}
+
+/// @summary Releases a region's address space and any committed memory.
+/// @param region The region to release.
+static void region_release(memory_region_t *region)
+{
+    if (region->base != NULL)
+    {
+#if defined(_WIN32)
+        VirtualFree(region->base, 0, MEM_RELEASE);
+#else
+        munmap(region->base, region->reserved);
+#endif
+    }
+    region->base      = NULL;
+    region->reserved  = 0;
+    region->committed = 0;
+}
+
+/// @summary Allocates a buffer. Buffers of at least Region_Min_Bytes get a
+/// committed region of their own, using Page_Policy.
+/// @param bytes The size of the buffer, in bytes.
+/// @return The buffer, or NULL. Free with memory_free().
+static void* memory_alloc(size_t bytes)
+{
+    if (bytes < Region_Min_Bytes)
+    {
+        return malloc(bytes ? bytes : 1);
+    }
+    memory_region_t region;
+    if (!region_reserve(&region, bytes, Page_Policy) || !region_commit(&region, bytes))
+    {
+        region_release(&region);
+        return NULL;
+    }
+    return region.base;
+}
+
+/// @summary Frees a buffer allocated with memory_alloc() or memory_resize().
+/// @param buffer The buffer to free, or NULL.
+/// @param bytes The size the buffer was allocated with, in bytes.
+static void memory_free(void *buffer, size_t bytes)
+{
+    if (buffer == NULL)
+    {
+        return;
+    }
+    if (bytes < Region_Min_Bytes)
+    {
+        free(buffer);
+        return;
+    }
+    memory_region_t region;
+    region.base      = (uint8_t*) buffer;
+    region.reserved  = region_round(bytes);
+    region.committed = region.reserved;
+    region_release(&region);
+}
+
+/// @summary First touches the pages of a buffer from Page_Touch_Threads
+/// threads; see region_touch(). Use for buffers that the parallel kernels
+/// scan. Heap buffers are left alone.
+/// @param buffer The buffer, allocated with memory_alloc().
+/// @param bytes The size the buffer was allocated with, in bytes.
+static void memory_touch(void *buffer, size_t bytes)
+{
+    if (buffer != NULL && bytes >= Region_Min_Bytes)
+    {
+        region_touch((uint8_t*) buffer, region_round(bytes));
+    }
+}
+
+/// @summary Resizes a buffer allocated with memory_alloc(), preserving its
+/// contents up to the smaller of the two sizes. A buffer that stays in a
+/// region grows in place or is remapped; only a move between the heap and a
+/// region copies.
+/// @param buffer The buffer to resize, or NULL.
+/// @param old_bytes The current size of the buffer, in bytes.
+/// @param new_bytes The new size of the buffer, in bytes.
+/// @return The resized buffer, or NULL if it could not be resized; buffer is
+/// then unchanged.
+static void* memory_resize(void *buffer, size_t old_bytes, size_t new_bytes)
+{
+    if (buffer == NULL)
+    {
+        return memory_alloc(new_bytes);
+    }
+    if (old_bytes < Region_Min_Bytes && new_bytes < Region_Min_Bytes)
+    {
+        return realloc(buffer, new_bytes ? new_bytes : 1);
+    }
+    if (old_bytes >= Region_Min_Bytes && new_bytes >= Region_Min_Bytes)
+    {
+        memory_region_t region;
+        region.base      = (uint8_t*) buffer;
+        region.reserved  = region_round(old_bytes);
+        region.committed = region.reserved;
+        region.policy    = Page_Policy;
+        region.locked    = false;
+        if (region_round(new_bytes) == region.reserved)
+        {
+            return buffer;
+        }
+#if defined(__linux__)
+        if (region_round(new_bytes) < region.reserved)
+        {
+            munmap(region.base + region_round(new_bytes), region.reserved - region_round(new_bytes));
+            return buffer;
+        }
+        // the mapping is sized exactly, so memory_free() can recompute its size.
+        // grow in place if the address space after it is free; otherwise move
+        // the pages to a new 2 MB aligned reservation, since a kernel-chosen
+        // address would break the huge page alignment.
+        void *base = mremap(region.base, region.reserved, region_round(new_bytes), 0);
+        if (base == MAP_FAILED)
+        {
+            uint8_t *target = region_reserve_aligned(region_round(new_bytes));
+            if (target != NULL)
+            {
+                base = mremap(region.base, region.reserved, region_round(new_bytes), MREMAP_MAYMOVE | MREMAP_FIXED, target);
+                if (base == MAP_FAILED)
+                {
+                    munmap(target, region_round(new_bytes));
+                }
+            }
+        }
+        if (base != MAP_FAILED)
+        {
+            region.base      = (uint8_t*) base;
+            region.reserved  = region_round(new_bytes);
+            region_advise(&region, region.committed, region.reserved - region.committed);
+            return base;
+        }
+#endif
+    }
+    void *moved = memory_alloc(new_bytes);
+    if (moved != NULL)
+    {
+        memcpy(moved, buffer, std::min(old_bytes, new_bytes));
+        memory_free(buffer, old_bytes);
+    }
+    return moved;
+}
+
+/// @summary A bump allocator over a single region, for buffers that are
+/// allocated together and freed together, such as the columns of a record
+/// store. Memory is committed as allocations reach it.
+struct memory_arena_t
+{
+    memory_region_t region;  /// The region allocations are carved from
+    size_t          used;    /// The number of bytes allocated from the region
+};
+
+/// @summary Initializes an arena, reserving its address space.
+/// @param arena The arena to initialize. Free with arena_free().
+/// @param capacity The maximum number of bytes the arena can hand out.
+/// @param policy The page policy for the arena.
+/// @return true if the address space was reserved.
+static bool arena_init(memory_arena_t *arena, size_t capacity, page_policy_e policy)
+{
+    arena->used = 0;
+    return region_reserve(&arena->region, capacity, policy);
+}
+
+/// @summary Allocates from an arena. The memory is zero-filled.
+/// @param arena The arena.
+/// @param bytes The number of bytes to allocate.
+/// @param alignment The required alignment, a power of two.
+/// @return The allocation, or NULL if the arena's reservation is exhausted.
+static void* arena_alloc(memory_arena_t *arena, size_t bytes, size_t alignment = 64)
+{
+    size_t offset = (arena->used + alignment - 1) & ~(alignment - 1);
+    if (offset + bytes > arena->region.reserved || !region_commit(&arena->region, offset + bytes))
+    {
+        return NULL;
+    }
+    arena->used = offset + bytes;
+    return arena->region.base + offset;
+}
+
+/// @summary Releases an arena and every allocation made from it.
+/// @param arena The arena to free.
+static void arena_free(memory_arena_t *arena)
+{
+    region_release(&arena->region);
+    arena->used = 0;
+}
+
+/// @summary A standard library allocator over memory_alloc(), so containers
+/// such as the record array get region backing. Elements constructed without
+/// arguments are default-initialized rather than zeroed, so a resize() does
+/// not follow the parallel first touch in allocate() with a serial pass over
+/// every page.
+template <typename T>
+struct region_allocator_t
+{
+    typedef T value_type;
+
+    region_allocator_t(void)
+    { /* empty */ }
+
+    template <typename U>
+    region_allocator_t(region_allocator_t<U> const &)
+    { /* empty */ }
+
+    T* allocate(size_t n)
+    {
+        T *p = (T*) memory_alloc(n * sizeof(T));
+        if (p == NULL) throw std::bad_alloc();
+        memory_touch(p, n * sizeof(T));
+        return p;
+    }
+
+    void deallocate(T *p, size_t n)
+    {
+        memory_free(p, n * sizeof(T));
+    }
+
+    template <typename U>
+    void construct(U *p)
+    {
+        ::new ((void*) p) U;
+    }
+
+    template <typename U, typename... Args>
+    void construct(U *p, Args&&... args)
+    {
+        ::new ((void*) p) U(std::forward<Args>(args)...);
+    }
+
+    template <typename U>
+    struct rebind { typedef region_allocator_t<U> other; };
+};
+
+template <typename T, typename U>
+static inline bool operator == (region_allocator_t<T> const &, region_allocator_t<U> const &) { return true; }
+
+template <typename T, typename U>
+static inline bool operator != (region_allocator_t<T> const &, region_allocator_t<U> const &) { return false; }
 
 /// @summary Define the possible values that can appear in a condition table.
 enum rule_e
@@ -24,7 +560,18 @@ enum bit_ids_e
     LOAN_LT_SALARY                     = 2, // loan amount <  annual salary?
     LOAN_GE_SALARY                     = 3, // loan amount >= annual salary?
     EXISTING_OWNER                     = 4, // owns another home?
-    MAX_BITS                           = 32 // the maximum number of bits in a bitfield
+    MAX_BITS                           = 32 // the maximum number of bits in a 32-bit bitfield; see bits_width
+};
+
+/// @summary The names used by condition table files for each bit_ids_e value.
+static const size_t  Condition_Name_Count = 5;
+static char const   *Condition_Names[Condition_Name_Count] =
+{
+    "address_proof",  // PROOF_OF_ADDRESS
+    "identity_proof", // PROOF_OF_IDENTITY
+    "loan_lt_salary", // LOAN_LT_SALARY
+    "loan_ge_salary", // LOAN_GE_SALARY
+    "home_owner"      // EXISTING_OWNER
 };
 
 /// @summary Bitflags indicating how a piece of information was verified.
@@ -60,6 +607,26 @@ struct record_t
     // ...
 };
 
+/// @summary Stores records in 'structure of arrays' form. Each field is held
+/// in its own contiguous column; boolean fields, and the NULL-ness of the
+/// address and identity strings, are bit-packed 64 records to a word. Only
+/// the data needed to evaluate the predicates is kept, about 10.4 bytes per
+/// record versus sizeof(record_t).
+struct record_store_t
+{
+    size_t       count;           /// The number of records in the store
+    size_t       capacity;        /// The number of records the columns can hold
+    id_t        *id;              /// The unique identifier of each record
+    uint32_t    *annual_salary;   /// The annual salary of each applicant, in whole dollars
+    uint32_t    *loan_amount;     /// The requested loan amount, in whole dollars
+    uint8_t     *verify_address;  /// Combination of verification_method_e for the address
+    uint8_t     *verify_identity; /// Combination of verification_method_e for the identity
+    uint64_t    *owns_other_home; /// Bit set if the applicant owns another home
+    uint64_t    *address_valid;   /// Bit set if the record's address is non-NULL
+    uint64_t    *identity_valid;  /// Bit set if the record's identity is non-NULL
+    memory_arena_t arena;         /// The region holding every column, if allocated by record_store_init
+};
+
 /// @summary Represents a growable list of IDs.
 struct table_t
 {
@@ -68,14 +635,44 @@ struct table_t
     id_t        *storage;
 };
 
+/// @summary A 128-bit bitfield, for condition tables with more than 64 rows.
+/// Bit i is bit (i % 64) of 64-bit lane (i / 64).
+struct bits128_t
+{
+    __m128i      v[1];
+};
+
+/// @summary A 256-bit bitfield, for condition tables with more than 128 rows.
+/// Bit i is bit (i % 64) of 64-bit lane (i / 64), across the two registers.
+struct bits256_t
+{
+    __m128i      v[2];
+};
+
+/// @summary Provides the number of bits in each supported bitfield type.
+template <typename bits_t> struct bits_width;
+template <> struct bits_width<uint32_t>  { static const size_t value =  32; };
+template <> struct bits_width<uint64_t>  { static const size_t value =  64; };
+template <> struct bits_width<bits128_t> { static const size_t value = 128; };
+template <> struct bits_width<bits256_t> { static const size_t value = 256; };
+
+/// @summary The number of bits in the widest supported bitfield type.
+static const size_t Max_Bitfield_Width = 256;
+
 /// @summary Stores a collection of bits generated from a single column of the
 /// condition table. These values are generated as a preprocessing step.
-struct query_mask_t
+/// bits_t is one of uint32_t, uint64_t, bits128_t or bits256_t.
+template <typename bits_t>
+struct query_mask_base_t
 {
-    uint32_t     bits_false;  /// bit set if condition table entry is CONDITION_FALSE; xor'd
-    uint32_t     bits_ignore; /// bit set if condition table entry is CONDITION_NULL; or'd
+    bits_t       bits_false;  /// bit set if condition table entry is CONDITION_FALSE; xor'd
+    bits_t       bits_ignore; /// bit set if condition table entry is CONDITION_NULL; or'd
 };
 
+/// @summary The query mask for condition tables of up to 32 rows, used by the
+/// SIMD, parallel and lookup table classifiers.
+typedef query_mask_base_t<uint32_t> query_mask_t;
+
 /**
 Our condition table is defined as follows:
 
@@ -100,7 +697,7 @@ table above.
 static const size_t Table_Rows  = 5;
 static const size_t Table_Cols  = 5;
 static query_mask_t Table_Mask[Table_Cols];
-static const rule_e Condition_Table[Table_Cols][Table_Rows] =
+static constexpr rule_e Condition_Table[Table_Cols][Table_Rows] =
 {
     { CONDITION_FALSE, CONDITION_NULL , CONDITION_NULL, CONDITION_NULL, CONDITION_NULL }, /* => REJECT    */
     { CONDITION_NULL , CONDITION_FALSE, CONDITION_NULL, CONDITION_NULL, CONDITION_NULL }, /* => REJECT    */
@@ -109,6 +706,26 @@ static const rule_e Condition_Table[Table_Cols][Table_Rows] =
     { CONDITION_TRUE , CONDITION_TRUE , CONDITION_NULL, CONDITION_TRUE, CONDITION_NULL }  /* => MANUAL    */
 };
 
+/// @summary Define the actions taken by the columns of Condition_Table.
+enum action_e
+{
+    ACTION_REJECT                      = 0, // the application is rejected
+    ACTION_MANUAL                      = 1, // the application is reviewed by hand
+    ACTION_IMMEDIATE                   = 2, // the application is approved immediately
+    ACTION_COUNT                       = 3
+};
+
+/// @summary The action of each column of Condition_Table. Adjacent columns
+/// with the same action write the same output table.
+static constexpr action_e Condition_Actions[Table_Cols] =
+{
+    ACTION_REJECT,
+    ACTION_REJECT,
+    ACTION_IMMEDIATE,
+    ACTION_IMMEDIATE,
+    ACTION_MANUAL
+};
+
 /// @summary A list of sample addresses. NULL is considered to be invalid.
 static const size_t  Address_Count = 10;
 static char const   *Address_List[Address_Count] =
@@ -151,17 +768,11 @@ static const verification_method_e Verification_Methods[] =
     VERIFICATION_METHOD_UTILITY
 };
 
-/// @summary A lookup table of strings for pretty-printing verification methods.
-static char const *Verification_Method_Names[VERIFICATION_METHOD_COUNT] =
-{
-    "VERIFICATION_METHOD_NONE",
-    "VERIFICATION_METHOD_STATE_ID",
-    "VERIFICATION_METHOD_PASSPORT",
-    "VERIFICATION_METHOD_UTILITY"
-};
-
 /// @summary Our record set, in traditional array-of-structures format.
-static std::vector<record_t> Records;
+static std::vector<record_t, region_allocator_t<record_t> > Records;
+
+/// @summary Our record set, in structure-of-arrays format.
+static record_store_t Record_Store;
 
 /// @summary A table used to store all generated identifiers.
 static table_t All_IDs;
@@ -171,55 +782,6 @@ static table_t Output_Immediate;
 static table_t Output_Manual;
 static table_t Output_Reject;
 
-/// @summary Generate a random value in the range [min, max] (inclusive).
-/// @param min The inclusive lower-bound of the range.
-/// @param max The inclusive upper-bound of the range.
-/// @return A value in the range [min, max].
-static inline uint32_t rand_range(uint32_t min, uint32_t max)
-{
-    // from http://c-faq.com/lib/randrange.html
-    // we don't particularly care about quality randomness, so rand().
-    return uint32_t(min + rand() / (RAND_MAX / (max - min + 1) + 1));
-}
-
-/// @summary Generates random verification flags.
-/// @return A combination of verification_method_e.
-static inline uint32_t gen_verifyflags(void)
-{
-    uint32_t flags  = VERIFICATION_METHOD_NONE;
-    uint32_t count  = rand_range(0, VERIFICATION_METHOD_COUNT - 1);
-    for (uint32_t i = 0; i < count; ++i)
-    {
-        uint32_t number = rand_range(0, VERIFICATION_METHOD_COUNT - 1);
-        flags |= Verification_Methods[number];
-    }
-    return flags;
-}
-
-/// @summary Selects a random item from the Address_List.
-/// @return A NULL-terminated string literal, or NULL.
-static inline char const* gen_address(void)
-{
-    uint32_t number = rand_range(0, Address_Count - 1);
-    return Address_List[number];
-}
-
-/// @summary Selects a random item from the Identity_List.
-/// @return A NULL-terminated string literal, or NULL.
-static inline char const* gen_identity(void)
-{
-    uint32_t number = rand_range(0, Identity_Count - 1);
-    return Identity_List[number];
-}
-
-/// @summary Randomly chooses a boolean value.
-/// @return Either true or false.
-static inline bool gen_boolean(void)
-{
-    uint32_t number  = rand_range(0, 1);
-    return  (number) ? true : false;
-}
-
 /// @summary Implements the business logic to determine whether an applicant's
 /// supplied address has been verified and properly entered.
 /// @param address A NULL-terminated string specifying the applicant's address.
@@ -287,6 +849,26 @@ static inline bool existing_homeowner(bool owns_other_home)
     return owns_other_home;
 }
 
+/// @summary Branch-free equivalent of has_proof_of_address() for columnar data.
+/// @param valid One if the address is non-NULL, or zero.
+/// @param flags The set of verification_method_e indicating how the data was verified.
+/// @return One if the applicant has supplied verified proof of address, or zero.
+static inline uint32_t proof_of_address_bit(uint32_t valid, uint32_t flags)
+{
+    // a utility bill only counts alongside another method, so it suffices
+    // for any method other than a utility bill to be present.
+    return valid & (uint32_t)((flags & ~uint32_t(VERIFICATION_METHOD_UTILITY)) != 0);
+}
+
+/// @summary Branch-free equivalent of has_proof_of_identity() for columnar data.
+/// @param valid One if the identity is non-NULL, or zero.
+/// @param flags The set of verification_method_e indicating how the data was verified.
+/// @return One if the applicant has supplied verified proof of identity, or zero.
+static inline uint32_t proof_of_identity_bit(uint32_t valid, uint32_t flags)
+{
+    return valid & (uint32_t)(flags != VERIFICATION_METHOD_NONE) & (uint32_t)(flags != VERIFICATION_METHOD_UTILITY);
+}
+
 /// @summary Sets a bit based on a boolean value.
 /// @param condition The boolean value used to set or clear the specified bit.
 /// @param bit_index The zero-based index of the bit to set if condition is true.
@@ -296,65 +878,90 @@ static inline uint32_t bit(bool condition, int bit_index)
     return condition ? (1U << bit_index) : 0;
 }
 
-/// @summary Generates a record with randomly selected data.
-/// @param rec The record to populate.
-static void make_record(record_t *rec)
+/// @summary Clears all bits in a bitfield.
+/// @param b The bitfield to clear.
+static inline void bits_zero(uint32_t *b) { *b = 0; }
+static inline void bits_zero(uint64_t *b) { *b = 0; }
+template <typename bits_t>
+static inline void bits_zero(bits_t *b)
 {
-    if (rec)
+    for (size_t k = 0; k < sizeof(b->v) / sizeof(b->v[0]); ++k)
     {
-        rec->id              = Next_ID++;
-        rec->address         = gen_address();
-        rec->identity        = gen_identity();
-        rec->owns_other_home = gen_boolean();
-        rec->annual_salary   = rand_range(10000U, 250000U);
-        rec->loan_amount     = rand_range(1000U , 500000U);
-        rec->verify_address  = gen_verifyflags();
-        rec->verify_identity = gen_verifyflags();
+        b->v[k] = _mm_setzero_si128();
     }
 }
 
-/// @summary Pretty-print verification method(s).
-/// @param flags A combination of zero or more verification_method_e flags.
-static void print_verifyflags(uint32_t flags)
+/// @summary Sets a single bit in a bitfield. Intended for preprocessing, not
+/// for use in inner loops.
+/// @param b The bitfield to update.
+/// @param bit_index The zero-based index of the bit to set.
+static inline void bits_set(uint32_t *b, size_t bit_index) { *b |= 1U   << bit_index; }
+static inline void bits_set(uint64_t *b, size_t bit_index) { *b |= 1ULL << bit_index; }
+template <typename bits_t>
+static inline void bits_set(bits_t *b, size_t bit_index)
 {
-    if (flags == VERIFICATION_METHOD_NONE)
-    {
-        printf("%s\n", Verification_Method_Names[0]);
-        return;
-    }
-    for (size_t i = 1; i < VERIFICATION_METHOD_COUNT; ++i)
+    uint64_t words[sizeof(bits_t) / sizeof(uint64_t)];
+    memcpy(words, b, sizeof(bits_t));
+    words[bit_index / 64] |= 1ULL << (bit_index % 64);
+    memcpy(b, words, sizeof(bits_t));
+}
+
+/// @summary Replaces the low 32 bits of a bitfield, clearing the rest.
+/// @param b The bitfield to update.
+/// @param value The value to store in bits [0, 32).
+static inline void bits_assign_low(uint32_t *b, uint32_t value) { *b = value; }
+static inline void bits_assign_low(uint64_t *b, uint32_t value) { *b = value; }
+template <typename bits_t>
+static inline void bits_assign_low(bits_t *b, uint32_t value)
+{
+    bits_zero(b);
+    b->v[0] = _mm_cvtsi32_si128((int32_t) value);
+}
+
+/// @summary Computes (a ^ x) | y, which has all bits set if the conditions
+/// encoded by a query mask (x = bits_false, y = bits_ignore) are met by a.
+/// @return The met bits.
+static inline uint32_t bits_met(uint32_t a, uint32_t x, uint32_t y) { return (a ^ x) | y; }
+static inline uint64_t bits_met(uint64_t a, uint64_t x, uint64_t y) { return (a ^ x) | y; }
+template <typename bits_t>
+static inline bits_t bits_met(bits_t const &a, bits_t const &x, bits_t const &y)
+{
+    bits_t r;
+    for (size_t k = 0; k < sizeof(a.v) / sizeof(a.v[0]); ++k)
     {
-        if (flags & Verification_Methods[i])
-        {
-            printf("%s", Verification_Method_Names[i]);
-            flags &= ~Verification_Methods[i];
-            if (flags != 0)
-            {
-                printf(", ");
-            }
-            else break;
-        }
+        r.v[k] = _mm_or_si128(_mm_xor_si128(a.v[k], x.v[k]), y.v[k]);
     }
-    printf("\n");
+    return r;
 }
 
-/// @summary Print a record to stdout.
-/// @param rec The record to print.
-static void print_record(record_t const *rec)
+/// @summary Reduces a bitfield to a single value indicating whether every bit is set.
+/// @param b The bitfield to test.
+/// @return One if all bits of b are set, or zero.
+static inline uint32_t bits_all_set(uint32_t b)
 {
-    printf("ID:                    0x%08X\n", rec->id);
-    printf("Address:               %s\n", rec->address);
-    printf("Address Verification:  "); print_verifyflags(rec->verify_address);
-    printf("Identity:              %s\n", rec->identity);
-    printf("Identity Verification: "); print_verifyflags(rec->verify_identity);
-    printf("Existing:              %d\n", (int) rec->owns_other_home);
-    printf("Salary:                %u\n", rec->annual_salary);
-    printf("Loan Amount:           %u\n", rec->loan_amount);
-    printf("\n");
+    uint32_t czero = (b + 1);                 // all bits clear if all bits set
+    return ~(czero | -czero) >> 31;           // one if all bits set, else zero
+}
+static inline uint32_t bits_all_set(uint64_t b)
+{
+    uint64_t czero = (b + 1);
+    return (uint32_t)(~(czero | -czero) >> 63);
+}
+template <typename bits_t>
+static inline uint32_t bits_all_set(bits_t const &b)
+{
+    // AND the 128-bit lanes together, then test all 16 bytes with one compare.
+    __m128i acc = b.v[0];
+    for (size_t k = 1; k < sizeof(b.v) / sizeof(b.v[0]); ++k)
+    {
+        acc = _mm_and_si128(acc, b.v[k]);
+    }
+    int all = _mm_movemask_epi8(_mm_cmpeq_epi8(acc, _mm_set1_epi32(-1)));
+    return (uint32_t)(all + 1) >> 16;        // one if all == 0xFFFF, else zero
 }
 
 /// @summary Initializes an output table, allocating storage space for the
-/// specified number of items.
+/// specified number of items. Large tables are backed by memory regions.
 /// @param table The table to initialize.
 /// @param capacity The initial capacity.
 static void table_init(table_t *table, uint32_t capacity=0)
@@ -366,7 +973,7 @@ static void table_init(table_t *table, uint32_t capacity=0)
         table->storage  = NULL;
         if (capacity)
         {
-            table->storage = (id_t*) malloc(capacity * sizeof(id_t));
+            table->storage = (id_t*) memory_alloc(capacity * sizeof(id_t));
         }
     }
 }
@@ -379,7 +986,7 @@ static void table_free(table_t *table)
     {
         if (table->storage)
         {
-            free(table->storage);
+            memory_free(table->storage, table->capacity * sizeof(id_t));
         }
         table->count    = 0;
         table->capacity = 0;
@@ -394,22 +1001,26 @@ static void table_clear(table_t *table)
     table->count = 0;
 }
 
+/// @summary Doubles the capacity of a table, starting from 64 items for a
+/// table initialized empty.
+/// @param table The table to grow.
+static void table_grow(table_t *table)
+{
+    size_t m = table->capacity ? table->capacity * 2 : 64;
+    table->storage  = (id_t*) memory_resize(table->storage, table->capacity * sizeof(id_t), m * sizeof(id_t));
+    table->capacity = m;
+}
+
 /// @summary Appends an ID to the table, growing if necessary.
 /// @param table The table to update.
 /// @param id The ID to append.
 static void table_put(table_t *table, id_t id)
 {
-    if (table->count < table->capacity)
-    {
-        table->storage[table->count++] = id;
-    }
-    else
+    if (table->count == table->capacity)
     {
-        uint32_t m     = (uint32_t)(table->capacity * 2);
-        table->storage = (id_t*) realloc(table->storage, m * sizeof(id_t));
-        table->storage[table->count++] = id;
-        table->capacity = m;
+        table_grow(table);
     }
+    table->storage[table->count++] = id;
 }
 
 /// @summary Speculatively appends an item to the table, growing if necessary.
@@ -425,71 +1036,331 @@ static void table_put_speculative(table_t *table, id_t id, uint32_t count)
     }
     else if (count)
     {
-        uint32_t m     =(uint32_t)(table->capacity * 2);
-        table->storage = (id_t*) realloc(table->storage, m * sizeof(id_t));
+        table_grow(table);
         table->storage[table->count++] = id;
-        table->capacity = m;
     }
 }
 
-/// @summary Generates bitfields using an array of structures data source.
-/// @param dst The destination bitfields, of at least count elements.
-/// @param src The array of source records, of at least count elements.
-/// @param count The number of items to read from src and write to dst.
-static void generate_bitfields(uint32_t *dst, record_t const *src, size_t count)
+/// @summary Ensures that a table can store at least the specified number of
+/// items without reallocating. Existing items are preserved.
+/// @param table The table to update.
+/// @param capacity The minimum number of items the table must be able to store.
+static void table_reserve(table_t *table, size_t capacity)
 {
-    for (size_t i = 0; i < count; ++i)
+    if (table->capacity < capacity)
     {
-        uint32_t bits  = 0;
-
-        if (has_proof_of_address(src[i].address, src[i].verify_address))
-        {
-            bits |= 1U << PROOF_OF_ADDRESS;
-        }
-        if (has_proof_of_identity(src[i].identity, src[i].verify_identity))
+        size_t m = table->capacity ? table->capacity * 2 : 64;
+        while (m < capacity)
         {
-            bits |= 1U << PROOF_OF_IDENTITY;
+            m *= 2;
         }
-        if (loan_amount_less_than_salary(src[i].loan_amount, src[i].annual_salary))
-        {
-            bits |= 1U << LOAN_LT_SALARY;
+        table->storage  = (id_t*) memory_resize(table->storage, table->capacity * sizeof(id_t), m * sizeof(id_t));
+        table->capacity = m;
+    }
+}
+
+/// @summary Replaces the contents of one table with the contents of another.
+/// @param dst The table to overwrite.
+/// @param src The table to copy.
+static void table_copy(table_t *dst, table_t const *src)
+{
+    table_reserve(dst, src->count);
+    if (src->count)
+    {
+        memcpy(dst->storage, src->storage, src->count * sizeof(id_t));
+    }
+    dst->count = src->count;
+}
+
+/// @summary Determines whether two tables contain the same IDs in the same order.
+/// @param a The first table to compare.
+/// @param b The second table to compare.
+/// @return true if the tables are identical.
+static bool table_equal(table_t const *a, table_t const *b)
+{
+    if (a->count != b->count)
+    {
+        return false;
+    }
+    if (a->count == 0)
+    {
+        return true;
+    }
+    return memcmp(a->storage, b->storage, a->count * sizeof(id_t)) == 0;
+}
+
+/// @summary Generates bitfields using an array of structures data source.
+/// @param dst The destination bitfields, of at least count elements.
+/// @param src The array of source records, of at least count elements.
+/// @param count The number of items to read from src and write to dst.
+template <typename bits_t>
+static void generate_bitfields(bits_t *dst, record_t const *src, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        bits_t bits;
+        bits_zero(&bits);
+
+        if (has_proof_of_address(src[i].address, src[i].verify_address))
+        {
+            bits_set(&bits, PROOF_OF_ADDRESS);
+        }
+        if (has_proof_of_identity(src[i].identity, src[i].verify_identity))
+        {
+            bits_set(&bits, PROOF_OF_IDENTITY);
+        }
+        if (loan_amount_less_than_salary(src[i].loan_amount, src[i].annual_salary))
+        {
+            bits_set(&bits, LOAN_LT_SALARY);
         }
         if (loan_amount_greater_or_equal_salary(src[i].loan_amount, src[i].annual_salary))
         {
-            bits |= 1U << LOAN_GE_SALARY;
+            bits_set(&bits, LOAN_GE_SALARY);
         }
         if (existing_homeowner(src[i].owns_other_home))
         {
-            bits |= 1U << EXISTING_OWNER;
+            bits_set(&bits, EXISTING_OWNER);
         }
 
         dst[i] = bits;
     }
 }
 
+/// @summary Initializes a record store, allocating storage for the specified
+/// number of records. The columns are carved from a single arena, so they
+/// share huge pages and are released together.
+/// @param store The record store to initialize.
+/// @param capacity The initial capacity, in records.
+static void record_store_init(record_store_t *store, size_t capacity)
+{
+    size_t words = (capacity + 63) / 64;
+    size_t bytes = capacity * (sizeof(id_t) + 2 * sizeof(uint32_t) + 2 * sizeof(uint8_t)) + 3 * words * sizeof(uint64_t) + 8 * 64;
+    store->count           = 0;
+    store->capacity        = capacity;
+    arena_init(&store->arena, bytes, Page_Policy);
+    store->id              = (id_t    *) arena_alloc(&store->arena, capacity * sizeof(id_t));
+    store->annual_salary   = (uint32_t*) arena_alloc(&store->arena, capacity * sizeof(uint32_t));
+    store->loan_amount     = (uint32_t*) arena_alloc(&store->arena, capacity * sizeof(uint32_t));
+    store->verify_address  = (uint8_t *) arena_alloc(&store->arena, capacity * sizeof(uint8_t));
+    store->verify_identity = (uint8_t *) arena_alloc(&store->arena, capacity * sizeof(uint8_t));
+    store->owns_other_home = (uint64_t*) arena_alloc(&store->arena, words * sizeof(uint64_t));
+    store->address_valid   = (uint64_t*) arena_alloc(&store->arena, words * sizeof(uint64_t));
+    store->identity_valid  = (uint64_t*) arena_alloc(&store->arena, words * sizeof(uint64_t));
+    // the bitmaps are zero: the arena's memory is freshly committed.
+    memory_touch(store->arena.region.base, store->arena.region.committed);
+}
+
+/// @summary Frees the storage associated with a record store.
+/// @param store The record store to free.
+static void record_store_free(record_store_t *store)
+{
+    arena_free(&store->arena);
+    memset(store, 0, sizeof(record_store_t));
+}
+
+/// @summary Sets or clears a single bit in a bitmap.
+/// @param bitmap The bitmap to update.
+/// @param index The zero-based index of the bit.
+/// @param value The new value of the bit.
+static inline void bitmap_assign(uint64_t *bitmap, size_t index, bool value)
+{
+    uint64_t bit = 1ULL << (index & 63);
+    if (value) bitmap[index >> 6] |=  bit;
+    else       bitmap[index >> 6] &= ~bit;
+}
+
+/// @summary Reads a single bit from a bitmap.
+/// @param bitmap The bitmap to read.
+/// @param index The zero-based index of the bit.
+/// @return One if the bit is set, or zero.
+static inline uint32_t bitmap_get(uint64_t const *bitmap, size_t index)
+{
+    return (uint32_t)(bitmap[index >> 6] >> (index & 63)) & 1;
+}
+
+/// @summary Stores a record at a given position in a record store. The store
+/// count is not modified.
+/// @param store The record store to update.
+/// @param index The zero-based index of the record, less than the capacity.
+/// @param rec The record to store.
+static void record_store_set(record_store_t *store, size_t index, record_t const *rec)
+{
+    store->id[index]              = rec->id;
+    store->annual_salary[index]   = rec->annual_salary;
+    store->loan_amount[index]     = rec->loan_amount;
+    store->verify_address[index]  = (uint8_t) rec->verify_address;  // flags use the low 3 bits
+    store->verify_identity[index] = (uint8_t) rec->verify_identity;
+    bitmap_assign(store->owns_other_home, index, rec->owns_other_home);
+    bitmap_assign(store->address_valid  , index, rec->address  != NULL);
+    bitmap_assign(store->identity_valid , index, rec->identity != NULL);
+}
+
+/// @summary Builds a record store from an array of records. Any existing
+/// contents of the store are replaced.
+/// @param store The record store to populate. It is (re)initialized.
+/// @param records The array of source records, of at least count elements.
+/// @param count The number of records to convert.
+static void record_store_build(record_store_t *store, record_t const *records, size_t count)
+{
+    if (store->capacity < count)
+    {
+        record_store_free(store);
+        record_store_init(store, count);
+    }
+    for (size_t i = 0; i < count; ++i)
+    {
+        record_store_set(store, i, &records[i]);
+    }
+    store->count = count;
+}
+
+/// @summary Returns the number of bytes per record read by generate_bitfields()
+/// from a record store, excluding the ID column.
+/// @return The average number of bytes read per record.
+static double record_store_bytes_per_record(void)
+{
+    return double(2 * sizeof(uint32_t) + 2 * sizeof(uint8_t)) + 3.0 / 8.0;
+}
+
+/// @summary The number of records whose condition bits can be summed in the
+/// 16-bit fields of one 64-bit value before a field overflows.
+static const size_t Bit_Count_Block = 65535;
+
+/// @summary The multiplier that gathers the counted condition bits of one
+/// record, held one per 16-bit field as generate_bitfields_store() sums them,
+/// into bit 48 plus their bitfield positions. Field f is shifted by 48 plus its
+/// condition's position minus 16 * f. The subtracted term places the negated
+/// LOAN_LT_SALARY bit at the LOAN_GE_SALARY position.
+static const uint64_t Bit_Gather_Multiplier =
+    ((1ULL << (48 + PROOF_OF_ADDRESS  -  0)) |
+     (1ULL << (48 + PROOF_OF_IDENTITY - 16)) |
+     (1ULL << (48 + LOAN_LT_SALARY    - 32)) |
+     (1ULL << (48 + EXISTING_OWNER    - 48))) - (1ULL << (48 + LOAN_GE_SALARY - 32));
+
+/// @summary The value added to the gathered product. The LOAN_GE_SALARY bit
+/// turns the negated LOAN_LT_SALARY bit into its complement, and bit 47 absorbs
+/// the borrows of the products that land below bit 48.
+static const uint64_t Bit_Gather_Bias = (1ULL << (48 + LOAN_GE_SALARY)) | (1ULL << 47);
+
+/// @summary Computes the bitfield of a record from its counted condition bits.
+/// @param fields The PROOF_OF_ADDRESS, PROOF_OF_IDENTITY, LOAN_LT_SALARY and
+/// EXISTING_OWNER bits in the 16-bit fields of one value, lowest first.
+/// @return The bitfield, with LOAN_GE_SALARY set if LOAN_LT_SALARY is clear.
+static constexpr uint32_t gather_condition_bits(uint64_t fields)
+{
+    return uint32_t((fields * Bit_Gather_Multiplier + Bit_Gather_Bias) >> 48);
+}
+
+/// @summary Checks, at compile time, gather_condition_bits() against the
+/// bitfield built bit by bit, for every combination of the counted bits.
+/// @return true if every combination matches.
+static constexpr bool gather_condition_bits_exact(void)
+{
+    for (uint32_t c = 0; c < 16; ++c)
+    {
+        uint32_t address  = (c >> 0) & 1;
+        uint32_t ident    = (c >> 1) & 1;
+        uint32_t lt       = (c >> 2) & 1;
+        uint32_t owner    = (c >> 3) & 1;
+        uint64_t fields   = uint64_t(address) | uint64_t(ident) << 16 | uint64_t(lt) << 32 | uint64_t(owner) << 48;
+        uint32_t bitfield =
+            (address  << PROOF_OF_ADDRESS ) |
+            (ident    << PROOF_OF_IDENTITY) |
+            (lt       << LOAN_LT_SALARY   ) |
+            ((lt ^ 1) << LOAN_GE_SALARY   ) |
+            (owner    << EXISTING_OWNER   );
+        if (gather_condition_bits(fields) != bitfield) return false;
+    }
+    return true;
+}
+static_assert(gather_condition_bits_exact(), "Bit_Gather_Multiplier must match the condition bit positions");
+
+/// @summary Generates bitfields using a structure of arrays data source. The
+/// loop body is straight-line integer arithmetic with no data-dependent
+/// branches, so it can be auto-vectorized. Produces output identical to the
+/// array of structures version.
+/// @param dst The destination bitfields, of at least count elements.
+/// @param src The source record store.
+/// @param first The index of the first record in src to process.
+/// @param count The number of items to read from src and write to dst, at most
+/// Bit_Count_Block if Counted is true.
+/// @return If Counted is true, the sums of PROOF_OF_ADDRESS, PROOF_OF_IDENTITY,
+/// LOAN_LT_SALARY and EXISTING_OWNER in the 16-bit fields of one value, lowest
+/// first; otherwise zero. Each record is counted in the loop that stores it.
+template <typename bits_t, bool Counted>
+static uint64_t generate_bitfields_store(bits_t *dst, record_store_t const *src, size_t first, size_t count)
+{
+    uint32_t const *salary   = src->annual_salary   + first;
+    uint32_t const *loan     = src->loan_amount     + first;
+    uint8_t  const *verify_a = src->verify_address  + first;
+    uint8_t  const *verify_i = src->verify_identity + first;
+    uint64_t        sums     = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        size_t   r        = first + i;
+        uint32_t address  = proof_of_address_bit (bitmap_get(src->address_valid , r), verify_a[i]);
+        uint32_t ident    = proof_of_identity_bit(bitmap_get(src->identity_valid, r), verify_i[i]);
+        uint32_t lt       = (uint32_t)(loan[i] < salary[i]);
+        uint32_t owner    = bitmap_get(src->owns_other_home, r);
+        if (Counted)
+        {
+            // one multiply rebuilds the bitfield from the summed value, in
+            // place of the shifts below, which compete for the same ports
+            // as the bitmap reads.
+            uint64_t fields = uint64_t(address) | uint64_t(ident) << 16 | uint64_t(lt) << 32 | uint64_t(owner) << 48;
+            bits_assign_low(&dst[i], gather_condition_bits(fields));
+            sums += fields;
+            continue;
+        }
+        uint32_t bitfield =
+            (address  << PROOF_OF_ADDRESS ) |
+            (ident    << PROOF_OF_IDENTITY) |
+            (lt       << LOAN_LT_SALARY   ) |
+            ((lt ^ 1) << LOAN_GE_SALARY   ) |
+            (owner    << EXISTING_OWNER   );
+        bits_assign_low(&dst[i], bitfield);
+    }
+    return sums;
+}
+
+/// @summary Generates bitfields using a structure of arrays data source. See
+/// generate_bitfields_store().
+/// @param dst The destination bitfields, of at least count elements.
+/// @param src The source record store.
+/// @param first The index of the first record in src to process.
+/// @param count The number of items to read from src and write to dst.
+template <typename bits_t>
+static void generate_bitfields(bits_t *dst, record_store_t const *src, size_t first, size_t count)
+{
+    generate_bitfields_store<bits_t, false>(dst, src, first, count);
+}
+
 /// @summary Preprocesses a column of the condition table.
 /// @param mask The output mask structure.
 /// @param rules The input rules, representing a single column of the condition table.
-/// @param row_count The number of rows in the condition table.
-static void build_column_mask(query_mask_t *mask, rule_e const *rules, size_t row_count)
+/// @param row_count The number of rows in the condition table, at most bits_width<bits_t>::value.
+template <typename bits_t>
+static void build_column_mask(query_mask_base_t<bits_t> *mask, rule_e const *rules, size_t row_count)
 {
-    uint32_t bits_false  = 0; // for false bits
-    uint32_t bits_ignore = 0; // for don't care/unused bits
+    bits_t bits_false;  // for false bits
+    bits_t bits_ignore; // for don't care/unused bits
+    bits_zero(&bits_false);
+    bits_zero(&bits_ignore);
     for (size_t i = 0; i < row_count; ++i)
     {
         if (rules[i] == CONDITION_FALSE)
         {
-            bits_false  |= (1U << i);
+            bits_set(&bits_false , i);
         }
         else if (rules[i] == CONDITION_NULL)
         {
-            bits_ignore |= (1U << i);
+            bits_set(&bits_ignore, i);
         }
     }
-    for (size_t i = row_count; i < 32; ++i)
+    for (size_t i = row_count; i < bits_width<bits_t>::value; ++i)
     {
         // pad out unused bits so they don't affect the result.
-        bits_ignore |= (1U << i);
+        bits_set(&bits_ignore, i);
     }
     mask->bits_false  = bits_false;
     mask->bits_ignore = bits_ignore;
@@ -502,223 +1373,9017 @@ static void build_column_mask(query_mask_t *mask, rule_e const *rules, size_t ro
 /// @param ids An array of IDs associated with each input record.
 /// @param bits An array of bitfields computed for each input record.
 /// @param record_count The number of input records.
-static void classify(query_mask_t const *masks, table_t **outputs, size_t column_count, id_t const *ids, uint32_t const *bits, size_t record_count)
+template <typename bits_t>
+static void classify(query_mask_base_t<bits_t> const *masks, table_t **outputs, size_t column_count, id_t const *ids, bits_t const *bits, size_t record_count)
 {
     for (size_t i = 0; i < record_count; ++i)
     {
         id_t     id        = ids[i];
-        uint32_t bitfield  = bits[i];
+        bits_t   bitfield  = bits[i];
         for (size_t j = 0; j < column_count; ++j)
         {
             table_t *output_table  =  outputs[j];
-            uint32_t ignore_bits   =  masks[j].bits_ignore;               // bits indicating 'don't care' entries
-            uint32_t xor_bits      =  masks[j].bits_false;                // bits indicating 'is false' entries
-            uint32_t met_bits      = (bitfield ^ xor_bits) | ignore_bits; // all bits set if all conditions met
-            uint32_t czero         = (met_bits + 1);                      // all bits clear if all conditions met
-            uint32_t cmask         =~(czero  | -czero) >> 31;             // one if all conditions met, else zero
+            bits_t   met_bits      =  bits_met(bitfield, masks[j].bits_false, masks[j].bits_ignore); // all bits set if all conditions met
+            uint32_t cmask         =  bits_all_set(met_bits);                                         // one if all conditions met, else zero
             output_table->storage[output_table->count]  = id;             // always write to the output table
             output_table->count   += (1 & cmask);                         // only increment count if the entry is valid
         }
     }
 }
 
-/// @summary Classifies a single input record based on the logic defined by the
-/// condition table.
-/// @param rec The record to classify.
-static void check_record(record_t const *rec)
+/// @summary Classifies records based on a preprocessed condition table, writing
+/// the position of each matching record instead of its ID. No ID array is
+/// read, so the loop streams only the bitfields.
+/// @param masks The masks generated from each column in the condition table.
+/// @param outputs An array of output selection vectors, one for each column.
+/// @param column_count The number of columns in the condition table.
+/// @param first The position of the first input record.
+/// @param bits An array of bitfields computed for each input record.
+/// @param record_count The number of input records.
+template <typename bits_t>
+static void classify_positions(query_mask_base_t<bits_t> const *masks, table_t **outputs, size_t column_count, uint32_t first, bits_t const *bits, size_t record_count)
 {
-    bool proof_address   = has_proof_of_address(rec->address, rec->verify_address);
-    bool proof_identity  = has_proof_of_identity(rec->identity, rec->verify_identity);
-    bool loan_lt_salary  = loan_amount_less_than_salary(rec->loan_amount, rec->annual_salary);
-    bool loan_ge_salary  = loan_amount_greater_or_equal_salary(rec->loan_amount, rec->annual_salary);
-    bool owns_other_home = existing_homeowner(rec->owns_other_home);
-
-    if (proof_address == false)
+    for (size_t i = 0; i < record_count; ++i)
     {
-        table_put(&Output_Reject, rec->id);
+        uint32_t position = first + (uint32_t) i;
+        bits_t   bitfield = bits[i];
+        for (size_t j = 0; j < column_count; ++j)
+        {
+            table_t *output_table  =  outputs[j];
+            uint32_t cmask         =  bits_all_set(bits_met(bitfield, masks[j].bits_false, masks[j].bits_ignore));
+            output_table->storage[output_table->count]  = position;
+            output_table->count   += (1 & cmask);
+        }
     }
-    if (proof_identity == false)
+}
+
+/// @summary Counts the records matching each column of a condition table, four
+/// records at a time using SSE2. Each column is counted in its own pass, so the
+/// bitfields should be in cache.
+/// @param masks The masks generated from each column in the condition table.
+/// @param column_count The number of columns in the condition table.
+/// @param bits An array of bitfields computed for each input record.
+/// @param record_count The number of input records.
+/// @param hits An array of column_count counts, each incremented by the number of matching records.
+static void count_column_hits(query_mask_t const *masks, size_t column_count, uint32_t const *bits, size_t record_count, uint64_t *hits)
+{
+    __m128i ones = _mm_set1_epi32(-1);
+    for (size_t j = 0; j < column_count; ++j)
     {
-        table_put(&Output_Reject, rec->id);
+        __m128i xor_bits    = _mm_set1_epi32((int32_t) masks[j].bits_false);
+        __m128i ignore_bits = _mm_set1_epi32((int32_t) masks[j].bits_ignore);
+        __m128i v_hits      = _mm_setzero_si128(); // four 32-bit lane counts, subtracting -1 per match
+        size_t  i           = 0;
+        for ( ; i + 4 <= record_count; i += 4)
+        {
+            __m128i v_bits   = _mm_loadu_si128((__m128i const*) &bits[i]);
+            __m128i met_bits = _mm_or_si128(_mm_xor_si128(v_bits, xor_bits), ignore_bits);
+            v_hits = _mm_sub_epi32(v_hits, _mm_cmpeq_epi32(met_bits, ones));
+        }
+        uint32_t lanes[4];
+        _mm_storeu_si128((__m128i*) lanes, v_hits);
+        hits[j] += uint64_t(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+        for ( ; i < record_count; ++i)
+        {
+            hits[j] += bits_all_set(bits_met(bits[i], masks[j].bits_false, masks[j].bits_ignore)) & 1;
+        }
     }
-    if (proof_address && proof_identity && loan_lt_salary)
+}
+
+/*/////////////////////////////
+//  Specialized Classifiers  //
+/////////////////////////////*/
+/// @summary Describes Condition_Table to the specialized classifiers at compile
+/// time. Another table can be specialized by defining a struct with the same
+/// members; its rows must be indices into the bitfield, as for generate_bitfields().
+struct condition_table_spec_t
+{
+    static const size_t Rows = Table_Rows;
+    static const size_t Cols = Table_Cols;
+
+    static constexpr rule_e rule(size_t col, size_t row)
     {
-        table_put(&Output_Immediate, rec->id);
+        return Condition_Table[col][row];
     }
-    if (proof_address && proof_identity && owns_other_home)
+
+    static constexpr action_e action(size_t col)
     {
-        table_put(&Output_Immediate, rec->id);
+        return Condition_Actions[col];
     }
-    if (proof_address && proof_identity && loan_ge_salary)
+
+    /// @summary Evaluates the predicate of a single row for a record. With a
+    /// constant row, the switch folds away.
+    /// @param rec The record to test.
+    /// @param row The row of the condition table, one of bit_ids_e.
+    /// @return true if the condition holds for the record.
+    static inline bool condition(record_t const *rec, size_t row)
     {
-        table_put(&Output_Manual, rec->id);
+        switch (row)
+        {
+            case PROOF_OF_ADDRESS : return has_proof_of_address(rec->address, rec->verify_address);
+            case PROOF_OF_IDENTITY: return has_proof_of_identity(rec->identity, rec->verify_identity);
+            case LOAN_LT_SALARY   : return loan_amount_less_than_salary(rec->loan_amount, rec->annual_salary);
+            case LOAN_GE_SALARY   : return loan_amount_greater_or_equal_salary(rec->loan_amount, rec->annual_salary);
+            case EXISTING_OWNER   : return existing_homeowner(rec->owns_other_home);
+            default               : return false;
+        }
     }
-}
-
-/*/////////////////
-//  Entry Point  //
-/////////////////*/
-#define UNUSED(x)         (void)sizeof(x)
-#define NANOS_PER_USEC    1000ULL
-#define NANOS_PER_MSEC    1000ULL * NANOS_PER_USEC
-#define NANOS_PER_SECOND  1000ULL * NANOS_PER_MSEC
-
-struct timer_t
-{
-    uint64_t start;       /// The starting time, in nanoseconds
-    uint64_t end;         /// The ending time, in nanoseconds
 };
 
-static uint64_t
-timestamp_in_ticks
-(
-    void
-)
+/// @summary Computes, at compile time, the rows of a column holding a given rule.
+/// @param col The column of the condition table.
+/// @param value The rule to look for.
+/// @return A bitfield with bit i set if row i of the column is value.
+template <typename spec_t>
+static constexpr uint32_t spec_rule_bits(size_t col, rule_e value)
 {
-    LARGE_INTEGER ticks;
-    QueryPerformanceCounter(&ticks);
-    return (uint64_t) ticks.QuadPart;
+    uint32_t bits = 0;
+    for (size_t i = 0; i < spec_t::Rows; ++i)
+    {
+        if (spec_t::rule(col, i) == value) bits |= 1U << i;
+    }
+    return bits;
 }
 
-static uint64_t
-timestamp_counts_per_second
-(
-    void
-)
+/// @summary Computes, at compile time, whether any column tests a row. Rows
+/// that no column tests are dead, and are never evaluated.
+/// @param row The row of the condition table.
+/// @return true if at least one column holds CONDITION_TRUE or CONDITION_FALSE in the row.
+template <typename spec_t>
+static constexpr bool spec_row_live(size_t row)
 {
-    LARGE_INTEGER frequency;
-    QueryPerformanceFrequency(&frequency);
-    return (uint64_t) frequency.QuadPart;
+    for (size_t j = 0; j < spec_t::Cols; ++j)
+    {
+        if (spec_t::rule(j, row) != CONDITION_NULL) return true;
+    }
+    return false;
 }
 
-static uint64_t
-timestamp_delta_nanoseconds
-(
-    uint64_t ts_enter, 
-    uint64_t ts_leave
-)
+/// @summary Computes, at compile time, the first column of the run of adjacent
+/// columns sharing a column's action. The run writes one output table, whose
+/// count is kept by its first column.
+/// @param col The column of the condition table.
+/// @return The index of the first column of the run containing col.
+template <typename spec_t>
+static constexpr size_t spec_run_head(size_t col)
 {
-    LARGE_INTEGER frequency;
-    QueryPerformanceFrequency(&frequency);
-    /* scale the tick value by the nanoseconds-per-second multiplier 
-     * before scaling back down by ticks-per-second to avoid loss of precision.
-     */
-    return (1000000000ULL * (ts_leave - ts_enter)) / (uint64_t) frequency.QuadPart;
+    while (col > 0 && spec_t::action(col - 1) == spec_t::action(col)) --col;
+    return col;
 }
 
-static inline void timer_start(timer_t *time)
+/// @summary Evaluates the live rows of a condition table for a record, in row order.
+template <typename spec_t, size_t Row, bool End = (Row >= spec_t::Rows)>
+struct specialized_row_t
 {
-    time->start = timestamp_in_ticks();
-    time->end   = 0;
-}
+    static inline void evaluate(bool *cond, record_t const *rec)
+    {
+        if (spec_row_live<spec_t>(Row))
+        {
+            cond[Row] = spec_t::condition(rec, Row);
+        }
+        specialized_row_t<spec_t, Row + 1>::evaluate(cond, rec);
+    }
+};
 
-static inline void timer_stop(timer_t *time)
+template <typename spec_t, size_t Row>
+struct specialized_row_t<spec_t, Row, true>
 {
-    time->end   = timestamp_in_ticks();
-}
+    static inline void evaluate(bool*, record_t const*) {}
+};
 
-static inline uint64_t duration(timer_t const *time)
+/// @summary Tests the rows of a single column against the evaluated conditions,
+/// stopping at the first that fails. Rows the column ignores are not tested.
+template <typename spec_t, size_t Col, size_t Row, bool End = (Row >= spec_t::Rows)>
+struct specialized_test_t
 {
-    return timestamp_delta_nanoseconds(time->start, time->end);
-}
+    static inline bool met(bool const *cond)
+    {
+        return (spec_t::rule(Col, Row) == CONDITION_NULL || cond[Row] == (spec_t::rule(Col, Row) == CONDITION_TRUE)) &&
+            specialized_test_t<spec_t, Col, Row + 1>::met(cond);
+    }
+};
 
-static inline float duration_sec(timer_t const *time)
+template <typename spec_t, size_t Col, size_t Row>
+struct specialized_test_t<spec_t, Col, Row, true>
 {
-    return float(timestamp_delta_nanoseconds(time->start, time->end)) / float(NANOS_PER_SECOND);
-}
+    static inline bool met(bool const*) { return true; }
+};
 
-int main(int argc, char **argv)
+/// @summary Generates the code for one column of a condition table, and
+/// recursively the columns after it. The branchless and branchy forms are both
+/// generated from the same rules, so they cannot disagree.
+template <typename spec_t, size_t Col, bool End = (Col >= spec_t::Cols)>
+struct specialized_column_t
 {
-    UNUSED(argc);
-    UNUSED(argv);
-
-    const size_t num_iterations = 10;
+    typedef specialized_column_t<spec_t, Col + 1> next_t;
 
-    srand((unsigned int) time(NULL));
+    static const uint32_t Want = spec_rule_bits<spec_t>(Col, CONDITION_TRUE);               /// rows that must be set
+    static const uint32_t Care = spec_rule_bits<spec_t>(Col, CONDITION_FALSE) | Want;       /// rows that are tested
+    static const size_t   Head = spec_run_head<spec_t>(Col);                                /// column keeping the output count
 
-    size_t record_count = 40000000;
-    table_init(&Output_Immediate, (uint32_t) record_count);
-    table_init(&Output_Manual   , (uint32_t) record_count);
-    table_init(&Output_Reject   , (uint32_t) record_count);
-    table_init(&All_IDs         , (uint32_t) record_count);
+    /// @summary Appends an ID to the column's output if the bitfield matches,
+    /// without branching. The masks are immediates, and adjacent columns with
+    /// the same action share one output pointer and count.
+    static inline void branchless(id_t **dst, size_t *count, id_t id, uint32_t bits)
+    {
+        dst[Head][count[Head]] = id;
+        count[Head] += (((bits ^ Want) & Care) == 0) ? 1 : 0;
+        next_t::branchless(dst, count, id, bits);
+    }
 
-    // generate some records.
-    printf("Generating test data of %u records...", (uint32_t) record_count);
-    fflush(stdout);
-    for (size_t i = 0; i < record_count; ++i)
+    /// @summary Appends an ID to the column's output if the evaluated
+    /// conditions match, using a branch per tested row.
+    static inline void branchy(table_t **outputs, bool const *cond, id_t id)
     {
-        record_t rec;
-        make_record(&rec);
-        Records.push_back(rec);
-        table_put(&All_IDs, rec.id);
+        if (specialized_test_t<spec_t, Col, 0>::met(cond))
+        {
+            table_put(outputs[Col], id);
+        }
+        next_t::branchy(outputs, cond, id);
     }
-    printf("DONE.\n");
 
-    // perform one-time preprocessing.
-    uint32_t *bitfields = (uint32_t*) malloc(record_count * sizeof(uint32_t));
-    generate_bitfields(bitfields, &Records[0], Records.size());
-    for (size_t i = 0; i < Table_Cols; ++i)
+    /// @summary Loads the output pointer and count of each run of columns.
+    static inline void load(id_t **dst, size_t *count, table_t **outputs)
     {
-        build_column_mask(&Table_Mask[i], Condition_Table[i], Table_Rows);
+        assert(outputs[Col] == outputs[Head] && "columns with the same action must share an output table");
+        if (Head == Col)
+        {
+            dst  [Col] = outputs[Col]->storage;
+            count[Col] = outputs[Col]->count;
+        }
+        next_t::load(dst, count, outputs);
     }
 
-    printf("Performing branchy processing...");
-    fflush(stdout);
-    timer_t branchy_time;
-    timer_start(&branchy_time);
-    for (size_t iter = 0; iter < num_iterations; ++iter)
+    /// @summary Stores the count of each run of columns back to its table.
+    static inline void store(table_t **outputs, size_t const *count)
     {
-        table_clear(&Output_Reject);
-        table_clear(&Output_Manual);
-        table_clear(&Output_Immediate);
-        for (size_t i = 0; i < record_count; ++i)
+        if (Head == Col)
         {
-            check_record(&Records[i]);
+            outputs[Col]->count = count[Col];
         }
+        next_t::store(outputs, count);
     }
-    timer_stop(&branchy_time);
-    printf("DONE (%" PRIu64 " ns.)\n", duration(&branchy_time));
-    printf("Reject:    %u.\n", (uint32_t) Output_Reject.count);
-    printf("Manual:    %u.\n", (uint32_t) Output_Manual.count);
-    printf("Immediate: %u.\n", (uint32_t) Output_Immediate.count);
-    printf("\n");
+};
 
-    printf("Performing branchless processing...");
-    fflush(stdout);
-    timer_t branchless_time;
-    table_t *outputs[] = {
-        &Output_Reject,
-        &Output_Reject,
-        &Output_Immediate,
-        &Output_Immediate,
-        &Output_Manual
-    };
+template <typename spec_t, size_t Col>
+struct specialized_column_t<spec_t, Col, true>
+{
+    static inline void branchless(id_t**, size_t*, id_t, uint32_t) {}
+    static inline void branchy(table_t**, bool const*, id_t) {}
+    static inline void load(id_t**, size_t*, table_t**) {}
+    static inline void store(table_t**, size_t const*) {}
+};
 
-    // filter the record set using SoA stream.
-    timer_start(&branchless_time);
-    for (size_t iter = 0; iter < num_iterations; ++iter)
+/// @summary Classifies records with a kernel specialized for a compile-time
+/// condition table. Produces the same output as classify() with masks built
+/// from the same table. Like classify(), the output tables must have room
+/// for every match, plus one. Each run of adjacent columns with the same
+/// action is written through its first column only, so every column in a run
+/// must point at the same output table as the first.
+/// @param outputs An array of output tables, one for each column.
+/// @param ids An array of IDs associated with each input record.
+/// @param bits An array of bitfields computed for each input record.
+/// @param record_count The number of input records.
+template <typename spec_t>
+static void classify_specialized(table_t **outputs, id_t const *ids, uint32_t const *bits, size_t record_count)
+{
+    static_assert(spec_t::Rows <= bits_width<uint32_t>::value, "specialized classifiers use 32-bit bitfields");
+    typedef specialized_column_t<spec_t, 0> column_t;
+    id_t   *dst  [spec_t::Cols];
+    size_t  count[spec_t::Cols];
+    column_t::load(dst, count, outputs);
+    for (size_t i = 0; i < record_count; ++i)
     {
-        table_clear(&Output_Reject);
-        table_clear(&Output_Manual);
-        table_clear(&Output_Immediate);
-        classify(Table_Mask, outputs, Table_Cols, All_IDs.storage, bitfields, record_count);
+        column_t::branchless(dst, count, ids[i], bits[i]);
     }
-    timer_stop(&branchless_time);
-    printf("DONE (%" PRIu64 " ns.)\n", duration(&branchless_time));
-    printf("Reject:    %u.\n", (uint32_t) Output_Reject.count);
-    printf("Manual:    %u.\n", (uint32_t) Output_Manual.count);
-    printf("Immediate: %u.\n", (uint32_t) Output_Immediate.count);
-    printf("\n");
+    column_t::store(outputs, count);
+}
 
-    printf("Branchy processing took:    %f seconds.\n", duration_sec(&branchy_time));
-    printf("Branchless processing took: %f seconds.\n", duration_sec(&branchless_time));
+/// @summary Classifies a single record with branches specialized for a
+/// compile-time condition table, evaluating only the live rows.
+/// @param rec The record to classify.
+/// @param outputs An array of output tables, one for each column.
+template <typename spec_t>
+static inline void check_record_specialized(record_t const *rec, table_t **outputs)
+{
+    bool cond[spec_t::Rows];
+    specialized_row_t<spec_t, 0>::evaluate(cond, rec);
+    specialized_column_t<spec_t, 0>::branchy(outputs, cond, rec->id);
+}
 
-    free(bitfields);
-    table_free(&All_IDs);
-    table_free(&Output_Reject);
-    table_free(&Output_Manual);
-    table_free(&Output_Immediate);
+/*//////////////////////
+//  SIMD Classifiers  //
+//////////////////////*/
+/// @summary Define the instruction set levels for which a classify kernel exists.
+/// The levels are ordered; a CPU supporting a level supports all lower levels.
+enum simd_level_e
+{
+    SIMD_LEVEL_SCALAR                  = 0, // portable one-record-at-a-time kernel
+    SIMD_LEVEL_SSE42                   = 1, // 4 records per step, pshufb compaction
+    SIMD_LEVEL_AVX2                    = 2, // 8 records per step, vpermd compaction
+    SIMD_LEVEL_AVX512                  = 3, // 16 records per step, vpcompressd
+    SIMD_LEVEL_COUNT                   = 4
+};
 
-    return 0;
+/// @summary A lookup table of strings for pretty-printing simd_level_e values.
+static char const *Simd_Level_Names[SIMD_LEVEL_COUNT] =
+{
+    "scalar",
+    "SSE4.2",
+    "AVX2",
+    "AVX-512"
+};
+
+/// @summary The signature shared by all classify kernels. See classify().
+typedef void (*classify_func_t)(query_mask_t const*, table_t**, size_t, id_t const*, uint32_t const*, size_t);
+
+/// @summary Describes the set of condition table columns writing to a single
+/// output table. Columns sharing an output table must be evaluated together so
+/// that each ID is appended once per matching column, as classify() does.
+struct output_group_t
+{
+    table_t     *table;       /// The output table written by every column in the group
+    uint32_t     first;       /// Index of the group's first entry in output_groups_t::columns
+    uint32_t     count;       /// The number of columns in the group
+};
+
+/// @summary Stores the columns of a condition table grouped by output table.
+struct output_groups_t
+{
+    size_t          group_count; /// The number of distinct output tables
+    output_group_t *groups;      /// An array of group_count groups, in first-use order
+    uint32_t       *columns;     /// Column indices, ordered by group
+};
+
+/// @summary Byte shuffle controls for _mm_shuffle_epi8, indexed by a 4-bit lane
+/// mask, moving the selected 32-bit lanes to the front of the register.
+static uint8_t  Compress_LUT_SSE42[16][16];
+
+/// @summary Lane permutations for _mm256_permutevar8x32_epi32, indexed by an
+/// 8-bit lane mask, moving the selected 32-bit lanes to the front of the register.
+static uint32_t Compress_LUT_AVX2[256][8];
+
+/// @summary Counts the number of set bits in a value.
+/// @param x The input value.
+/// @return The number of bits set in x.
+static inline uint32_t popcount32(uint32_t x)
+{
+    x =  x - ((x >> 1) & 0x55555555U);
+    x = (x & 0x33333333U) + ((x >> 2) & 0x33333333U);
+    x = (x + (x >> 4)) & 0x0F0F0F0FU;
+    return (x * 0x01010101U) >> 24;
+}
+
+/// @summary Executes the cpuid instruction.
+/// @param regs On return, the values of the eax, ebx, ecx and edx registers.
+/// @param leaf The value to load into eax.
+/// @param subleaf The value to load into ecx.
+static void cpuid(uint32_t regs[4], uint32_t leaf, uint32_t subleaf)
+{
+#if defined(_MSC_VER)
+    int r[4];
+    __cpuidex(r, (int) leaf, (int) subleaf);
+    regs[0] = (uint32_t) r[0]; regs[1] = (uint32_t) r[1];
+    regs[2] = (uint32_t) r[2]; regs[3] = (uint32_t) r[3];
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+/// @summary Reads extended control register zero, which indicates the register
+/// state the operating system saves and restores on a context switch.
+/// @return The value of XCR0.
+static uint64_t read_xcr0(void)
+{
+#if defined(_MSC_VER)
+    return (uint64_t) _xgetbv(0);
+#else
+    uint32_t lo, hi;
+    __asm__ __volatile__("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return ((uint64_t) hi << 32) | lo;
+#endif
 }
 
+/// @summary Determines the highest SIMD level supported by both the CPU and
+/// the operating system.
+/// @return One of simd_level_e.
+static simd_level_e detect_simd_level(void)
+{
+    uint32_t   regs[4];
+    uint32_t   leaf1_ecx = 0;
+    uint32_t   leaf7_ebx = 0;
+    uint64_t   xcr0      = 0;
+
+    cpuid(regs, 0, 0);
+    uint32_t max_leaf = regs[0];
+    if (max_leaf >= 1)
+    {
+        cpuid(regs, 1, 0);
+        leaf1_ecx = regs[2];
+    }
+    if (max_leaf >= 7)
+    {
+        cpuid(regs, 7, 0);
+        leaf7_ebx = regs[1];
+    }
+    if (leaf1_ecx & (1U << 27)) // OSXSAVE
+    {
+        xcr0 = read_xcr0();
+    }
+
+    bool sse42  = (leaf1_ecx & (1U << 20)) && (leaf1_ecx & (1U << 23)); // SSE4.2, POPCNT
+    bool avx    = (leaf1_ecx & (1U << 28)) && ((xcr0 & 0x06) == 0x06);  // AVX, XMM+YMM state
+    bool avx2   =  avx && (leaf7_ebx & (1U <<  5));
+    bool avx512 =  avx2 && (leaf7_ebx & (1U << 16)) && ((xcr0 & 0xE6) == 0xE6); // AVX512F, opmask+ZMM state
+
+    if (avx512) return SIMD_LEVEL_AVX512;
+    if (avx2  ) return SIMD_LEVEL_AVX2;
+    if (sse42 ) return SIMD_LEVEL_SSE42;
+    return SIMD_LEVEL_SCALAR;
+}
+
+/// @summary Fills the lane compaction lookup tables used by the SSE4.2 and
+/// AVX2 kernels. Call once at startup before using those kernels.
+static void simd_init(void)
+{
+    for (uint32_t m = 0; m < 16; ++m)
+    {
+        uint32_t n = 0;
+        for (uint32_t lane = 0; lane < 4; ++lane)
+        {
+            if (m & (1U << lane))
+            {
+                for (uint32_t b = 0; b < 4; ++b)
+                {
+                    Compress_LUT_SSE42[m][n * 4 + b] = (uint8_t)(lane * 4 + b);
+                }
+                n++;
+            }
+        }
+        for ( ; n < 4; ++n)
+        {
+            for (uint32_t b = 0; b < 4; ++b)
+            {
+                Compress_LUT_SSE42[m][n * 4 + b] = 0x80; // zero the unused lanes
+            }
+        }
+    }
+    for (uint32_t m = 0; m < 256; ++m)
+    {
+        uint32_t n = 0;
+        for (uint32_t lane = 0; lane < 8; ++lane)
+        {
+            if (m & (1U << lane))
+            {
+                Compress_LUT_AVX2[m][n++] = lane;
+            }
+        }
+        for ( ; n < 8; ++n)
+        {
+            Compress_LUT_AVX2[m][n] = 0;
+        }
+    }
+}
+
+/// @summary Groups the columns of a condition table by output table.
+/// @param groups The structure to initialize. Free with output_groups_free().
+/// @param outputs An array of output tables, one for each column.
+/// @param column_count The number of columns in the condition table.
+static void output_groups_build(output_groups_t *groups, table_t **outputs, size_t column_count)
+{
+    groups->group_count = 0;
+    groups->groups      = (output_group_t*) malloc(column_count * sizeof(output_group_t));
+    groups->columns     = (uint32_t      *) malloc(column_count * sizeof(uint32_t));
+    for (size_t j = 0; j < column_count; ++j)
+    {
+        size_t g = 0;
+        while (g < groups->group_count && groups->groups[g].table != outputs[j])
+        {
+            ++g;
+        }
+        if (g == groups->group_count)
+        {
+            groups->groups[g].table = outputs[j];
+            groups->groups[g].first = 0;
+            groups->groups[g].count = 0;
+            groups->group_count++;
+        }
+        groups->groups[g].count++;
+    }
+    uint32_t first = 0;
+    for (size_t g = 0; g < groups->group_count; ++g)
+    {
+        groups->groups[g].first = first;
+        first += groups->groups[g].count;
+        groups->groups[g].count = 0;
+    }
+    for (size_t j = 0; j < column_count; ++j)
+    {
+        size_t g = 0;
+        while (groups->groups[g].table != outputs[j])
+        {
+            ++g;
+        }
+        output_group_t *grp = &groups->groups[g];
+        groups->columns[grp->first + grp->count++] = (uint32_t) j;
+    }
+}
+
+/// @summary Frees the storage associated with an output_groups_t.
+/// @param groups The structure to free.
+static void output_groups_free(output_groups_t *groups)
+{
+    free(groups->columns);
+    free(groups->groups);
+    groups->group_count = 0;
+    groups->groups      = NULL;
+    groups->columns     = NULL;
+}
+
+/// @summary Appends each ID in a block of lanes to a table once per column that
+/// matched it. Used when some record matched more than one column of a group.
+/// @param table The output table, with at least lane_count * max_count free slots.
+/// @param ids The IDs of the records in the block.
+/// @param counts The number of matching columns for each lane, negated.
+/// @param lane_count The number of records in the block.
+/// @param max_count The number of columns in the group.
+static inline void expand_matches(table_t *table, id_t const *ids, int32_t const *counts, uint32_t lane_count, uint32_t max_count)
+{
+    id_t  *storage = table->storage;
+    size_t n       = table->count;
+    for (uint32_t lane = 0; lane < lane_count; ++lane)
+    {
+        uint32_t hits = (uint32_t)(-counts[lane]);
+        for (uint32_t r = 0; r < max_count; ++r)
+        {
+            storage[n] = ids[lane];
+            n += (hits > r) ? 1 : 0;
+        }
+    }
+    table->count = n;
+}
+
+/// @summary Computes per-lane all-conditions-met results for one column.
+/// @param bits Four record bitfields.
+/// @param mask The preprocessed column of the condition table.
+/// @return All bits set in lanes that match the column, zero in other lanes.
+TARGET_SSE42 static inline __m128i match_sse42(__m128i bits, query_mask_t const *mask)
+{
+    __m128i xor_bits    = _mm_set1_epi32((int32_t) mask->bits_false);
+    __m128i ignore_bits = _mm_set1_epi32((int32_t) mask->bits_ignore);
+    __m128i met_bits    = _mm_or_si128(_mm_xor_si128(bits, xor_bits), ignore_bits);
+    return _mm_cmpeq_epi32(met_bits, _mm_set1_epi32(-1));
+}
+
+/// @summary The number of condition table columns the Counted classify kernels
+/// can count, each of which has its own telemetry hit counter.
+static const size_t Telemetry_Max_Columns = 32;
+
+/// @summary The number of shared columns the Counted classify kernels can
+/// count. A shared column writes to the same output table as a lower-numbered
+/// column; it is counted in one byte of a 32-bit accumulator per lane, held in
+/// a register. The first column of each output table is not counted while
+/// classifying, since its matches follow from the change in the table's count.
+/// The kernels copy the column weights to a stack array and broadcast each from
+/// memory, as the column masks are, so that no register is held for them.
+static const size_t Telemetry_Max_Shared  = 4;
+
+/// @summary The number of steps a Counted classify kernel takes before it
+/// flushes its accumulators. Each step adds at most one to each byte.
+static const size_t Telemetry_Flush_Steps = 255;
+
+/// @summary Adds the accumulators of a Counted classify kernel to the counts
+/// of the shared columns.
+/// @param lanes The accumulator of each lane. Byte s counts shared column s.
+/// @param lane_count The number of lanes.
+/// @param shared_hits An array of Telemetry_Max_Shared counts.
+static inline void telemetry_flush_lanes(uint32_t const *lanes, size_t lane_count, uint64_t *shared_hits)
+{
+    for (size_t l = 0; l < lane_count; ++l)
+    {
+        for (size_t s = 0; s < Telemetry_Max_Shared; ++s)
+        {
+            shared_hits[s] += (lanes[l] >> (8 * s)) & 0xFF;
+        }
+    }
+}
+
+/// @summary Classifies records one at a time, counting the matches of each
+/// shared column. The first column of each output table is classified by the
+/// loop of classify(); the shared columns follow in a second loop, which also
+/// counts them. The columns of a record may be visited in any order, since a
+/// record adds the same ID to a table for each matching column, so the output
+/// is identical to classify(). The output tables must have room for every
+/// match, plus one.
+/// @param masks The masks generated from each column in the condition table.
+/// @param outputs An array of output tables, one for each column.
+/// @param column_count The number of columns in the condition table.
+/// @param ids An array of IDs associated with each input record.
+/// @param bits An array of bitfields computed for each input record.
+/// @param record_count The number of input records.
+/// @param weights For each column, 1 << (8 * s) if it is shared column s, or zero.
+/// @param shared_hits An array of Telemetry_Max_Shared counts, each incremented
+/// by the number of records matching the shared column.
+static void classify_counted_scalar(query_mask_t const *masks, table_t **outputs, size_t column_count, id_t const *ids, uint32_t const *bits, size_t record_count, uint32_t const *weights, uint64_t *shared_hits)
+{
+    query_mask_t head_masks   [Telemetry_Max_Columns];
+    table_t     *head_outputs [Telemetry_Max_Columns];
+    query_mask_t shared_masks [Telemetry_Max_Shared];
+    table_t     *shared_outputs[Telemetry_Max_Shared];
+    uint32_t     shared_weights[Telemetry_Max_Shared];
+    size_t       head_count   = 0;
+    size_t       shared_count = 0;
+    for (size_t j = 0; j < column_count; ++j)
+    {
+        if (weights[j] != 0)
+        {
+            shared_masks  [shared_count] = masks[j];
+            shared_outputs[shared_count] = outputs[j];
+            shared_weights[shared_count] = weights[j];
+            shared_count++;
+        }
+        else
+        {
+            head_masks  [head_count] = masks[j];
+            head_outputs[head_count] = outputs[j];
+            head_count++;
+        }
+    }
+    for (size_t lo = 0; lo < record_count; lo += Telemetry_Flush_Steps)
+    {
+        size_t   hi     = std::min(record_count, lo + Telemetry_Flush_Steps);
+        uint32_t shared = 0;
+        for (size_t i = lo; i < hi; ++i)
+        {
+            id_t     id       = ids[i];
+            uint32_t bitfield = bits[i];
+            for (size_t j = 0; j < head_count; ++j)
+            {
+                table_t *output_table  =  head_outputs[j];
+                uint32_t cmask         =  bits_all_set(bits_met(bitfield, head_masks[j].bits_false, head_masks[j].bits_ignore));
+                output_table->storage[output_table->count]  = id;
+                output_table->count   += (1 & cmask);
+            }
+            for (size_t s = 0; s < shared_count; ++s)
+            {
+                table_t *output_table  =  shared_outputs[s];
+                uint32_t cmask         =  bits_all_set(bits_met(bitfield, shared_masks[s].bits_false, shared_masks[s].bits_ignore));
+                output_table->storage[output_table->count]  = id;
+                output_table->count   += (1 & cmask);
+                shared                += shared_weights[s] & (0u - cmask);
+            }
+        }
+        uint32_t lanes[1] = { shared };
+        telemetry_flush_lanes(lanes, 1, shared_hits);
+    }
+}
+
+/// @summary Classifies records four at a time using SSE4.2. Produces output
+/// identical to classify(), or to classify_positions() if Positions is true.
+/// Output tables are grown as needed.
+/// @param masks The masks generated from each column in the condition table.
+/// @param outputs An array of output tables, one for each column.
+/// @param column_count The number of columns in the condition table.
+/// @param ids An array of IDs associated with each input record. Unused if Positions is true.
+/// @param first The position of the first input record. Used only if Positions is true.
+/// @param bits An array of bitfields computed for each input record.
+/// @param record_count The number of input records.
+/// @param weights If Counted is true, for each column 1 << (8 * s) if it is
+/// shared column s, or zero. See Telemetry_Max_Shared.
+/// @param shared_hits If Counted is true, an array of Telemetry_Max_Shared
+/// counts, each incremented by the number of records matching the shared column.
+template <bool Positions, bool Counted>
+TARGET_SSE42 NOINLINE CODE_ALIGN static void classify_sse42_lanes(query_mask_t const *masks, table_t **outputs, size_t column_count, id_t const *ids, uint32_t first, uint32_t const *bits, size_t record_count, uint32_t const *weights, uint64_t *shared_hits)
+{
+    output_groups_t groups;
+    output_groups_build(&groups, outputs, column_count);
+
+    // a stack copy of the weights; see Telemetry_Max_Shared.
+    uint32_t column_weights[Telemetry_Max_Columns];
+    if (Counted) std::copy(weights, weights + column_count, column_weights);
+
+    __m128i const iota = _mm_setr_epi32(0, 1, 2, 3);
+    size_t        i    = 0;
+    while (i + 4 <= record_count)
+    {
+        // a Counted kernel flushes its byte accumulators before any can overflow.
+        size_t  end      = Counted ? std::min(record_count, i + 4 * Telemetry_Flush_Steps) : record_count;
+        __m128i v_shared = _mm_setzero_si128();
+        for ( ; i + 4 <= end; i += 4)
+        {
+            __m128i v_ids  = Positions ? _mm_add_epi32(_mm_set1_epi32((int32_t)(first + i)), iota) : _mm_loadu_si128((__m128i const*) &ids[i]);
+            __m128i v_bits = _mm_loadu_si128((__m128i const*) &bits[i]);
+            for (size_t g = 0; g < groups.group_count; ++g)
+            {
+                output_group_t const *grp    = &groups.groups[g];
+                uint32_t const       *cols   = &groups.columns[grp->first];
+                table_t              *table  = grp->table;
+                table_reserve(table, table->count + 4 * grp->count);
+
+                __m128i v_match = match_sse42(v_bits, &masks[cols[0]]);
+                __m128i v_count = v_match;
+                for (uint32_t k = 1; k < grp->count; ++k)
+                {
+                    v_match = match_sse42(v_bits, &masks[cols[k]]);
+                    v_count = _mm_add_epi32(v_count, v_match);
+                    if (Counted) v_shared = _mm_add_epi32(v_shared, _mm_and_si128(v_match, _mm_set1_epi32((int32_t) column_weights[cols[k]])));
+                }
+                int dup = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(v_count, _mm_set1_epi32(-1))));
+                if (dup == 0)
+                {
+                    uint32_t m    = (uint32_t) _mm_movemask_ps(_mm_castsi128_ps(v_count));
+                    __m128i  ctrl = _mm_loadu_si128((__m128i const*) Compress_LUT_SSE42[m]);
+                    _mm_storeu_si128((__m128i*) &table->storage[table->count], _mm_shuffle_epi8(v_ids, ctrl));
+                    table->count += _mm_popcnt_u32(m);
+                }
+                else
+                {
+                    int32_t counts[4];
+                    id_t    lane_ids[4];
+                    _mm_storeu_si128((__m128i*) counts, v_count);
+                    if (Positions) _mm_storeu_si128((__m128i*) lane_ids, v_ids);
+                    expand_matches(table, Positions ? lane_ids : &ids[i], counts, 4, grp->count);
+                }
+            }
+        }
+        if (Counted)
+        {
+            uint32_t lanes[4];
+            _mm_storeu_si128((__m128i*) lanes, v_shared);
+            telemetry_flush_lanes(lanes, 4, shared_hits);
+        }
+    }
+    for (size_t g = 0; g < groups.group_count; ++g)
+    {
+        output_group_t *grp = &groups.groups[g];
+        table_reserve(grp->table, grp->table->count + (record_count - i) * grp->count + 1);
+    }
+    if (Positions)
+        classify_positions(masks, outputs, column_count, first + (uint32_t) i, bits + i, record_count - i);
+    else if (Counted)
+        classify_counted_scalar(masks, outputs, column_count, ids + i, bits + i, record_count - i, weights, shared_hits);
+    else
+        classify(masks, outputs, column_count, ids + i, bits + i, record_count - i);
+    output_groups_free(&groups);
+}
+
+/// @summary Classifies records four at a time using SSE4.2. Produces output
+/// identical to classify(). Output tables are grown as needed. The parameters
+/// are as for classify().
+TARGET_SSE42 static void classify_sse42(query_mask_t const *masks, table_t **outputs, size_t column_count, id_t const *ids, uint32_t const *bits, size_t record_count)
+{
+    classify_sse42_lanes<false, false>(masks, outputs, column_count, ids, 0, bits, record_count, NULL, NULL);
+}
+
+/// @summary Computes per-lane all-conditions-met results for one column.
+/// @param bits Eight record bitfields.
+/// @param mask The preprocessed column of the condition table.
+/// @return All bits set in lanes that match the column, zero in other lanes.
+TARGET_AVX2 static inline __m256i match_avx2(__m256i bits, query_mask_t const *mask)
+{
+    __m256i xor_bits    = _mm256_set1_epi32((int32_t) mask->bits_false);
+    __m256i ignore_bits = _mm256_set1_epi32((int32_t) mask->bits_ignore);
+    __m256i met_bits    = _mm256_or_si256(_mm256_xor_si256(bits, xor_bits), ignore_bits);
+    return _mm256_cmpeq_epi32(met_bits, _mm256_set1_epi32(-1));
+}
+
+/// @summary Classifies records eight at a time using AVX2. Produces output
+/// identical to classify(), or to classify_positions() if Positions is true.
+/// Output tables are grown as needed.
+/// @param masks The masks generated from each column in the condition table.
+/// @param outputs An array of output tables, one for each column.
+/// @param column_count The number of columns in the condition table.
+/// @param ids An array of IDs associated with each input record. Unused if Positions is true.
+/// @param first The position of the first input record. Used only if Positions is true.
+/// @param bits An array of bitfields computed for each input record.
+/// @param record_count The number of input records.
+/// @param weights If Counted is true, for each column 1 << (8 * s) if it is
+/// shared column s, or zero. See Telemetry_Max_Shared.
+/// @param shared_hits If Counted is true, an array of Telemetry_Max_Shared
+/// counts, each incremented by the number of records matching the shared column.
+template <bool Positions, bool Counted>
+TARGET_AVX2 NOINLINE CODE_ALIGN static void classify_avx2_lanes(query_mask_t const *masks, table_t **outputs, size_t column_count, id_t const *ids, uint32_t first, uint32_t const *bits, size_t record_count, uint32_t const *weights, uint64_t *shared_hits)
+{
+    output_groups_t groups;
+    output_groups_build(&groups, outputs, column_count);
+
+    // a stack copy of the weights; see Telemetry_Max_Shared.
+    uint32_t column_weights[Telemetry_Max_Columns];
+    if (Counted) std::copy(weights, weights + column_count, column_weights);
+
+    __m256i const iota = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    size_t        i    = 0;
+    while (i + 8 <= record_count)
+    {
+        // a Counted kernel flushes its byte accumulators before any can overflow.
+        size_t  end      = Counted ? std::min(record_count, i + 8 * Telemetry_Flush_Steps) : record_count;
+        __m256i v_shared = _mm256_setzero_si256();
+        for ( ; i + 8 <= end; i += 8)
+        {
+            __m256i v_ids  = Positions ? _mm256_add_epi32(_mm256_set1_epi32((int32_t)(first + i)), iota) : _mm256_loadu_si256((__m256i const*) &ids[i]);
+            __m256i v_bits = _mm256_loadu_si256((__m256i const*) &bits[i]);
+            for (size_t g = 0; g < groups.group_count; ++g)
+            {
+                output_group_t const *grp    = &groups.groups[g];
+                uint32_t const       *cols   = &groups.columns[grp->first];
+                table_t              *table  = grp->table;
+                table_reserve(table, table->count + 8 * grp->count);
+
+                __m256i v_match = match_avx2(v_bits, &masks[cols[0]]);
+                __m256i v_count = v_match;
+                for (uint32_t k = 1; k < grp->count; ++k)
+                {
+                    v_match = match_avx2(v_bits, &masks[cols[k]]);
+                    v_count = _mm256_add_epi32(v_count, v_match);
+                    if (Counted) v_shared = _mm256_add_epi32(v_shared, _mm256_and_si256(v_match, _mm256_set1_epi32((int32_t) column_weights[cols[k]])));
+                }
+                int dup = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(-1), v_count)));
+                if (dup == 0)
+                {
+                    uint32_t m    = (uint32_t) _mm256_movemask_ps(_mm256_castsi256_ps(v_count));
+                    __m256i  perm = _mm256_loadu_si256((__m256i const*) Compress_LUT_AVX2[m]);
+                    _mm256_storeu_si256((__m256i*) &table->storage[table->count], _mm256_permutevar8x32_epi32(v_ids, perm));
+                    table->count += _mm_popcnt_u32(m);
+                }
+                else
+                {
+                    int32_t counts[8];
+                    id_t    lane_ids[8];
+                    _mm256_storeu_si256((__m256i*) counts, v_count);
+                    if (Positions) _mm256_storeu_si256((__m256i*) lane_ids, v_ids);
+                    expand_matches(table, Positions ? lane_ids : &ids[i], counts, 8, grp->count);
+                }
+            }
+        }
+        if (Counted)
+        {
+            uint32_t lanes[8];
+            _mm256_storeu_si256((__m256i*) lanes, v_shared);
+            telemetry_flush_lanes(lanes, 8, shared_hits);
+        }
+    }
+    for (size_t g = 0; g < groups.group_count; ++g)
+    {
+        output_group_t *grp = &groups.groups[g];
+        table_reserve(grp->table, grp->table->count + (record_count - i) * grp->count + 1);
+    }
+    if (Positions)
+        classify_positions(masks, outputs, column_count, first + (uint32_t) i, bits + i, record_count - i);
+    else if (Counted)
+        classify_counted_scalar(masks, outputs, column_count, ids + i, bits + i, record_count - i, weights, shared_hits);
+    else
+        classify(masks, outputs, column_count, ids + i, bits + i, record_count - i);
+    output_groups_free(&groups);
+}
+
+/// @summary Classifies records eight at a time using AVX2. Produces output
+/// identical to classify(). Output tables are grown as needed. The parameters
+/// are as for classify().
+TARGET_AVX2 static void classify_avx2(query_mask_t const *masks, table_t **outputs, size_t column_count, id_t const *ids, uint32_t const *bits, size_t record_count)
+{
+    classify_avx2_lanes<false, false>(masks, outputs, column_count, ids, 0, bits, record_count, NULL, NULL);
+}
+
+/// @summary Classifies records sixteen at a time using AVX-512F. Produces output
+/// identical to classify(), or to classify_positions() if Positions is true.
+/// Output tables are grown as needed. The SIMD kernels are kept out of line:
+/// inlined into classify_avx512(), the group loop counter was spilled to the
+/// stack, and the plain kernel ran slower than the counted one.
+/// @param masks The masks generated from each column in the condition table.
+/// @param outputs An array of output tables, one for each column.
+/// @param column_count The number of columns in the condition table.
+/// @param ids An array of IDs associated with each input record. Unused if Positions is true.
+/// @param first The position of the first input record. Used only if Positions is true.
+/// @param bits An array of bitfields computed for each input record.
+/// @param record_count The number of input records.
+/// @param weights If Counted is true, for each column 1 << (8 * s) if it is
+/// shared column s, or zero. See Telemetry_Max_Shared.
+/// @param shared_hits If Counted is true, an array of Telemetry_Max_Shared
+/// counts, each incremented by the number of records matching the shared column.
+template <bool Positions, bool Counted>
+TARGET_AVX512 NOINLINE CODE_ALIGN static void classify_avx512_lanes(query_mask_t const *masks, table_t **outputs, size_t column_count, id_t const *ids, uint32_t first, uint32_t const *bits, size_t record_count, uint32_t const *weights, uint64_t *shared_hits)
+{
+    output_groups_t groups;
+    output_groups_build(&groups, outputs, column_count);
+
+    // a stack copy of the weights; see Telemetry_Max_Shared.
+    uint32_t column_weights[Telemetry_Max_Columns];
+    if (Counted) std::copy(weights, weights + column_count, column_weights);
+
+    __m512i ones = _mm512_set1_epi32(-1);
+    __m512i one  = _mm512_set1_epi32( 1);
+    __m512i iota = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    size_t  i    = 0;
+    while (i + 16 <= record_count)
+    {
+        // a Counted kernel flushes its byte accumulators before any can overflow.
+        size_t  end      = Counted ? std::min(record_count, i + 16 * Telemetry_Flush_Steps) : record_count;
+        __m512i v_shared = _mm512_setzero_si512();
+        for ( ; i + 16 <= end; i += 16)
+        {
+            __m512i v_ids  = Positions ? _mm512_add_epi32(_mm512_set1_epi32((int32_t)(first + i)), iota) : _mm512_loadu_si512((void const*) &ids[i]);
+            __m512i v_bits = _mm512_loadu_si512((void const*) &bits[i]);
+            for (size_t g = 0; g < groups.group_count; ++g)
+            {
+                output_group_t const *grp    = &groups.groups[g];
+                uint32_t const       *cols   = &groups.columns[grp->first];
+                table_t              *table  = grp->table;
+                table_reserve(table, table->count + 16 * grp->count);
+
+                __m512i v_count = _mm512_setzero_si512();
+                for (uint32_t k = 0; k < grp->count; ++k)
+                {
+                    query_mask_t const *mask = &masks[cols[k]];
+                    __m512i  xor_bits    = _mm512_set1_epi32((int32_t) mask->bits_false);
+                    __m512i  ignore_bits = _mm512_set1_epi32((int32_t) mask->bits_ignore);
+                    __m512i  met_bits    = _mm512_or_si512(_mm512_xor_si512(v_bits, xor_bits), ignore_bits);
+                    __mmask16 met        = _mm512_cmpeq_epi32_mask(met_bits, ones);
+                    if (Counted && k != 0) v_shared = _mm512_mask_add_epi32(v_shared, met, v_shared, _mm512_set1_epi32((int32_t) column_weights[cols[k]]));
+                    v_count = _mm512_mask_sub_epi32(v_count, met, v_count, one); // counts are negated, as in the other kernels
+                }
+                __mmask16 dup = _mm512_cmplt_epi32_mask(v_count, ones);
+                if (dup == 0)
+                {
+                    __mmask16 m = _mm512_test_epi32_mask(v_count, v_count);
+                    _mm512_mask_compressstoreu_epi32((void*) &table->storage[table->count], m, v_ids);
+                    table->count += _mm_popcnt_u32((uint32_t) m);
+                }
+                else
+                {
+                    int32_t counts[16];
+                    id_t    lane_ids[16];
+                    _mm512_storeu_si512((void*) counts, v_count);
+                    if (Positions) _mm512_storeu_si512((void*) lane_ids, v_ids);
+                    expand_matches(table, Positions ? lane_ids : &ids[i], counts, 16, grp->count);
+                }
+            }
+        }
+        if (Counted)
+        {
+            uint32_t lanes[16];
+            _mm512_storeu_si512((void*) lanes, v_shared);
+            telemetry_flush_lanes(lanes, 16, shared_hits);
+        }
+    }
+    for (size_t g = 0; g < groups.group_count; ++g)
+    {
+        output_group_t *grp = &groups.groups[g];
+        table_reserve(grp->table, grp->table->count + (record_count - i) * grp->count + 1);
+    }
+    if (Positions)
+        classify_positions(masks, outputs, column_count, first + (uint32_t) i, bits + i, record_count - i);
+    else if (Counted)
+        classify_counted_scalar(masks, outputs, column_count, ids + i, bits + i, record_count - i, weights, shared_hits);
+    else
+        classify(masks, outputs, column_count, ids + i, bits + i, record_count - i);
+    output_groups_free(&groups);
+}
+
+/// @summary Classifies records sixteen at a time using AVX-512F. Produces output
+/// identical to classify(). Output tables are grown as needed. The parameters
+/// are as for classify().
+TARGET_AVX512 static void classify_avx512(query_mask_t const *masks, table_t **outputs, size_t column_count, id_t const *ids, uint32_t const *bits, size_t record_count)
+{
+    classify_avx512_lanes<false, false>(masks, outputs, column_count, ids, 0, bits, record_count, NULL, NULL);
+}
+
+/// @summary The classify kernel for each simd_level_e.
+static const classify_func_t Classify_Kernels[SIMD_LEVEL_COUNT] =
+{
+    classify<uint32_t>,
+    classify_sse42,
+    classify_avx2,
+    classify_avx512
+};
+
+/// @summary Classifies a single input record based on the logic defined by the
+/// condition table.
+/// @param rec The record to classify.
+/// @param outputs An array of output tables, one for each column of Condition_Table.
+static void check_record(record_t const *rec, table_t **outputs)
+{
+    // the if chains are generated from Condition_Table; see check_record_specialized.
+    check_record_specialized<condition_table_spec_t>(rec, outputs);
+}
+
+/*//////////////////////
+//  Selection Vectors //
+//////////////////////*/
+/// @summary A selection vector is a table_t holding the positions of records
+/// rather than their IDs. The select kernels produce selection vectors without
+/// reading the ID array; IDs are looked up only when a consumer needs them, or
+/// not at all when they are implicit in the positions. A selection vector can
+/// restrict a later predicate or classify pass to the records it holds.
+typedef table_t selection_t;
+
+/// @summary The signature shared by all select kernels. See classify_positions().
+typedef void (*select_func_t)(query_mask_t const*, selection_t**, size_t, uint32_t, uint32_t const*, size_t);
+
+/// @summary Classifies records four at a time using SSE4.2, producing selection
+/// vectors. The parameters are as for classify_positions().
+TARGET_SSE42 static void select_sse42(query_mask_t const *masks, selection_t **outputs, size_t column_count, uint32_t first, uint32_t const *bits, size_t record_count)
+{
+    classify_sse42_lanes<true, false>(masks, outputs, column_count, NULL, first, bits, record_count, NULL, NULL);
+}
+
+/// @summary Classifies records eight at a time using AVX2, producing selection
+/// vectors. The parameters are as for classify_positions().
+TARGET_AVX2 static void select_avx2(query_mask_t const *masks, selection_t **outputs, size_t column_count, uint32_t first, uint32_t const *bits, size_t record_count)
+{
+    classify_avx2_lanes<true, false>(masks, outputs, column_count, NULL, first, bits, record_count, NULL, NULL);
+}
+
+/// @summary Classifies records sixteen at a time using AVX-512F, producing
+/// selection vectors. The parameters are as for classify_positions().
+TARGET_AVX512 static void select_avx512(query_mask_t const *masks, selection_t **outputs, size_t column_count, uint32_t first, uint32_t const *bits, size_t record_count)
+{
+    classify_avx512_lanes<true, false>(masks, outputs, column_count, NULL, first, bits, record_count, NULL, NULL);
+}
+
+/// @summary The select kernel for each simd_level_e.
+static const select_func_t Select_Kernels[SIMD_LEVEL_COUNT] =
+{
+    classify_positions<uint32_t>,
+    select_sse42,
+    select_avx2,
+    select_avx512
+};
+
+/// @summary Determines whether IDs are implicit in record positions, that is,
+/// whether each ID is the ID of the first record plus its position. If so, a
+/// select kernel given the first ID as its first position writes IDs directly.
+/// @param ids An array of IDs associated with each input record.
+/// @param record_count The number of input records.
+/// @return true if ids[i] == ids[0] + i for every record.
+static bool ids_dense(id_t const *ids, size_t record_count)
+{
+    for (size_t i = 0; i < record_count; ++i)
+    {
+        if (ids[i] != ids[0] + (id_t) i) return false;
+    }
+    return true;
+}
+
+/// @summary Replaces the positions in a selection vector with the IDs of the
+/// records at those positions. The selection vector then holds what classify()
+/// would have written. Positions are increasing, so the ID array is read in
+/// order and only at the selected records.
+/// @param selection The selection vector to convert in place.
+/// @param ids An array of IDs associated with each input record.
+static void selection_materialize(selection_t *selection, id_t const *ids)
+{
+    id_t *storage = selection->storage;
+    for (size_t k = 0; k < selection->count; ++k)
+    {
+        storage[k] = ids[storage[k]];
+    }
+}
+
+/// @summary Evaluates the predicates for the records of a selection vector
+/// only, producing a dense array of their bitfields.
+/// @param dst The destination bitfields, of at least selection->count elements.
+/// @param src The source record store.
+/// @param selection The positions of the records to evaluate.
+static void generate_bitfields_selected(uint32_t *dst, record_store_t const *src, selection_t const *selection)
+{
+    uint32_t const *positions = selection->storage;
+    for (size_t k = 0; k < selection->count; ++k)
+    {
+        size_t   r       = positions[k];
+        uint32_t address = proof_of_address_bit (bitmap_get(src->address_valid , r), src->verify_address [r]);
+        uint32_t ident   = proof_of_identity_bit(bitmap_get(src->identity_valid, r), src->verify_identity[r]);
+        uint32_t lt      = (uint32_t)(src->loan_amount[r] < src->annual_salary[r]);
+        uint32_t owner   = bitmap_get(src->owns_other_home, r);
+        dst[k] =
+            (address  << PROOF_OF_ADDRESS ) |
+            (ident    << PROOF_OF_IDENTITY) |
+            (lt       << LOAN_LT_SALARY   ) |
+            ((lt ^ 1) << LOAN_GE_SALARY   ) |
+            (owner    << EXISTING_OWNER   );
+    }
+}
+
+/// @summary Classifies only the records of a selection vector, from their
+/// bitfields in the full bitfield array. The outputs are selection vectors
+/// holding positions in the full record set.
+/// @param kernel The classify kernel to run on the selected bitfields.
+/// @param masks The masks generated from each column in the condition table.
+/// @param outputs An array of output selection vectors, one for each column.
+/// @param column_count The number of columns in the condition table.
+/// @param selection The positions of the records to classify.
+/// @param bits The bitfields of the full record set.
+/// @param scratch Storage for at least selection->count bitfields.
+static void classify_selection(classify_func_t kernel, query_mask_t const *masks, selection_t **outputs, size_t column_count, selection_t const *selection, uint32_t const *bits, uint32_t *scratch)
+{
+    uint32_t const *positions = selection->storage;
+    for (size_t k = 0; k < selection->count; ++k)
+    {
+        scratch[k] = bits[positions[k]];
+    }
+    output_groups_t groups;
+    output_groups_build(&groups, outputs, column_count);
+    for (size_t g = 0; g < groups.group_count; ++g)
+    {
+        table_t *table = groups.groups[g].table;
+        table_reserve(table, table->count + selection->count * groups.groups[g].count + 1);
+    }
+    output_groups_free(&groups);
+    // the positions stand in for IDs, so the outputs hold positions too.
+    kernel(masks, outputs, column_count, positions, scratch, selection->count);
+}
+
+/*////////////////////////////
+//  Parallel Classification //
+////////////////////////////*/
+/// @summary The number of records a worker processes between checks that its
+/// private output tables have room for the worst case number of matches.
+static const size_t Parallel_Block_Size = 65536;
+
+/// @summary Stores the state private to a single worker thread.
+struct parallel_worker_t
+{
+    table_t     *tables;      /// Private output tables, one per output group
+    table_t    **outputs;     /// Private output table for each column of the condition table
+    size_t       begin;       /// Index of the first record processed by the worker
+    size_t       end;         /// Index one past the last record processed by the worker
+};
+
+/// @summary Maintains per-worker output buffers for parallel classification.
+/// Workers classify contiguous chunks of the input into private tables, which
+/// are then concatenated in chunk order, so results match a sequential run.
+/// The private tables are retained between calls to avoid reallocation.
+struct parallel_classify_t
+{
+    size_t             thread_count; /// The number of worker threads, including the caller
+    size_t             table_count;  /// The number of private tables allocated per worker
+    size_t             column_count; /// The number of column entries allocated per worker
+    parallel_worker_t *workers;      /// An array of thread_count workers
+};
+
+/// @summary Initializes a parallel classification context.
+/// @param ctx The context to initialize.
+/// @param thread_count The number of threads to use; zero uses every hardware thread.
+static void parallel_classify_init(parallel_classify_t *ctx, size_t thread_count)
+{
+    if (thread_count == 0)
+    {
+        thread_count = std::thread::hardware_concurrency();
+        if (thread_count == 0) thread_count = 1;
+    }
+    ctx->thread_count = thread_count;
+    ctx->table_count  = 0;
+    ctx->column_count = 0;
+    ctx->workers      = (parallel_worker_t*) malloc(thread_count * sizeof(parallel_worker_t));
+    for (size_t t = 0; t < thread_count; ++t)
+    {
+        ctx->workers[t].tables  = NULL;
+        ctx->workers[t].outputs = NULL;
+        ctx->workers[t].begin   = 0;
+        ctx->workers[t].end     = 0;
+    }
+}
+
+/// @summary Frees the storage associated with a parallel classification context.
+/// @param ctx The context to free.
+static void parallel_classify_free(parallel_classify_t *ctx)
+{
+    for (size_t t = 0; t < ctx->thread_count; ++t)
+    {
+        for (size_t g = 0; g < ctx->table_count; ++g)
+        {
+            table_free(&ctx->workers[t].tables[g]);
+        }
+        free(ctx->workers[t].tables);
+        free(ctx->workers[t].outputs);
+    }
+    free(ctx->workers);
+    ctx->thread_count = 0;
+    ctx->table_count  = 0;
+    ctx->column_count = 0;
+    ctx->workers      = NULL;
+}
+
+/// @summary Runs a function on every worker, one thread per worker. The calling
+/// thread runs worker zero and returns after all workers have finished.
+/// @param ctx The parallel classification context.
+/// @param func A callable invoked as func(parallel_worker_t*).
+template <typename worker_func_t>
+static void parallel_run(parallel_classify_t *ctx, worker_func_t const &func)
+{
+    std::vector<std::thread> threads;
+    threads.reserve(ctx->thread_count);
+    for (size_t t = 1; t < ctx->thread_count; ++t)
+    {
+        parallel_worker_t *worker = &ctx->workers[t];
+        threads.push_back(std::thread([&func, worker]() { func(worker); }));
+    }
+    func(&ctx->workers[0]);
+    for (size_t t = 0; t < threads.size(); ++t)
+    {
+        threads[t].join();
+    }
+}
+
+/// @summary Assigns each worker a contiguous chunk of the input and points its
+/// per-column outputs at its private tables, which are cleared.
+/// @param ctx The parallel classification context.
+/// @param groups The columns of the condition table grouped by output table.
+/// @param column_count The number of columns in the condition table.
+/// @param record_count The total number of input records.
+static void parallel_prepare(parallel_classify_t *ctx, output_groups_t const *groups, size_t column_count, size_t record_count)
+{
+    if (ctx->table_count < groups->group_count)
+    {
+        for (size_t t = 0; t < ctx->thread_count; ++t)
+        {
+            parallel_worker_t *w = &ctx->workers[t];
+            w->tables = (table_t*) realloc(w->tables, groups->group_count * sizeof(table_t));
+            for (size_t g = ctx->table_count; g < groups->group_count; ++g)
+            {
+                table_init(&w->tables[g]);
+            }
+        }
+        ctx->table_count = groups->group_count;
+    }
+    if (ctx->column_count < column_count)
+    {
+        for (size_t t = 0; t < ctx->thread_count; ++t)
+        {
+            parallel_worker_t *w = &ctx->workers[t];
+            w->outputs = (table_t**) realloc(w->outputs, column_count * sizeof(table_t*));
+        }
+        ctx->column_count = column_count;
+    }
+
+    // chunk boundaries are kept a multiple of 64 records so SIMD kernels only
+    // take their scalar tail on the final chunk.
+    size_t per_worker = (record_count + ctx->thread_count - 1) / ctx->thread_count;
+    per_worker = (per_worker + 63) & ~size_t(63);
+    for (size_t t = 0; t < ctx->thread_count; ++t)
+    {
+        parallel_worker_t *w = &ctx->workers[t];
+        size_t begin = t * per_worker;
+        size_t end   = begin + per_worker;
+        w->begin = begin < record_count ? begin : record_count;
+        w->end   = end   < record_count ? end   : record_count;
+        for (size_t g = 0; g < groups->group_count; ++g)
+        {
+            table_clear(&w->tables[g]);
+            for (uint32_t k = 0; k < groups->groups[g].count; ++k)
+            {
+                w->outputs[groups->columns[groups->groups[g].first + k]] = &w->tables[g];
+            }
+        }
+    }
+}
+
+/// @summary Ensures each private table of a worker can absorb the worst case
+/// number of matches for a block of records.
+/// @param w The worker whose tables are checked.
+/// @param groups The columns of the condition table grouped by output table.
+/// @param block_size The number of records in the block.
+static void parallel_reserve_block(parallel_worker_t *w, output_groups_t const *groups, size_t block_size)
+{
+    for (size_t g = 0; g < groups->group_count; ++g)
+    {
+        table_t *table = &w->tables[g];
+        table_reserve(table, table->count + block_size * groups->groups[g].count + 1);
+    }
+}
+
+/// @summary Appends the private results of every worker to the shared output
+/// tables in worker order. Offsets are computed with a prefix sum over the
+/// per-worker counts, after which the workers copy their results in parallel.
+/// @param ctx The parallel classification context.
+/// @param groups The columns of the condition table grouped by output table.
+static void parallel_merge(parallel_classify_t *ctx, output_groups_t const *groups)
+{
+    std::vector<size_t> offsets(ctx->thread_count * groups->group_count);
+    for (size_t g = 0; g < groups->group_count; ++g)
+    {
+        table_t *table = groups->groups[g].table;
+        size_t   total = table->count;
+        for (size_t t = 0; t < ctx->thread_count; ++t)
+        {
+            offsets[t * groups->group_count + g] = total;
+            total += ctx->workers[t].tables[g].count;
+        }
+        table_reserve(table, total + 1);
+        table->count = total;
+    }
+    parallel_worker_t *first = &ctx->workers[0];
+    parallel_run(ctx, [&](parallel_worker_t *w)
+    {
+        size_t t = (size_t)(w - first);
+        for (size_t g = 0; g < groups->group_count; ++g)
+        {
+            table_t const *src = &w->tables[g];
+            table_t       *dst =  groups->groups[g].table;
+            if (src->count)
+            {
+                memcpy(&dst->storage[offsets[t * groups->group_count + g]], src->storage, src->count * sizeof(id_t));
+            }
+        }
+    });
+}
+
+/// @summary Classifies records on multiple threads. Produces output identical
+/// to a sequential call to the kernel. Output tables are grown as needed.
+/// @param ctx The parallel classification context.
+/// @param kernel The classify kernel to run on each chunk of the input.
+/// @param masks The masks generated from each column in the condition table.
+/// @param outputs An array of output tables, one for each column.
+/// @param column_count The number of columns in the condition table.
+/// @param ids An array of IDs associated with each input record.
+/// @param bits An array of bitfields computed for each input record.
+/// @param record_count The number of input records.
+static void classify_parallel(parallel_classify_t *ctx, classify_func_t kernel, query_mask_t const *masks, table_t **outputs, size_t column_count, id_t const *ids, uint32_t const *bits, size_t record_count)
+{
+    output_groups_t groups;
+    output_groups_build(&groups, outputs, column_count);
+    parallel_prepare(ctx, &groups, column_count, record_count);
+    parallel_run(ctx, [&](parallel_worker_t *w)
+    {
+        for (size_t i = w->begin; i < w->end; i += Parallel_Block_Size)
+        {
+            size_t n = (w->end - i) < Parallel_Block_Size ? (w->end - i) : Parallel_Block_Size;
+            parallel_reserve_block(w, &groups, n);
+            kernel(masks, w->outputs, column_count, ids + i, bits + i, n);
+        }
+    });
+    parallel_merge(ctx, &groups);
+    output_groups_free(&groups);
+}
+
+/// @summary Classifies records on multiple threads using check_record().
+/// Produces output identical to calling check_record() for each record in order.
+/// @param ctx The parallel classification context.
+/// @param outputs An array of output tables, one for each column of Condition_Table.
+/// @param records The array of records to classify.
+/// @param record_count The number of input records.
+static void check_records_parallel(parallel_classify_t *ctx, table_t **outputs, record_t const *records, size_t record_count)
+{
+    output_groups_t groups;
+    output_groups_build(&groups, outputs, Table_Cols);
+    parallel_prepare(ctx, &groups, Table_Cols, record_count);
+    parallel_run(ctx, [&](parallel_worker_t *w)
+    {
+        for (size_t i = w->begin; i < w->end; i += Parallel_Block_Size)
+        {
+            size_t n = (w->end - i) < Parallel_Block_Size ? (w->end - i) : Parallel_Block_Size;
+            parallel_reserve_block(w, &groups, n);
+            for (size_t r = i; r < i + n; ++r)
+            {
+                check_record(&records[r], w->outputs);
+            }
+        }
+    });
+    parallel_merge(ctx, &groups);
+    output_groups_free(&groups);
+}
+
+/*//////////////////////
+//  NUMA Partitions   //
+//////////////////////*/
+/// @summary Describes which logical CPUs belong to each NUMA node.
+struct numa_topology_t
+{
+    size_t                             node_count; /// The number of nodes
+    std::vector<std::vector<uint32_t>> cpus;       /// The logical CPUs of each node, ascending
+    bool                               emulated;   /// true if the nodes were made up by splitting the CPUs
+};
+
+/// @summary Parses a Linux CPU list, such as "0-3,8-11", appending each CPU.
+/// @param list The nul-terminated CPU list.
+/// @param cpus The vector to append to.
+static void numa_parse_cpu_list(char const *list, std::vector<uint32_t> *cpus)
+{
+    char const *p = list;
+    while (*p)
+    {
+        char    *end   = NULL;
+        uint32_t first = (uint32_t) strtoul(p, &end, 10);
+        uint32_t last  = first;
+        if (end == p)
+        {
+            break;
+        }
+        p = end;
+        if (*p == '-')
+        {
+            last = (uint32_t) strtoul(p + 1, &end, 10);
+            p    = end;
+        }
+        for (uint32_t c = first; c <= last; ++c)
+        {
+            cpus->push_back(c);
+        }
+        if (*p == ',') ++p;
+        else break;
+    }
+}
+
+/// @summary Discovers the NUMA topology of the host, or makes one up. On
+/// Linux the nodes are read from /sys/devices/system/node, which is what
+/// libnuma reads, so no library is needed; elsewhere the host is treated as
+/// a single node. An emulated topology splits the CPUs into equal contiguous
+/// groups, so partitioned execution can be exercised on a single-node box.
+/// @param topo The topology to initialize.
+/// @param emulate_nodes The number of nodes to emulate, or zero to detect.
+static void numa_topology_detect(numa_topology_t *topo, size_t emulate_nodes)
+{
+    topo->cpus.clear();
+    topo->emulated = false;
+#if defined(__linux__)
+    for (uint32_t node = 0; node < 1024; ++node)
+    {
+        char  path[128];
+        char  list[4096];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%u/cpulist", node);
+        FILE *fp = fopen(path, "r");
+        if (fp == NULL)
+        {
+            if (node > 0 && topo->cpus.size() > 0) break;
+            continue;
+        }
+        std::vector<uint32_t> cpus;
+        if (fgets(list, sizeof(list), fp) != NULL)
+        {
+            numa_parse_cpu_list(list, &cpus);
+        }
+        fclose(fp);
+        if (!cpus.empty())
+        {   // memory-only nodes have no CPUs to run workers on.
+            topo->cpus.push_back(cpus);
+        }
+    }
+#endif
+    if (topo->cpus.empty())
+    {
+        size_t count = std::max<size_t>(1, std::thread::hardware_concurrency());
+        topo->cpus.resize(1);
+        for (size_t c = 0; c < count; ++c)
+        {
+            topo->cpus[0].push_back((uint32_t) c);
+        }
+    }
+    if (emulate_nodes > 0)
+    {
+        std::vector<uint32_t> all;
+        for (size_t n = 0; n < topo->cpus.size(); ++n)
+        {
+            all.insert(all.end(), topo->cpus[n].begin(), topo->cpus[n].end());
+        }
+        std::sort(all.begin(), all.end());
+        topo->cpus.assign(emulate_nodes, std::vector<uint32_t>());
+        for (size_t n = 0; n < emulate_nodes; ++n)
+        {
+            size_t first = (all.size() * n) / emulate_nodes;
+            size_t last  = (all.size() * (n + 1)) / emulate_nodes;
+            if (first == last)
+            {   // more nodes than CPUs; nodes share.
+                last = first + 1;
+            }
+            for (size_t c = first; c < last; ++c)
+            {
+                topo->cpus[n].push_back(all[c % all.size()]);
+            }
+        }
+        topo->emulated = true;
+    }
+    topo->node_count = topo->cpus.size();
+}
+
+/// @summary Restricts the calling thread to the CPUs of one node. Threads
+/// started afterwards by the caller inherit the restriction. Failure, for
+/// example in a container that forbids it, leaves the thread unpinned.
+/// @param topo The NUMA topology.
+/// @param node The zero-based index of the node.
+/// @return true if the thread was pinned.
+static bool numa_pin_thread(numa_topology_t const *topo, size_t node)
+{
+    std::vector<uint32_t> const &cpus = topo->cpus[node];
+#if defined(_WIN32)
+    DWORD_PTR mask = 0;
+    for (size_t c = 0; c < cpus.size(); ++c)
+    {
+        if (cpus[c] < sizeof(DWORD_PTR) * 8) mask |= DWORD_PTR(1) << cpus[c];
+    }
+    return mask != 0 && SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (size_t c = 0; c < cpus.size(); ++c)
+    {
+        if (cpus[c] < CPU_SETSIZE) CPU_SET(cpus[c], &set);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    UNUSED(cpus);
+    return false;
+#endif
+}
+
+/// @summary The records assigned to one NUMA node, and the node's workers.
+/// Everything here is allocated and first touched by threads pinned to the
+/// node, so it is local to it.
+struct numa_shard_t
+{
+    size_t              first;   /// Index of the shard's first record in the full record set
+    size_t              count;   /// The number of records in the shard
+    record_store_t      store;   /// The shard's records, including their IDs
+    uint32_t           *bits;    /// The shard's bitfields, count elements
+    parallel_classify_t workers; /// The node's workers and their private output tables
+};
+
+/// @summary Splits the record set into one shard per NUMA node, so that each
+/// node generates bitfields and classifies only from its own memory. The
+/// per-node results are merged into the shared output tables at the end.
+struct numa_partition_t
+{
+    numa_topology_t     topology; /// The nodes, real or emulated
+    numa_shard_t       *shards;   /// One shard per node
+    bool                pinned;   /// true if every node's threads could be pinned
+};
+
+/// @summary Runs a function once per node, each on its own thread pinned to
+/// the node, and waits for all of them.
+/// @param part The NUMA partition.
+/// @param func A callable invoked as func(size_t node, numa_shard_t*).
+template <typename node_func_t>
+static void numa_run(numa_partition_t *part, node_func_t const &func)
+{
+    std::vector<std::thread> threads;
+    std::vector<char>        pinned(part->topology.node_count, 0);
+    threads.reserve(part->topology.node_count);
+    for (size_t n = 0; n < part->topology.node_count; ++n)
+    {
+        threads.push_back(std::thread([part, &func, &pinned, n]()
+        {
+            pinned[n] = numa_pin_thread(&part->topology, n) ? 1 : 0;
+            func(n, &part->shards[n]);
+        }));
+    }
+    for (size_t n = 0; n < threads.size(); ++n)
+    {
+        threads[n].join();
+    }
+    part->pinned = std::find(pinned.begin(), pinned.end(), 0) == pinned.end();
+}
+
+/// @summary Partitions a record set across NUMA nodes. Shards are contiguous
+/// ranges, sized in proportion to each node's CPU count and rounded to a
+/// multiple of 64 records; each is copied into a record store on its node.
+/// @param part The partition to initialize. Free with numa_partition_free().
+/// @param emulate_nodes The number of nodes to emulate, or zero to detect.
+/// @param thread_total The number of workers across all nodes, split evenly
+/// over the nodes found (at least one each); zero uses one per CPU of each node.
+/// @param records The records to partition.
+/// @param record_count The number of records.
+static void numa_partition_init(numa_partition_t *part, size_t emulate_nodes, size_t thread_total, record_t const *records, size_t record_count)
+{
+    numa_topology_detect(&part->topology, emulate_nodes);
+    size_t node_count = part->topology.node_count;
+    size_t threads_per_node = thread_total ? std::max<size_t>(1, thread_total / node_count) : 0;
+    size_t cpu_total  = 0;
+    for (size_t n = 0; n < node_count; ++n)
+    {
+        cpu_total += part->topology.cpus[n].size();
+    }
+    part->shards = new numa_shard_t[node_count];
+    size_t first = 0;
+    size_t cpus  = 0;
+    for (size_t n = 0; n < node_count; ++n)
+    {
+        cpus += part->topology.cpus[n].size();
+        size_t end = (n + 1 == node_count) ? record_count : std::min(record_count, ((record_count * cpus / cpu_total) + 63) & ~size_t(63));
+        part->shards[n].first = first;
+        part->shards[n].count = end - first;
+        part->shards[n].bits  = NULL;
+        memset(&part->shards[n].store, 0, sizeof(record_store_t));
+        parallel_classify_init(&part->shards[n].workers, threads_per_node ? threads_per_node : part->topology.cpus[n].size());
+        first = end;
+    }
+    numa_run(part, [records](size_t, numa_shard_t *shard)
+    {
+        // worker ranges are multiples of 64 records, so no two workers share
+        // a word of the store's bitmaps.
+        output_groups_t none;
+        none.group_count = 0;
+        record_store_init(&shard->store, shard->count);
+        shard->store.count = shard->count;
+        shard->bits = (uint32_t*) memory_alloc(shard->count * sizeof(uint32_t));
+        parallel_prepare(&shard->workers, &none, 0, shard->count);
+        parallel_run(&shard->workers, [shard, records](parallel_worker_t *w)
+        {
+            for (size_t i = w->begin; i < w->end; ++i)
+            {
+                record_store_set(&shard->store, i, &records[shard->first + i]);
+                shard->bits[i] = 0;
+            }
+        });
+    });
+}
+
+/// @summary Frees the shards of a NUMA partition.
+/// @param part The partition to free.
+static void numa_partition_free(numa_partition_t *part)
+{
+    for (size_t n = 0; n < part->topology.node_count; ++n)
+    {
+        numa_shard_t *shard = &part->shards[n];
+        parallel_classify_free(&shard->workers);
+        memory_free(shard->bits, shard->count * sizeof(uint32_t));
+        record_store_free(&shard->store);
+    }
+    delete[] part->shards;
+    part->shards = NULL;
+}
+
+/// @summary Generates bitfields and classifies every shard on its own node,
+/// then merges the per-node results into the output tables in record order.
+/// Produces output identical to a sequential call to the kernel over the
+/// whole record set. Output tables are grown as needed.
+/// @param part The NUMA partition.
+/// @param kernel The classify kernel to run on each block of records.
+/// @param masks The masks generated from each column in the condition table.
+/// @param outputs An array of output tables, one for each column.
+/// @param column_count The number of columns in the condition table.
+static void classify_numa(numa_partition_t *part, classify_func_t kernel, query_mask_t const *masks, table_t **outputs, size_t column_count)
+{
+    output_groups_t groups;
+    output_groups_build(&groups, outputs, column_count);
+    numa_run(part, [&](size_t, numa_shard_t *shard)
+    {
+        parallel_prepare(&shard->workers, &groups, column_count, shard->count);
+        parallel_run(&shard->workers, [&](parallel_worker_t *w)
+        {
+            for (size_t i = w->begin; i < w->end; i += Parallel_Block_Size)
+            {
+                size_t n = (w->end - i) < Parallel_Block_Size ? (w->end - i) : Parallel_Block_Size;
+                generate_bitfields(shard->bits + i, &shard->store, i, n);
+                parallel_reserve_block(w, &groups, n);
+                kernel(masks, w->outputs, column_count, shard->store.id + i, shard->bits + i, n);
+            }
+        });
+    });
+    for (size_t n = 0; n < part->topology.node_count; ++n)
+    {
+        parallel_merge(&part->shards[n].workers, &groups);
+    }
+    output_groups_free(&groups);
+}
+
+/// @summary Generates bitfields and classifies a single shared record store
+/// on unpinned threads, as classify_numa() does per shard. This is the
+/// baseline for partitioned execution.
+/// @param ctx The parallel classification context.
+/// @param kernel The classify kernel to run on each block of records.
+/// @param masks The masks generated from each column in the condition table.
+/// @param outputs An array of output tables, one for each column.
+/// @param column_count The number of columns in the condition table.
+/// @param store The record store.
+/// @param bits Storage for store->count bitfields.
+static void classify_shared(parallel_classify_t *ctx, classify_func_t kernel, query_mask_t const *masks, table_t **outputs, size_t column_count, record_store_t const *store, uint32_t *bits)
+{
+    output_groups_t groups;
+    output_groups_build(&groups, outputs, column_count);
+    parallel_prepare(ctx, &groups, column_count, store->count);
+    parallel_run(ctx, [&](parallel_worker_t *w)
+    {
+        for (size_t i = w->begin; i < w->end; i += Parallel_Block_Size)
+        {
+            size_t n = (w->end - i) < Parallel_Block_Size ? (w->end - i) : Parallel_Block_Size;
+            generate_bitfields(bits + i, store, i, n);
+            parallel_reserve_block(w, &groups, n);
+            kernel(masks, w->outputs, column_count, store->id + i, bits + i, n);
+        }
+    });
+    parallel_merge(ctx, &groups);
+    output_groups_free(&groups);
+}
+
+/*//////////////////////
+//  Record Generator  //
+//////////////////////*/
+/// @summary Define the shapes available for randomly generated amounts.
+enum distribution_e
+{
+    DISTRIBUTION_UNIFORM               = 0, // every value in [min, max] equally likely
+    DISTRIBUTION_NORMAL                = 1, // bell-shaped about the middle of [min, max]
+    DISTRIBUTION_COUNT                 = 2
+};
+
+/// @summary A lookup table of strings for pretty-printing and parsing distribution_e values.
+static char const *Distribution_Names[DISTRIBUTION_COUNT] =
+{
+    "uniform",
+    "normal"
+};
+
+/// @summary Parameters controlling the synthetic record generator. Each
+/// record is derived only from the seed and its index, so a given set of
+/// parameters produces the same records on any number of threads.
+struct generator_params_t
+{
+    uint64_t       seed;                  /// The seed for the counter-based generator
+    double         null_address;          /// The fraction of records with a NULL address
+    double         null_identity;         /// The fraction of records with a NULL identity
+    double         home_owner;            /// The fraction of applicants who own another home
+    distribution_e salary_distribution;   /// The shape of the annual salary distribution
+    uint32_t       salary_min;            /// The smallest annual salary, in whole dollars
+    uint32_t       salary_max;            /// The largest annual salary, in whole dollars
+    distribution_e loan_distribution;     /// The shape of the loan amount distribution
+    uint32_t       loan_min;              /// The smallest loan amount, in whole dollars
+    uint32_t       loan_max;              /// The largest loan amount, in whole dollars
+    size_t         cluster_size;          /// Runs of this many records share their address,
+                                          /// identity, verification and home owner fields
+    bool           sorted_salary;         /// true to make salaries increase with record index
+};
+
+/// @summary Sets generator parameters matching the distribution of the original
+/// rand()-based record generator.
+/// @param params The parameters to initialize.
+/// @param seed The seed for the counter-based generator.
+static void generator_params_init(generator_params_t *params, uint64_t seed)
+{
+    params->seed                = seed;
+    params->null_address        = 0.2;
+    params->null_identity       = 0.3;
+    params->home_owner          = 0.5;
+    params->salary_distribution = DISTRIBUTION_UNIFORM;
+    params->salary_min          = 10000U;
+    params->salary_max          = 250000U;
+    params->loan_distribution   = DISTRIBUTION_UNIFORM;
+    params->loan_min            = 1000U;
+    params->loan_max            = 500000U;
+    params->cluster_size        = 1;
+    params->sorted_salary       = false;
+}
+
+/// @summary The state of a counter-based random stream, keyed by the seed
+/// and a record index. Each value is the SplitMix64 finalizer applied to
+/// key + counter * golden ratio, so any stream can be started without
+/// generating the values that come before it.
+struct counter_rng_t
+{
+    uint64_t       key;                   /// The stream key, derived from the seed and index
+    uint64_t       counter;               /// The number of values drawn from the stream
+};
+
+/// @summary Applies the SplitMix64 finalizer, a bijective 64-bit mixer.
+/// @param x The value to mix.
+/// @return The mixed value.
+static inline uint64_t mix64(uint64_t x)
+{
+    x ^= x >> 30; x *= 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 27; x *= 0x94D049BB133111EBULL;
+    x ^= x >> 31;
+    return x;
+}
+
+/// @summary Starts a random stream for a given seed, stream and index.
+/// @param rng The stream to initialize.
+/// @param seed The generator seed.
+/// @param stream Identifies independent streams for the same index.
+/// @param index The record or cluster index.
+static inline void counter_rng_init(counter_rng_t *rng, uint64_t seed, uint64_t stream, uint64_t index)
+{
+    rng->key     = mix64(seed ^ mix64(index * 2 + stream + 1));
+    rng->counter = 0;
+}
+
+/// @summary Draws the next value from a random stream.
+/// @param rng The stream state.
+/// @return A uniformly distributed 64-bit value.
+static inline uint64_t counter_rng_next(counter_rng_t *rng)
+{
+    return mix64(rng->key + (++rng->counter) * 0x9E3779B97F4A7C15ULL);
+}
+
+/// @summary Draws a uniformly distributed value in [0, 1).
+/// @param rng The stream state.
+/// @return A value in [0, 1).
+static inline double counter_rng_unit(counter_rng_t *rng)
+{
+    return double(counter_rng_next(rng) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/// @summary Draws a value in [0, n) without modulo bias worth worrying about
+/// for the small ranges used here.
+/// @param rng The stream state.
+/// @param n The number of possible values.
+/// @return A value in [0, n).
+static inline uint32_t counter_rng_below(counter_rng_t *rng, uint32_t n)
+{
+    return (uint32_t)(((counter_rng_next(rng) >> 32) * n) >> 32);
+}
+
+/// @summary Draws an amount in [min, max] from a distribution.
+/// @param rng The stream state.
+/// @param dist One of distribution_e.
+/// @param min The inclusive lower bound.
+/// @param max The inclusive upper bound.
+/// @return A value in [min, max].
+static inline uint32_t counter_rng_amount(counter_rng_t *rng, distribution_e dist, uint32_t min, uint32_t max)
+{
+    double u;
+    if (dist == DISTRIBUTION_NORMAL)
+    {
+        // the mean of four uniforms (Irwin-Hall) is close to normal and stays in range.
+        u = (counter_rng_unit(rng) + counter_rng_unit(rng) + counter_rng_unit(rng) + counter_rng_unit(rng)) * 0.25;
+    }
+    else u = counter_rng_unit(rng);
+    return min + (uint32_t)(u * double(max - min + 1));
+}
+
+/// @summary Draws verification flags: up to three draws from Verification_Methods,
+/// each chosen uniformly.
+/// @param rng The stream state.
+/// @return A combination of verification_method_e.
+static inline uint32_t counter_rng_verifyflags(counter_rng_t *rng)
+{
+    uint32_t flags = VERIFICATION_METHOD_NONE;
+    uint32_t count = counter_rng_below(rng, VERIFICATION_METHOD_COUNT);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        flags |= Verification_Methods[counter_rng_below(rng, VERIFICATION_METHOD_COUNT)];
+    }
+    return flags;
+}
+
+/// @summary Selects a non-NULL entry from a list of sample strings.
+/// @param list The list of sample strings, which must contain a non-NULL entry.
+/// @param count The number of entries in the list.
+/// @param index The preferred index; the next non-NULL entry is used if it is NULL.
+/// @return A NULL-terminated string literal.
+static inline char const* sample_entry(char const **list, size_t count, uint32_t index)
+{
+    while (list[index % count] == NULL) ++index;
+    return list[index % count];
+}
+
+/// @summary Generates a range of records. Record i is assigned ID first_id + i
+/// and depends only on the parameters and i.
+/// @param records The array of count records to populate, starting at record first.
+/// @param ids An array of count IDs to populate, or NULL.
+/// @param first The index of the first record to generate.
+/// @param count The number of records to generate.
+/// @param total The total number of records in the set, used by sorted_salary.
+/// @param first_id The ID of record zero.
+/// @param params The generator parameters.
+static void generate_records(record_t *records, id_t *ids, size_t first, size_t count, size_t total, id_t first_id, generator_params_t const *params)
+{
+    size_t cluster_size = params->cluster_size ? params->cluster_size : 1;
+    double salary_range = double(params->salary_max - params->salary_min);
+    for (size_t i = 0; i < count; ++i)
+    {
+        size_t        index = first + i;
+        record_t     *rec   = &records[i];
+        counter_rng_t shared, own;
+        counter_rng_init(&shared, params->seed, 0, index / cluster_size);
+        counter_rng_init(&own   , params->seed, 1, index);
+
+        // NULL entries are drawn by fraction; non-NULL entries from the valid list.
+        rec->id              = first_id + (id_t) index;
+        rec->address         = counter_rng_unit(&shared) < params->null_address  ? NULL : sample_entry(Address_List , Address_Count , counter_rng_below(&shared, Address_Count));
+        rec->identity        = counter_rng_unit(&shared) < params->null_identity ? NULL : sample_entry(Identity_List, Identity_Count, counter_rng_below(&shared, Identity_Count));
+        rec->owns_other_home = counter_rng_unit(&shared) < params->home_owner;
+        rec->verify_address  = counter_rng_verifyflags(&shared);
+        rec->verify_identity = counter_rng_verifyflags(&shared);
+        if (params->sorted_salary)
+        {
+            double t = (double(index) + counter_rng_unit(&own)) / double(total);
+            rec->annual_salary = params->salary_min + (uint32_t)(t * salary_range);
+        }
+        else rec->annual_salary = counter_rng_amount(&own, params->salary_distribution, params->salary_min, params->salary_max);
+        rec->loan_amount     = counter_rng_amount(&own, params->loan_distribution, params->loan_min, params->loan_max);
+        if (ids != NULL)
+        {
+            ids[i] = rec->id;
+        }
+    }
+}
+
+/// @summary Generates a record set in parallel, one contiguous chunk per
+/// thread. The output is identical for any thread count.
+/// @param records The array of count records to populate.
+/// @param ids An array of count IDs to populate, or NULL.
+/// @param count The number of records to generate.
+/// @param first_id The ID of the first record.
+/// @param params The generator parameters.
+/// @param thread_count The number of threads to use; zero uses every hardware thread.
+static void generate_records_parallel(record_t *records, id_t *ids, size_t count, id_t first_id, generator_params_t const *params, size_t thread_count)
+{
+    parallel_classify_t ctx;
+    parallel_classify_init(&ctx, thread_count);
+    size_t chunk = (count + ctx.thread_count - 1) / ctx.thread_count;
+    for (size_t t = 0; t < ctx.thread_count; ++t)
+    {
+        ctx.workers[t].begin = (t * chunk < count) ? t * chunk : count;
+        ctx.workers[t].end   = (ctx.workers[t].begin + chunk < count) ? ctx.workers[t].begin + chunk : count;
+    }
+    parallel_run(&ctx, [=](parallel_worker_t *worker)
+    {
+        generate_records(records + worker->begin, ids ? ids + worker->begin : NULL, worker->begin, worker->end - worker->begin, count, first_id, params);
+    });
+    parallel_classify_free(&ctx);
+}
+
+/*//////////////////////
+//  Record Files      //
+//////////////////////*/
+/// @summary The magic number at the start of a record file ('CTBLRECS').
+static const uint64_t Record_File_Magic   = 0x5343455242544C43ULL;
+
+/// @summary The current version of the record file format.
+static const uint32_t Record_File_Version = 1;
+
+/// @summary Columns are aligned to page boundaries so each can be mapped and
+/// advised independently.
+static const uint64_t Record_File_Alignment = 4096;
+
+/// @summary Define the columns stored in a record file, in file order.
+enum record_column_e
+{
+    RECORD_COLUMN_ID                   = 0,  // id_t per record
+    RECORD_COLUMN_ANNUAL_SALARY        = 1,  // uint32_t per record
+    RECORD_COLUMN_LOAN_AMOUNT          = 2,  // uint32_t per record
+    RECORD_COLUMN_VERIFY_ADDRESS       = 3,  // uint8_t per record
+    RECORD_COLUMN_VERIFY_IDENTITY      = 4,  // uint8_t per record
+    RECORD_COLUMN_OWNS_OTHER_HOME      = 5,  // bitmap, uint64_t per 64 records
+    RECORD_COLUMN_ADDRESS_VALID        = 6,  // bitmap, uint64_t per 64 records
+    RECORD_COLUMN_IDENTITY_VALID       = 7,  // bitmap, uint64_t per 64 records
+    RECORD_COLUMN_ADDRESS_OFFSETS      = 8,  // uint64_t per record, plus one
+    RECORD_COLUMN_ADDRESS_BYTES        = 9,  // string bytes, without terminators
+    RECORD_COLUMN_IDENTITY_OFFSETS     = 10, // uint64_t per record, plus one
+    RECORD_COLUMN_IDENTITY_BYTES       = 11, // string bytes, without terminators
+    RECORD_COLUMN_COUNT                = 12
+};
+
+/// @summary Describes the location of a column within a record file.
+struct record_file_column_t
+{
+    uint64_t           offset;        /// The byte offset of the column from the start of the file
+    uint64_t           size;          /// The size of the column data, in bytes
+};
+
+/// @summary The header at the start of a record file.
+struct record_file_header_t
+{
+    uint64_t           magic;         /// Record_File_Magic
+    uint32_t           version;       /// Record_File_Version
+    uint32_t           column_count;  /// RECORD_COLUMN_COUNT
+    uint64_t           record_count;  /// The number of records in the file
+    uint64_t           file_size;     /// The total size of the file, in bytes
+    record_file_column_t columns[RECORD_COLUMN_COUNT];
+};
+
+/// @summary A read-only memory mapping of an entire file.
+struct file_mapping_t
+{
+    uint8_t const     *base;          /// The address of the first byte of the file
+    size_t             size;          /// The size of the file, in bytes
+#if defined(_WIN32)
+    HANDLE             file;          /// The open file handle
+    HANDLE             mapping;       /// The file mapping object
+#else
+    int                fd;            /// The open file descriptor
+#endif
+};
+
+/// @summary A string column, stored as an offset index into a byte array.
+/// String i occupies bytes [offsets[i], offsets[i+1]).
+struct string_column_t
+{
+    uint64_t const    *offsets;       /// record_count + 1 offsets into bytes
+    char const        *bytes;         /// The concatenated string data
+};
+
+/// @summary A record file opened for reading. The record store columns point
+/// directly into the file mapping; nothing is copied.
+struct record_file_t
+{
+    file_mapping_t     mapping;       /// The mapping of the file
+    record_store_t     store;         /// The numeric columns and bitmaps, viewing the mapping
+    string_column_t    address;       /// The address of each record; NULL where address_valid is clear
+    string_column_t    identity;      /// The identity of each record; NULL where identity_valid is clear
+};
+
+/// @summary Maps an entire file into memory for reading.
+/// @param mapping The mapping to initialize.
+/// @param path The path of the file to map.
+/// @return true if the file was mapped.
+static bool file_mapping_open(file_mapping_t *mapping, char const *path)
+{
+    memset(mapping, 0, sizeof(file_mapping_t));
+#if defined(_WIN32)
+    LARGE_INTEGER size;
+    mapping->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (mapping->file == INVALID_HANDLE_VALUE)
+        return false;
+    if (!GetFileSizeEx(mapping->file, &size) || size.QuadPart == 0)
+    {
+        CloseHandle(mapping->file);
+        return false;
+    }
+    mapping->mapping = CreateFileMappingA(mapping->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping->mapping == NULL)
+    {
+        CloseHandle(mapping->file);
+        return false;
+    }
+    mapping->base = (uint8_t const*) MapViewOfFile(mapping->mapping, FILE_MAP_READ, 0, 0, 0);
+    mapping->size = (size_t) size.QuadPart;
+    if (mapping->base == NULL)
+    {
+        CloseHandle(mapping->mapping);
+        CloseHandle(mapping->file);
+        return false;
+    }
+#else
+    struct stat st;
+    mapping->fd = open(path, O_RDONLY);
+    if (mapping->fd < 0)
+        return false;
+    if (fstat(mapping->fd, &st) != 0 || st.st_size == 0)
+    {
+        close(mapping->fd);
+        return false;
+    }
+    void *base = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, mapping->fd, 0);
+    if (base == MAP_FAILED)
+    {
+        close(mapping->fd);
+        return false;
+    }
+    mapping->base = (uint8_t const*) base;
+    mapping->size = (size_t) st.st_size;
+#endif
+    return true;
+}
+
+/// @summary Tells the operating system how a range of a mapping will be used.
+/// On Windows, where the equivalent calls need Windows 8, this does nothing.
+/// @param mapping The file mapping.
+/// @param offset The byte offset of the range within the file.
+/// @param size The size of the range, in bytes.
+/// @param will_need true to start reading the range in now; false to only
+/// mark it for sequential access.
+static void file_mapping_advise(file_mapping_t const *mapping, uint64_t offset, uint64_t size, bool will_need)
+{
+#if defined(_WIN32)
+    UNUSED(mapping);
+    UNUSED(offset);
+    UNUSED(size);
+    UNUSED(will_need);
+#else
+    // madvise requires a page-aligned start address.
+    uint64_t start = offset & ~(Record_File_Alignment - 1);
+    void    *addr  = (void*)(mapping->base + start);
+    size_t   len   = (size_t)(size + (offset - start));
+    madvise(addr, len, MADV_SEQUENTIAL);
+    if (will_need) madvise(addr, len, MADV_WILLNEED);
+#endif
+}
+
+/// @summary Unmaps a file mapped with file_mapping_open.
+/// @param mapping The mapping to close.
+static void file_mapping_close(file_mapping_t *mapping)
+{
+    if (mapping->base == NULL)
+        return;
+#if defined(_WIN32)
+    UnmapViewOfFile(mapping->base);
+    CloseHandle(mapping->mapping);
+    CloseHandle(mapping->file);
+#else
+    munmap((void*) mapping->base, mapping->size);
+    close(mapping->fd);
+#endif
+    memset(mapping, 0, sizeof(file_mapping_t));
+}
+
+/// @summary Computes the layout of a record file.
+/// @param header The header to fill out.
+/// @param record_count The number of records in the file.
+/// @param address_bytes The total length of all addresses.
+/// @param identity_bytes The total length of all identities.
+static void record_file_layout(record_file_header_t *header, uint64_t record_count, uint64_t address_bytes, uint64_t identity_bytes)
+{
+    uint64_t bitmap_bytes = ((record_count + 63) / 64) * sizeof(uint64_t);
+    uint64_t sizes[RECORD_COLUMN_COUNT] =
+    {
+        record_count * sizeof(id_t),
+        record_count * sizeof(uint32_t),
+        record_count * sizeof(uint32_t),
+        record_count * sizeof(uint8_t),
+        record_count * sizeof(uint8_t),
+        bitmap_bytes,
+        bitmap_bytes,
+        bitmap_bytes,
+        (record_count + 1) * sizeof(uint64_t),
+        address_bytes,
+        (record_count + 1) * sizeof(uint64_t),
+        identity_bytes
+    };
+    uint64_t offset = 0;
+    memset(header, 0, sizeof(record_file_header_t));
+    header->magic        = Record_File_Magic;
+    header->version      = Record_File_Version;
+    header->column_count = RECORD_COLUMN_COUNT;
+    header->record_count = record_count;
+    offset = sizeof(record_file_header_t);
+    for (size_t c = 0; c < RECORD_COLUMN_COUNT; ++c)
+    {
+        offset = (offset + Record_File_Alignment - 1) & ~(Record_File_Alignment - 1);
+        header->columns[c].offset = offset;
+        header->columns[c].size   = sizes[c];
+        offset += sizes[c];
+    }
+    header->file_size = offset;
+}
+
+/// @summary Writes zero bytes until the file position reaches an offset.
+/// @param fp The file to write to.
+/// @param pos The current file position, updated on return.
+/// @param offset The offset to advance to.
+/// @return true if the padding was written.
+static bool record_file_pad(FILE *fp, uint64_t *pos, uint64_t offset)
+{
+    static uint8_t const zero[64] = { 0 };
+    while (*pos < offset)
+    {
+        size_t n = (offset - *pos) < sizeof(zero) ? (size_t)(offset - *pos) : sizeof(zero);
+        if (fwrite(zero, 1, n, fp) != n)
+            return false;
+        *pos += n;
+    }
+    return true;
+}
+
+/// @summary Writes an array of records to a record file.
+/// @param path The path of the file to write. Any existing file is replaced.
+/// @param records The records to write.
+/// @param count The number of records to write.
+/// @return true if the file was written.
+static bool record_file_write(char const *path, record_t const *records, size_t count)
+{
+    uint64_t address_bytes  = 0;
+    uint64_t identity_bytes = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (records[i].address ) address_bytes  += strlen(records[i].address);
+        if (records[i].identity) identity_bytes += strlen(records[i].identity);
+    }
+
+    record_file_header_t header;
+    record_file_layout(&header, count, address_bytes, identity_bytes);
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL)
+        return false;
+
+    // emit each column in turn from a small staging buffer.
+    uint64_t             pos = sizeof(header);
+    bool                 ok  = fwrite(&header, sizeof(header), 1, fp) == 1;
+    std::vector<uint8_t> buf;
+    for (size_t c = 0; c < RECORD_COLUMN_COUNT && ok; ++c)
+    {
+        ok = record_file_pad(fp, &pos, header.columns[c].offset);
+        uint64_t string_offset = 0;
+        uint64_t word          = 0;
+        for (size_t i = 0; i < count && ok; ++i)
+        {
+            record_t const *rec = &records[i];
+            switch (c)
+            {
+            case RECORD_COLUMN_ID:
+                buf.insert(buf.end(), (uint8_t const*) &rec->id, (uint8_t const*) &rec->id + sizeof(id_t));
+                break;
+            case RECORD_COLUMN_ANNUAL_SALARY:
+                buf.insert(buf.end(), (uint8_t const*) &rec->annual_salary, (uint8_t const*) &rec->annual_salary + sizeof(uint32_t));
+                break;
+            case RECORD_COLUMN_LOAN_AMOUNT:
+                buf.insert(buf.end(), (uint8_t const*) &rec->loan_amount, (uint8_t const*) &rec->loan_amount + sizeof(uint32_t));
+                break;
+            case RECORD_COLUMN_VERIFY_ADDRESS:
+                buf.push_back((uint8_t) rec->verify_address);
+                break;
+            case RECORD_COLUMN_VERIFY_IDENTITY:
+                buf.push_back((uint8_t) rec->verify_identity);
+                break;
+            case RECORD_COLUMN_OWNS_OTHER_HOME:
+            case RECORD_COLUMN_ADDRESS_VALID:
+            case RECORD_COLUMN_IDENTITY_VALID:
+                {
+                    bool value = (c == RECORD_COLUMN_OWNS_OTHER_HOME) ? rec->owns_other_home :
+                                ((c == RECORD_COLUMN_ADDRESS_VALID ) ? rec->address != NULL : rec->identity != NULL);
+                    word |= (uint64_t) value << (i & 63);
+                    if ((i & 63) == 63 || i + 1 == count)
+                    {
+                        buf.insert(buf.end(), (uint8_t const*) &word, (uint8_t const*) &word + sizeof(uint64_t));
+                        word = 0;
+                    }
+                }
+                break;
+            case RECORD_COLUMN_ADDRESS_OFFSETS:
+            case RECORD_COLUMN_IDENTITY_OFFSETS:
+                {
+                    char const *s = (c == RECORD_COLUMN_ADDRESS_OFFSETS) ? rec->address : rec->identity;
+                    buf.insert(buf.end(), (uint8_t const*) &string_offset, (uint8_t const*) &string_offset + sizeof(uint64_t));
+                    string_offset += s ? strlen(s) : 0;
+                    if (i + 1 == count)
+                        buf.insert(buf.end(), (uint8_t const*) &string_offset, (uint8_t const*) &string_offset + sizeof(uint64_t));
+                }
+                break;
+            case RECORD_COLUMN_ADDRESS_BYTES:
+            case RECORD_COLUMN_IDENTITY_BYTES:
+                {
+                    char const *s = (c == RECORD_COLUMN_ADDRESS_BYTES) ? rec->address : rec->identity;
+                    if (s) buf.insert(buf.end(), s, s + strlen(s));
+                }
+                break;
+            }
+            if (buf.size() >= 65536 || i + 1 == count)
+            {
+                ok   = fwrite(buf.data(), 1, buf.size(), fp) == buf.size();
+                pos += buf.size();
+                buf.clear();
+            }
+        }
+        if (count == 0 && (c == RECORD_COLUMN_ADDRESS_OFFSETS || c == RECORD_COLUMN_IDENTITY_OFFSETS))
+        {
+            ok   = ok && fwrite(&string_offset, sizeof(uint64_t), 1, fp) == 1;
+            pos += sizeof(uint64_t);
+        }
+    }
+    ok = ok && pos == header.file_size;
+    ok = (fclose(fp) == 0) && ok;
+    return ok;
+}
+
+/// @summary Checks that the offsets of a string column stay within its bytes:
+/// they must start at zero, never decrease, and end at the column size.
+/// @param column The string column, with count + 1 offsets.
+/// @param count The number of records.
+/// @param bytes_size The size of the column's bytes, in bytes.
+/// @return true if every string lies within the bytes.
+static bool string_column_valid(string_column_t const *column, size_t count, uint64_t bytes_size)
+{
+    if (column->offsets[0] != 0 || column->offsets[count] != bytes_size)
+    {
+        return false;
+    }
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (column->offsets[i + 1] < column->offsets[i]) return false;
+    }
+    return true;
+}
+
+/// @summary Opens a record file and exposes its columns without copying. The
+/// header, the column bounds and the string offsets are validated; the other
+/// contents are not.
+/// @param file The record file to initialize.
+/// @param path The path of the file to open.
+/// @param error A buffer receiving a description of any problem.
+/// @param error_size The size of the error buffer, in bytes.
+/// @return true if the file was opened.
+static bool record_file_open(record_file_t *file, char const *path, char *error, size_t error_size)
+{
+    memset(file, 0, sizeof(record_file_t));
+    if (!file_mapping_open(&file->mapping, path))
+    {
+        snprintf(error, error_size, "Unable to map record file '%s'.", path);
+        return false;
+    }
+
+    record_file_header_t header;
+    record_file_header_t expected;
+    if (file->mapping.size < sizeof(header))
+    {
+        snprintf(error, error_size, "%s: file is too small to be a record file.", path);
+        file_mapping_close(&file->mapping);
+        return false;
+    }
+    memcpy(&header, file->mapping.base, sizeof(header));
+    if (header.magic != Record_File_Magic || header.version != Record_File_Version || header.column_count != RECORD_COLUMN_COUNT)
+    {
+        snprintf(error, error_size, "%s: not a version %u record file.", path, Record_File_Version);
+        file_mapping_close(&file->mapping);
+        return false;
+    }
+    // the numeric layout is fully determined by the record count; the string
+    // columns are checked against the file size.
+    record_file_layout(&expected, header.record_count, header.columns[RECORD_COLUMN_ADDRESS_BYTES].size, header.columns[RECORD_COLUMN_IDENTITY_BYTES].size);
+    if (memcmp(&header, &expected, sizeof(header)) != 0 || header.file_size > file->mapping.size)
+    {
+        snprintf(error, error_size, "%s: record file is truncated or has an invalid layout.", path);
+        file_mapping_close(&file->mapping);
+        return false;
+    }
+
+    uint8_t const *base   = file->mapping.base;
+    size_t         count  = (size_t) header.record_count;
+    record_store_t *store = &file->store;
+    store->count           = count;
+    store->capacity        = count;
+    store->id              = (id_t    *)(base + header.columns[RECORD_COLUMN_ID             ].offset);
+    store->annual_salary   = (uint32_t*)(base + header.columns[RECORD_COLUMN_ANNUAL_SALARY  ].offset);
+    store->loan_amount     = (uint32_t*)(base + header.columns[RECORD_COLUMN_LOAN_AMOUNT    ].offset);
+    store->verify_address  = (uint8_t *)(base + header.columns[RECORD_COLUMN_VERIFY_ADDRESS ].offset);
+    store->verify_identity = (uint8_t *)(base + header.columns[RECORD_COLUMN_VERIFY_IDENTITY].offset);
+    store->owns_other_home = (uint64_t*)(base + header.columns[RECORD_COLUMN_OWNS_OTHER_HOME].offset);
+    store->address_valid   = (uint64_t*)(base + header.columns[RECORD_COLUMN_ADDRESS_VALID  ].offset);
+    store->identity_valid  = (uint64_t*)(base + header.columns[RECORD_COLUMN_IDENTITY_VALID ].offset);
+    file->address.offsets  = (uint64_t const*)(base + header.columns[RECORD_COLUMN_ADDRESS_OFFSETS ].offset);
+    file->address.bytes    = (char     const*)(base + header.columns[RECORD_COLUMN_ADDRESS_BYTES   ].offset);
+    file->identity.offsets = (uint64_t const*)(base + header.columns[RECORD_COLUMN_IDENTITY_OFFSETS].offset);
+    file->identity.bytes   = (char     const*)(base + header.columns[RECORD_COLUMN_IDENTITY_BYTES  ].offset);
+    if (!string_column_valid(&file->address , count, header.columns[RECORD_COLUMN_ADDRESS_BYTES ].size) ||
+        !string_column_valid(&file->identity, count, header.columns[RECORD_COLUMN_IDENTITY_BYTES].size))
+    {
+        snprintf(error, error_size, "%s: record file has corrupt string offsets.", path);
+        file_mapping_close(&file->mapping);
+        return false;
+    }
+
+    // the predicate inputs are read front to back by every pass; the strings
+    // are only touched on demand.
+    for (size_t c = RECORD_COLUMN_ID; c <= RECORD_COLUMN_IDENTITY_VALID; ++c)
+    {
+        file_mapping_advise(&file->mapping, header.columns[c].offset, header.columns[c].size, true);
+    }
+    return true;
+}
+
+/// @summary Closes a record file. Any pointers into the file become invalid.
+/// @param file The record file to close.
+static void record_file_close(record_file_t *file)
+{
+    file_mapping_close(&file->mapping);
+    memset(file, 0, sizeof(record_file_t));
+}
+
+/// @summary Reads a string from a string column.
+/// @param column The string column.
+/// @param index The zero-based index of the record.
+/// @param length On return, the length of the string in bytes.
+/// @return A pointer to the string bytes, which are not NULL-terminated.
+static inline char const* string_column_get(string_column_t const *column, size_t index, size_t *length)
+{
+    *length = (size_t)(column->offsets[index + 1] - column->offsets[index]);
+    return column->bytes + column->offsets[index];
+}
+
+/// @summary Reconstructs a record from a record file. Strings are matched
+/// against the sample lists so the record can be used like a generated one.
+/// @param file The record file.
+/// @param index The zero-based index of the record.
+/// @param rec The record to populate.
+static void record_file_get(record_file_t const *file, size_t index, record_t *rec)
+{
+    record_store_t const *store = &file->store;
+    rec->id              = store->id[index];
+    rec->annual_salary   = store->annual_salary[index];
+    rec->loan_amount     = store->loan_amount[index];
+    rec->verify_address  = store->verify_address[index];
+    rec->verify_identity = store->verify_identity[index];
+    rec->owns_other_home = bitmap_get(store->owns_other_home, index) != 0;
+    rec->address         = NULL;
+    rec->identity        = NULL;
+
+    // record_t holds NUL-terminated strings, so map file strings back to the
+    // interned sample strings; unknown strings become the first sample.
+    size_t      length;
+    char const *s;
+    if (bitmap_get(store->address_valid, index))
+    {
+        s = string_column_get(&file->address, index, &length);
+        rec->address = sample_entry(Address_List, Address_Count, 0);
+        for (size_t i = 0; i < Address_Count; ++i)
+        {
+            if (Address_List[i] && strlen(Address_List[i]) == length && memcmp(Address_List[i], s, length) == 0)
+                rec->address = Address_List[i];
+        }
+    }
+    if (bitmap_get(store->identity_valid, index))
+    {
+        s = string_column_get(&file->identity, index, &length);
+        rec->identity = sample_entry(Identity_List, Identity_Count, 0);
+        for (size_t i = 0; i < Identity_Count; ++i)
+        {
+            if (Identity_List[i] && strlen(Identity_List[i]) == length && memcmp(Identity_List[i], s, length) == 0)
+                rec->identity = Identity_List[i];
+        }
+    }
+}
+
+/*//////////////////////
+//  Fused Pipeline    //
+//////////////////////*/
+/// @summary The default number of records per block in the fused pipeline.
+/// 4096 bitfields occupy 16KB, leaving room in a 32KB L1 data cache for the
+/// masks and the output cursors; the records themselves are streamed once.
+static const size_t Fused_Block_Size = 4096;
+
+/// @summary Define the ways bitfields may be produced for classification.
+enum pipeline_mode_e
+{
+    PIPELINE_PRECOMPUTED               = 0, // generate the full bitfield array once, classify it many times
+    PIPELINE_FUSED                     = 1, // generate and classify one cache-sized block at a time
+    PIPELINE_MODE_COUNT                = 2
+};
+
+/// @summary A lookup table of strings for pretty-printing pipeline_mode_e values.
+static char const *Pipeline_Mode_Names[PIPELINE_MODE_COUNT] =
+{
+    "precomputed",
+    "fused"
+};
+
+/// @summary Evaluates predicates and classifies records one block at a time,
+/// so that the bitfields for a block are consumed while still in cache and no
+/// full-size bitfield array is written to or read back from memory. Produces
+/// output identical to generate_bitfields() followed by the kernel.
+/// @param kernel The classify kernel to run on each block.
+/// @param masks The masks generated from each column in the condition table.
+/// @param outputs An array of output tables, one for each column.
+/// @param column_count The number of columns in the condition table.
+/// @param ids An array of IDs associated with each input record.
+/// @param records The array of input records.
+/// @param record_count The number of input records.
+/// @param block_size The number of records per block, or zero to use Fused_Block_Size.
+static void classify_fused(classify_func_t kernel, query_mask_t const *masks, table_t **outputs, size_t column_count, id_t const *ids, record_t const *records, size_t record_count, size_t block_size=0)
+{
+    if (block_size == 0)
+    {
+        block_size = Fused_Block_Size;
+    }
+
+    output_groups_t groups;
+    output_groups_build(&groups, outputs, column_count);
+    uint32_t *block = (uint32_t*) malloc(block_size * sizeof(uint32_t));
+    for (size_t i = 0; i < record_count; i += block_size)
+    {
+        size_t n = (record_count - i) < block_size ? (record_count - i) : block_size;
+        for (size_t g = 0; g < groups.group_count; ++g)
+        {
+            table_t *table = groups.groups[g].table;
+            table_reserve(table, table->count + n * groups.groups[g].count + 1);
+        }
+        generate_bitfields(block, records + i, n);
+        kernel(masks, outputs, column_count, ids + i, block, n);
+    }
+    free(block);
+    output_groups_free(&groups);
+}
+
+/// @summary Evaluates predicates against a record store and classifies records
+/// one block at a time. See the array of structures version above.
+/// @param kernel The classify kernel to run on each block.
+/// @param masks The masks generated from each column in the condition table.
+/// @param outputs An array of output tables, one for each column.
+/// @param column_count The number of columns in the condition table.
+/// @param store The input record store. IDs are read from its id column.
+/// @param block_size The number of records per block, or zero to use Fused_Block_Size.
+static void classify_fused(classify_func_t kernel, query_mask_t const *masks, table_t **outputs, size_t column_count, record_store_t const *store, size_t block_size=0)
+{
+    if (block_size == 0)
+    {
+        block_size = Fused_Block_Size;
+    }
+
+    output_groups_t groups;
+    output_groups_build(&groups, outputs, column_count);
+    uint32_t *block = (uint32_t*) malloc(block_size * sizeof(uint32_t));
+    for (size_t i = 0; i < store->count; i += block_size)
+    {
+        size_t n = (store->count - i) < block_size ? (store->count - i) : block_size;
+        for (size_t g = 0; g < groups.group_count; ++g)
+        {
+            table_t *table = groups.groups[g].table;
+            table_reserve(table, table->count + n * groups.groups[g].count + 1);
+        }
+        generate_bitfields(block, store, i, n);
+        kernel(masks, outputs, column_count, store->id + i, block, n);
+    }
+    free(block);
+    output_groups_free(&groups);
+}
+
+/// @summary Estimates the number of bytes moved to or from memory by one
+/// classification pass over a record set, ignoring output writes, which are
+/// the same for every mode.
+/// @param mode One of pipeline_mode_e.
+/// @param record_count The number of input records.
+/// @param include_generate true if the pass also regenerates the bitfield array.
+/// Only meaningful for PIPELINE_PRECOMPUTED.
+/// @return The estimated number of bytes transferred.
+static uint64_t pipeline_bytes_per_pass(pipeline_mode_e mode, size_t record_count, bool include_generate)
+{
+    uint64_t record_bytes = (uint64_t) record_count * sizeof(record_t);
+    uint64_t id_bytes     = (uint64_t) record_count * sizeof(id_t);
+    uint64_t bit_bytes    = (uint64_t) record_count * sizeof(uint32_t);
+    if (mode == PIPELINE_FUSED)
+    {
+        return record_bytes + id_bytes;
+    }
+    if (include_generate)
+    {   // read records, write bitfields, then read bitfields and ids.
+        return record_bytes + bit_bytes + bit_bytes + id_bytes;
+    }
+    return bit_bytes + id_bytes;
+}
+
+/*//////////////////////
+//  Zone Maps         //
+//////////////////////*/
+/// @summary The number of records summarized by each zone map entry. 4096
+/// bitfields occupy 16KB, as for the fused pipeline.
+static const size_t Zone_Block_Size = 4096;
+
+/// @summary Summarizes the bitfield array one block at a time. A condition
+/// bit clear in bits_or is false for every record in the block; a bit set in
+/// bits_and is true for every record. Maintained by generate_bitfields().
+struct zone_map_t
+{
+    size_t       count;       /// The number of records summarized
+    size_t       capacity;    /// The number of blocks the summary arrays can hold
+    uint32_t    *bits_and;    /// The AND of the bitfields of each block
+    uint32_t    *bits_or;     /// The OR of the bitfields of each block
+};
+
+/// @summary Counts the work done by classify_zone_map().
+struct zone_stats_t
+{
+    size_t       blocks;      /// The number of blocks visited
+    size_t       skipped;     /// Blocks in which no column can match, so nothing is read
+    size_t       emitted;     /// Blocks in which every column either cannot match or matches every record
+    size_t       columns;     /// The number of block-column pairs visited
+    size_t       column_skipped; /// Block-column pairs in which the column cannot match
+};
+
+/// @summary Initializes an empty zone map.
+/// @param zones The zone map to initialize.
+static void zone_map_init(zone_map_t *zones)
+{
+    zones->count    = 0;
+    zones->capacity = 0;
+    zones->bits_and = NULL;
+    zones->bits_or  = NULL;
+}
+
+/// @summary Frees the memory held by a zone map.
+/// @param zones The zone map to free.
+static void zone_map_free(zone_map_t *zones)
+{
+    free(zones->bits_and);
+    free(zones->bits_or);
+    zone_map_init(zones);
+}
+
+/// @summary Computes the summary of one block of the bitfield array.
+/// @param zones The zone map to update.
+/// @param bits The full bitfield array.
+/// @param block The index of the block to summarize.
+static void zone_map_summarize(zone_map_t *zones, uint32_t const *bits, size_t block)
+{
+    size_t   first  = block * Zone_Block_Size;
+    size_t   end    = (zones->count - first) < Zone_Block_Size ? zones->count : first + Zone_Block_Size;
+    uint32_t all    = 0xFFFFFFFFU;
+    uint32_t any    = 0;
+    for (size_t i = first; i < end; ++i)
+    {
+        all &= bits[i];
+        any |= bits[i];
+    }
+    zones->bits_and[block] = all;
+    zones->bits_or [block] = any;
+}
+
+/// @summary Generates bitfields for a range of records using a structure of
+/// arrays data source, and updates the zone map entries covering the range.
+/// Each block is summarized while its bitfields are still in cache.
+/// @param dst The destination bitfields, of at least count elements.
+/// @param src The source record store.
+/// @param first The index of the first record in src to process.
+/// @param count The number of items to read from src and write to dst.
+/// @param zones The zone map of the full bitfield array, of which dst is element first.
+static void generate_bitfields(uint32_t *dst, record_store_t const *src, size_t first, size_t count, zone_map_t *zones)
+{
+    uint32_t *bits = dst - first;
+    size_t    end  = first + count;
+    if (count == 0)
+    {
+        return;
+    }
+    if (zones->count < end)
+    {
+        size_t blocks = (end + Zone_Block_Size - 1) / Zone_Block_Size;
+        if (blocks > zones->capacity)
+        {
+            zones->bits_and = (uint32_t*) realloc(zones->bits_and, blocks * sizeof(uint32_t));
+            zones->bits_or  = (uint32_t*) realloc(zones->bits_or , blocks * sizeof(uint32_t));
+            zones->capacity = blocks;
+        }
+        zones->count = end;
+    }
+    for (size_t b = first / Zone_Block_Size; b * Zone_Block_Size < end; ++b)
+    {
+        size_t lo = (b * Zone_Block_Size) > first ? (b * Zone_Block_Size) : first;
+        size_t hi = (b * Zone_Block_Size + Zone_Block_Size) < end ? (b * Zone_Block_Size + Zone_Block_Size) : end;
+        generate_bitfields(bits + lo, src, lo, hi - lo);
+        zone_map_summarize(zones, bits, b);
+    }
+}
+
+/// @summary Clears the counters of a zone_stats_t.
+/// @param stats The counters to clear.
+static void zone_stats_clear(zone_stats_t *stats)
+{
+    memset(stats, 0, sizeof(zone_stats_t));
+}
+
+/// @summary Classifies records using the zone map of their bitfields. Blocks
+/// in which no column can match are skipped without reading their bitfields.
+/// Blocks in which every column either cannot match or matches every record
+/// are written out directly. The remaining blocks are classified by a kernel
+/// over only the columns that can match, and adjacent blocks with the same
+/// columns are passed to the kernel together. Produces output identical to
+/// the kernel on its own. Tables of more than 32 columns, whose column sets do
+/// not fit the 32-bit masks, are passed to the kernel whole.
+/// @param zones The zone map of the bitfield array.
+/// @param kernel The classify kernel to run on blocks that must be scanned.
+/// @param masks The masks generated from each column in the condition table.
+/// @param outputs An array of output tables, one for each column.
+/// @param column_count The number of columns in the condition table.
+/// @param ids An array of IDs associated with each input record.
+/// @param bits An array of bitfields computed for each input record.
+/// @param record_count The number of input records, at most zones->count.
+/// @param stats If not NULL, the counters to accumulate into.
+static void classify_zone_map(zone_map_t const *zones, classify_func_t kernel, query_mask_t const *masks, table_t **outputs, size_t column_count, id_t const *ids, uint32_t const *bits, size_t record_count, zone_stats_t *stats)
+{
+    std::vector<query_mask_t> live_masks(column_count);
+    std::vector<table_t*>     live_outputs(column_count);
+    output_groups_t           groups;
+    output_groups_build(&groups, outputs, column_count);
+
+    size_t   block_count = (record_count + Zone_Block_Size - 1) / Zone_Block_Size;
+    if (column_count > 32)
+    {
+        // every block is scanned over every column.
+        for (size_t g = 0; g < groups.group_count; ++g)
+        {
+            table_t *table = groups.groups[g].table;
+            table_reserve(table, table->count + record_count * groups.groups[g].count + 1);
+        }
+        kernel(masks, outputs, column_count, ids, bits, record_count);
+        if (stats != NULL)
+        {
+            stats->blocks  += block_count;
+            stats->columns += block_count * column_count;
+        }
+        output_groups_free(&groups);
+        return;
+    }
+    size_t   run_first   = 0;     // the first record of the pending run of scanned blocks
+    size_t   run_end     = 0;     // one past the last record of the pending run
+    uint32_t run_live    = 0;     // the columns scanned in the pending run
+    for (size_t b = 0; b <= block_count; ++b)
+    {
+        uint32_t live = 0;        // columns that can match at least one record
+        uint32_t full = 0;        // columns that match every record
+        size_t   lo   = b * Zone_Block_Size;
+        size_t   hi   = (record_count - lo) < Zone_Block_Size ? record_count : lo + Zone_Block_Size;
+        if (b < block_count)
+        {
+            uint32_t all = zones->bits_and[b];
+            uint32_t any = zones->bits_or [b];
+            for (size_t j = 0; j < column_count; ++j)
+            {
+                uint32_t care  = ~masks[j].bits_ignore;
+                uint32_t want  =  care & ~masks[j].bits_false; // rows that must be true
+                uint32_t avoid =  care &  masks[j].bits_false; // rows that must be false
+                if ((want & ~any) == 0 && (avoid & all) == 0)
+                {
+                    live |= 1U << j;
+                    if ((want & ~all) == 0 && (avoid & any) == 0)
+                    {
+                        full |= 1U << j;
+                    }
+                }
+            }
+            if (stats != NULL)
+            {
+                stats->blocks++;
+                stats->columns        += column_count;
+                stats->column_skipped += column_count - popcount32(live);
+                stats->skipped        += (live == 0) ? 1 : 0;
+                stats->emitted        += (live != 0 && live == full) ? 1 : 0;
+            }
+        }
+        bool scan = (b < block_count) && (live != full);
+        if (run_end > run_first && (!scan || live != run_live))
+        {
+            // flush the pending run of scanned blocks.
+            size_t n = 0;
+            for (size_t j = 0; j < column_count; ++j)
+            {
+                if (run_live & (1U << j))
+                {
+                    live_masks  [n] = masks[j];
+                    live_outputs[n] = outputs[j];
+                    n++;
+                }
+            }
+            for (size_t g = 0; g < groups.group_count; ++g)
+            {
+                table_t *table = groups.groups[g].table;
+                table_reserve(table, table->count + (run_end - run_first) * groups.groups[g].count + 1);
+            }
+            kernel(&live_masks[0], &live_outputs[0], n, ids + run_first, bits + run_first, run_end - run_first);
+            run_first = run_end;
+        }
+        if (scan)
+        {
+            if (run_end == run_first)
+            {
+                run_first = lo;
+                run_live  = live;
+            }
+            run_end = hi;
+        }
+        else if (live != 0)
+        {
+            // every record matches each live column, so each ID is written
+            // once per live column, in column order within an output table.
+            for (size_t g = 0; g < groups.group_count; ++g)
+            {
+                output_group_t *grp    = &groups.groups[g];
+                uint32_t        copies = 0;
+                for (uint32_t k = 0; k < grp->count; ++k)
+                {
+                    copies += (live >> groups.columns[grp->first + k]) & 1;
+                }
+                if (copies == 0)
+                {
+                    continue;
+                }
+                table_t *table = grp->table;
+                table_reserve(table, table->count + (hi - lo) * copies + 1);
+                if (copies == 1)
+                {
+                    memcpy(&table->storage[table->count], &ids[lo], (hi - lo) * sizeof(id_t));
+                    table->count += hi - lo;
+                }
+                else for (size_t i = lo; i < hi; ++i)
+                {
+                    for (uint32_t c = 0; c < copies; ++c)
+                    {
+                        table->storage[table->count++] = ids[i];
+                    }
+                }
+            }
+        }
+        if (!scan)
+        {
+            run_first = run_end = hi;
+        }
+    }
+    output_groups_free(&groups);
+}
+
+/*///////////////////////////////
+//  Lookup Table Classifier    //
+///////////////////////////////*/
+/// @summary The largest number of condition rows for which a lookup table is
+/// built by default. This is a machine-specific tuning constant, not a general
+/// crossover: the LUT costs the same per record at any column count while the
+/// mask kernels slow down with more columns, and the LUT loses once the table
+/// spills out of the host's L2. On the host it was tuned on, the 64-column
+/// lut/crossover run had the LUT ahead of the AVX-512 mask kernel through 18
+/// rows; other hosts have measured about 14 rows at 64 columns and about 5 rows
+/// at 5 columns. Rerun lut/crossover to retune it.
+static const size_t Lut_Max_Rows = 18;
+
+/// @summary The largest number of condition rows for which a lookup table can
+/// be built at all.
+static const size_t Lut_Limit_Rows = 24;
+
+/// @summary Define the ways a lookup table classifier can emit its output.
+enum lut_mode_e
+{
+    LUT_MODE_GATHER                    = 0, // one table lookup per record; output order matches classify()
+    LUT_MODE_PARTITION                 = 1, // radix-partition records by bitfield, emit partitions in bulk
+    LUT_MODE_COUNT                     = 2
+};
+
+/// @summary A lookup table of strings for pretty-printing lut_mode_e values.
+static char const *Lut_Mode_Names[LUT_MODE_COUNT] =
+{
+    "LUT gather",
+    "LUT partition"
+};
+
+/// @summary A condition table compiled to a truth table over the 2^N possible
+/// bitfield values. Each entry stores, for each output table, the number of
+/// columns writing to that table whose conditions are met by the value.
+struct lut_classifier_t
+{
+    size_t          row_count;    /// The number of condition rows, N
+    size_t          entry_count;  /// The number of table entries, 2^N
+    uint32_t        index_mask;   /// Mask applied to a bitfield to produce a table index
+    output_groups_t groups;       /// The columns of the condition table grouped by output table
+    uint8_t        *counts;       /// entry_count * group_count match counts
+    bool            compiled;     /// false if the table was too wide to compile
+    bool            use_avx2;     /// true if the gather mode may use vpgatherdd
+    classify_func_t fallback;     /// The kernel used when the table was not compiled
+};
+
+/// @summary Compiles a condition table into a lookup table. If row_count exceeds
+/// max_rows no table is built and classify_lut() runs the fallback kernel.
+/// @param lut The lookup table classifier to initialize. Free with lut_classifier_free().
+/// @param masks The masks generated from each column in the condition table.
+/// @param outputs An array of output tables, one for each column.
+/// @param column_count The number of columns in the condition table.
+/// @param row_count The number of rows in the condition table.
+/// @param fallback The classify kernel to use for tables wider than max_rows.
+/// @param max_rows The widest table to compile, at most Lut_Limit_Rows.
+/// @return true if the lookup table was compiled.
+static bool lut_classifier_build(lut_classifier_t *lut, query_mask_t const *masks, table_t **outputs, size_t column_count, size_t row_count, classify_func_t fallback, size_t max_rows=Lut_Max_Rows)
+{
+    output_groups_build(&lut->groups, outputs, column_count);
+    lut->row_count   = row_count;
+    lut->entry_count = 0;
+    lut->index_mask  = 0;
+    lut->counts      = NULL;
+    lut->compiled    = false;
+    lut->use_avx2    = detect_simd_level() >= SIMD_LEVEL_AVX2;
+    lut->fallback    = fallback;
+    if (row_count > max_rows || row_count > Lut_Limit_Rows)
+    {
+        return false;
+    }
+    for (size_t g = 0; g < lut->groups.group_count; ++g)
+    {
+        if (lut->groups.groups[g].count > 255)
+        {   // match counts are stored in a byte.
+            return false;
+        }
+    }
+
+    size_t group_count = lut->groups.group_count;
+    lut->entry_count   = size_t(1) << row_count;
+    lut->index_mask    = (uint32_t)(lut->entry_count - 1);
+    lut->counts        = (uint8_t*) calloc(lut->entry_count * group_count + 3, 1); // padded for 32-bit gathers
+    for (size_t v = 0; v < lut->entry_count; ++v)
+    {
+        for (size_t g = 0; g < group_count; ++g)
+        {
+            output_group_t const *grp  = &lut->groups.groups[g];
+            uint32_t              hits = 0;
+            for (uint32_t k = 0; k < grp->count; ++k)
+            {
+                query_mask_t const *mask = &masks[lut->groups.columns[grp->first + k]];
+                uint32_t met_bits = ((uint32_t) v ^ mask->bits_false) | mask->bits_ignore;
+                hits += (met_bits == 0xFFFFFFFFU) ? 1 : 0;
+            }
+            lut->counts[v * group_count + g] = (uint8_t) hits;
+        }
+    }
+    lut->compiled = true;
+    return true;
+}
+
+/// @summary Frees the storage associated with a lookup table classifier.
+/// @param lut The lookup table classifier to free.
+static void lut_classifier_free(lut_classifier_t *lut)
+{
+    free(lut->counts);
+    output_groups_free(&lut->groups);
+    lut->counts   = NULL;
+    lut->compiled = false;
+}
+
+/// @summary Classifies records with one table lookup per record. Produces
+/// output identical to classify(). Output tables are grown as needed.
+/// @param lut A compiled lookup table classifier.
+/// @param ids An array of IDs associated with each input record.
+/// @param bits An array of bitfields computed for each input record.
+/// @param record_count The number of input records.
+static void classify_lut_gather(lut_classifier_t const *lut, id_t const *ids, uint32_t const *bits, size_t record_count)
+{
+    size_t const    group_count = lut->groups.group_count;
+    uint8_t const  *counts      = lut->counts;
+    for (size_t base = 0; base < record_count; base += Parallel_Block_Size)
+    {
+        size_t end = (record_count - base) < Parallel_Block_Size ? record_count : base + Parallel_Block_Size;
+        for (size_t g = 0; g < group_count; ++g)
+        {
+            table_t *table = lut->groups.groups[g].table;
+            table_reserve(table, table->count + (end - base) * lut->groups.groups[g].count + 1);
+        }
+        for (size_t g = 0; g < group_count; ++g)
+        {
+            table_t  *table   = lut->groups.groups[g].table;
+            id_t     *storage = table->storage;
+            size_t    n       = table->count;
+            if (lut->groups.groups[g].count == 1)
+            {
+                for (size_t i = base; i < end; ++i)
+                {
+                    storage[n] = ids[i];
+                    n += counts[(bits[i] & lut->index_mask) * group_count + g];
+                }
+            }
+            else
+            {
+                uint32_t repeat = lut->groups.groups[g].count;
+                for (size_t i = base; i < end; ++i)
+                {
+                    uint32_t hits = counts[(bits[i] & lut->index_mask) * group_count + g];
+                    for (uint32_t r = 0; r < repeat; ++r)
+                    {
+                        storage[n] = ids[i];
+                        n += (hits > r) ? 1 : 0;
+                    }
+                }
+            }
+            table->count = n;
+        }
+    }
+}
+
+/// @summary Classifies records eight at a time with one vpgatherdd per output
+/// table. Produces output identical to classify(). Output tables are grown as needed.
+/// @param lut A compiled lookup table classifier.
+/// @param ids An array of IDs associated with each input record.
+/// @param bits An array of bitfields computed for each input record.
+/// @param record_count The number of input records.
+TARGET_AVX2 static void classify_lut_gather_avx2(lut_classifier_t const *lut, id_t const *ids, uint32_t const *bits, size_t record_count)
+{
+    size_t const group_count = lut->groups.group_count;
+    __m256i      index_mask  = _mm256_set1_epi32((int32_t) lut->index_mask);
+    __m256i      stride      = _mm256_set1_epi32((int32_t) group_count);
+    __m256i      byte_mask   = _mm256_set1_epi32(0xFF);
+    __m256i      one         = _mm256_set1_epi32(1);
+    __m256i      zero        = _mm256_setzero_si256();
+    size_t       i           = 0;
+    for ( ; i + 8 <= record_count; i += 8)
+    {
+        __m256i v_ids   = _mm256_loadu_si256((__m256i const*) &ids [i]);
+        __m256i v_bits  = _mm256_loadu_si256((__m256i const*) &bits[i]);
+        __m256i v_index = _mm256_mullo_epi32(_mm256_and_si256(v_bits, index_mask), stride);
+        for (size_t g = 0; g < group_count; ++g)
+        {
+            table_t *table = lut->groups.groups[g].table;
+            table_reserve(table, table->count + 8 * lut->groups.groups[g].count);
+
+            __m256i v_hits = _mm256_and_si256(_mm256_i32gather_epi32((int const*)(lut->counts + g), v_index, 1), byte_mask);
+            int     dup    = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(v_hits, one)));
+            if (dup == 0)
+            {
+                uint32_t m    = (uint32_t) _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(v_hits, zero)));
+                __m256i  perm = _mm256_loadu_si256((__m256i const*) Compress_LUT_AVX2[m]);
+                _mm256_storeu_si256((__m256i*) &table->storage[table->count], _mm256_permutevar8x32_epi32(v_ids, perm));
+                table->count += _mm_popcnt_u32(m);
+            }
+            else
+            {
+                int32_t counts[8];
+                _mm256_storeu_si256((__m256i*) counts, _mm256_sub_epi32(zero, v_hits));
+                expand_matches(table, &ids[i], counts, 8, lut->groups.groups[g].count);
+            }
+        }
+    }
+    if (i < record_count)
+    {
+        classify_lut_gather(lut, ids + i, bits + i, record_count - i);
+    }
+}
+
+/// @summary Classifies records by radix-partitioning them on their bitfield
+/// value, then emitting each partition to every matching output in bulk.
+/// Each output receives the same IDs as with classify(), ordered by bitfield
+/// value and then by input position rather than by input position alone.
+/// @param lut A compiled lookup table classifier.
+/// @param ids An array of IDs associated with each input record.
+/// @param bits An array of bitfields computed for each input record.
+/// @param record_count The number of input records.
+static void classify_lut_partition(lut_classifier_t const *lut, id_t const *ids, uint32_t const *bits, size_t record_count)
+{
+    size_t const group_count = lut->groups.group_count;
+    size_t      *offsets     = (size_t*) calloc(lut->entry_count + 1, sizeof(size_t));
+    id_t        *sorted      = (id_t  *) malloc(record_count * sizeof(id_t));
+    for (size_t i = 0; i < record_count; ++i)
+    {
+        offsets[(bits[i] & lut->index_mask) + 1]++;
+    }
+    for (size_t v = 0; v < lut->entry_count; ++v)
+    {
+        offsets[v + 1] += offsets[v];
+    }
+    for (size_t i = 0; i < record_count; ++i)
+    {
+        sorted[offsets[bits[i] & lut->index_mask]++] = ids[i];
+    }
+    // offsets[v] now holds the end of partition v, which is the start of v+1.
+    for (size_t g = 0; g < group_count; ++g)
+    {
+        table_t *table = lut->groups.groups[g].table;
+        size_t   begin = 0;
+        size_t   total = 0;
+        for (size_t v = 0; v < lut->entry_count; ++v)
+        {
+            total += (offsets[v] - begin) * lut->counts[v * group_count + g];
+            begin  =  offsets[v];
+        }
+        table_reserve(table, table->count + total + 1);
+        begin = 0;
+        for (size_t v = 0; v < lut->entry_count; ++v)
+        {
+            size_t   end  = offsets[v];
+            uint32_t hits = lut->counts[v * group_count + g];
+            if (hits == 1)
+            {
+                memcpy(&table->storage[table->count], &sorted[begin], (end - begin) * sizeof(id_t));
+                table->count += end - begin;
+            }
+            else if (hits > 1)
+            {
+                for (size_t i = begin; i < end; ++i)
+                {
+                    for (uint32_t r = 0; r < hits; ++r)
+                    {
+                        table->storage[table->count++] = sorted[i];
+                    }
+                }
+            }
+            begin = end;
+        }
+    }
+    free(sorted);
+    free(offsets);
+}
+
+/// @summary Classifies records using a lookup table classifier, or its fallback
+/// kernel if the condition table was too wide to compile.
+/// @param lut The lookup table classifier.
+/// @param mode One of lut_mode_e.
+/// @param masks The masks generated from each column in the condition table.
+/// @param outputs An array of output tables, one for each column.
+/// @param column_count The number of columns in the condition table.
+/// @param ids An array of IDs associated with each input record.
+/// @param bits An array of bitfields computed for each input record.
+/// @param record_count The number of input records.
+static void classify_lut(lut_classifier_t const *lut, lut_mode_e mode, query_mask_t const *masks, table_t **outputs, size_t column_count, id_t const *ids, uint32_t const *bits, size_t record_count)
+{
+    if (!lut->compiled)
+    {
+        lut->fallback(masks, outputs, column_count, ids, bits, record_count);
+    }
+    else if (mode == LUT_MODE_PARTITION)
+    {
+        classify_lut_partition(lut, ids, bits, record_count);
+    }
+    else if (lut->use_avx2)
+    {
+        classify_lut_gather_avx2(lut, ids, bits, record_count);
+    }
+    else
+    {
+        classify_lut_gather(lut, ids, bits, record_count);
+    }
+}
+
+/*///////////////////////////////
+//  Decision Diagram Classifier //
+///////////////////////////////*/
+/// @summary The default limit on the number of interior nodes in a compiled
+/// decision diagram. Tables that exceed it use the fallback mask kernel.
+static const size_t Decision_Diagram_Max_Nodes = 1 << 20;
+
+/// @summary A condition table compiled to a levelized, reduced multi-terminal
+/// decision diagram. Level k tests condition bit vars[k]; every path from the
+/// root visits every level, so evaluation is a fixed-length chain of table
+/// lookups with no data-dependent branches. Each leaf is an action set, the
+/// number of matching columns per output table, stored as in lut_classifier_t.
+/// Evaluation costs O(conditions) per record, independent of the number of rules.
+struct decision_diagram_t
+{
+    size_t          row_count;    /// The number of rows (conditions) in the condition table
+    size_t          var_count;    /// The number of conditions tested by at least one rule
+    uint32_t        vars[MAX_BITS];/// The condition bit tested at each level
+    size_t          node_count;   /// The number of interior nodes
+    uint32_t       *next;         /// 2 * node_count child indices; children of the last level are leaves
+    uint32_t        root;         /// The root node, or the only leaf if var_count is zero
+    size_t          leaf_count;   /// The number of distinct action sets
+    output_groups_t groups;       /// The columns of the condition table grouped by output table
+    uint8_t        *counts;       /// leaf_count * group_count match counts
+    bool            compiled;     /// false if the diagram exceeded its node limit
+    classify_func_t fallback;     /// The kernel used when the diagram was not compiled
+};
+
+/// @summary State used while compiling a decision diagram.
+struct decision_diagram_builder_t
+{
+    typedef std::vector<uint64_t> column_set_t;
+
+    decision_diagram_t                       *dd;
+    size_t                                    column_count;
+    size_t                                    max_nodes;
+    std::vector<column_set_t>                 require_true;  /// per condition, columns requiring it to be true
+    std::vector<column_set_t>                 require_false; /// per condition, columns requiring it to be false
+    std::vector<uint32_t>                     column_group;  /// the output group of each column
+    std::vector<std::map<column_set_t, uint32_t> > memo;     /// per level, node for each set of live columns
+    std::map<std::vector<uint8_t>, uint32_t>  leaves;        /// leaf index for each action set
+    std::map<std::pair<uint64_t, uint32_t>, uint32_t> unique;/// node for each (level, lo, hi)
+    std::vector<uint8_t>                      counts;
+    std::vector<uint32_t>                     next;
+    bool                                      overflow;
+};
+
+/// @summary Returns the node or leaf reached from a given level when the set of
+/// columns whose conditions are still satisfiable is live.
+/// @param b The builder state.
+/// @param level The level of the node to produce, in [0, var_count].
+/// @param live The set of columns not yet contradicted by the path to this node.
+/// @return The node index, or the leaf index if level == var_count.
+static uint32_t decision_diagram_node(decision_diagram_builder_t *b, size_t level, decision_diagram_builder_t::column_set_t const &live)
+{
+    decision_diagram_t *dd = b->dd;
+    if (level == dd->var_count)
+    {
+        std::vector<uint8_t> action(dd->groups.group_count, 0);
+        for (size_t j = 0; j < b->column_count; ++j)
+        {
+            if (live[j / 64] & (1ULL << (j % 64)))
+            {
+                action[b->column_group[j]]++;
+            }
+        }
+        std::map<std::vector<uint8_t>, uint32_t>::iterator it = b->leaves.find(action);
+        if (it != b->leaves.end())
+        {
+            return it->second;
+        }
+        uint32_t leaf = (uint32_t) b->leaves.size();
+        b->leaves[action] = leaf;
+        b->counts.insert(b->counts.end(), action.begin(), action.end());
+        return leaf;
+    }
+
+    std::map<decision_diagram_builder_t::column_set_t, uint32_t>::iterator it = b->memo[level].find(live);
+    if (it != b->memo[level].end())
+    {
+        return it->second;
+    }
+    if (b->overflow)
+    {
+        return 0;
+    }
+
+    uint32_t var = dd->vars[level];
+    decision_diagram_builder_t::column_set_t live0(live.size());
+    decision_diagram_builder_t::column_set_t live1(live.size());
+    for (size_t w = 0; w < live.size(); ++w)
+    {
+        live0[w] = live[w] & ~b->require_true [var][w]; // bit clear kills rules requiring true
+        live1[w] = live[w] & ~b->require_false[var][w]; // bit set kills rules requiring false
+    }
+    uint32_t lo = decision_diagram_node(b, level + 1, live0);
+    uint32_t hi = decision_diagram_node(b, level + 1, live1);
+
+    // merge structurally identical nodes reached through different live sets.
+    std::pair<uint64_t, uint32_t> key(((uint64_t) level << 32) | lo, hi);
+    std::map<std::pair<uint64_t, uint32_t>, uint32_t>::iterator u = b->unique.find(key);
+    uint32_t node;
+    if (u != b->unique.end())
+    {
+        node = u->second;
+    }
+    else
+    {
+        node = (uint32_t)(b->next.size() / 2);
+        if (node >= b->max_nodes)
+        {
+            b->overflow = true;
+            return 0;
+        }
+        b->next.push_back(lo);
+        b->next.push_back(hi);
+        b->unique[key] = node;
+    }
+    b->memo[level][live] = node;
+    return node;
+}
+
+/// @summary Compiles a condition table into a decision diagram.
+/// @param dd The decision diagram to initialize. Free with decision_diagram_free().
+/// @param rules The condition table, column_count columns of row_count rules each.
+/// @param outputs An array of output tables, one for each column.
+/// @param column_count The number of columns in the condition table.
+/// @param row_count The number of rows in the condition table, at most MAX_BITS.
+/// @param fallback The classify kernel to use if the diagram is too large.
+/// @param max_nodes The largest number of interior nodes to allow.
+/// @return true if the diagram was compiled.
+static bool decision_diagram_build(decision_diagram_t *dd, rule_e const *rules, table_t **outputs, size_t column_count, size_t row_count, classify_func_t fallback, size_t max_nodes=Decision_Diagram_Max_Nodes)
+{
+    output_groups_build(&dd->groups, outputs, column_count);
+    dd->row_count  = row_count;
+    dd->var_count  = 0;
+    dd->node_count = 0;
+    dd->next       = NULL;
+    dd->root       = 0;
+    dd->leaf_count = 0;
+    dd->counts     = NULL;
+    dd->compiled   = false;
+    dd->fallback   = fallback;
+    if (row_count > MAX_BITS)
+    {
+        return false;
+    }
+    for (size_t g = 0; g < dd->groups.group_count; ++g)
+    {
+        if (dd->groups.groups[g].count > 255)
+        {   // match counts are stored in a byte.
+            return false;
+        }
+    }
+
+    decision_diagram_builder_t b;
+    size_t words   = (column_count + 63) / 64;
+    b.dd           = dd;
+    b.column_count = column_count;
+    b.max_nodes    = max_nodes;
+    b.overflow     = false;
+    b.require_true .assign(row_count, decision_diagram_builder_t::column_set_t(words, 0));
+    b.require_false.assign(row_count, decision_diagram_builder_t::column_set_t(words, 0));
+    b.column_group .assign(column_count, 0);
+    for (size_t g = 0; g < dd->groups.group_count; ++g)
+    {
+        for (uint32_t k = 0; k < dd->groups.groups[g].count; ++k)
+        {
+            b.column_group[dd->groups.columns[dd->groups.groups[g].first + k]] = (uint32_t) g;
+        }
+    }
+    for (size_t j = 0; j < column_count; ++j)
+    {
+        for (size_t i = 0; i < row_count; ++i)
+        {
+            rule_e rule = rules[j * row_count + i];
+            if (rule == CONDITION_TRUE ) b.require_true [i][j / 64] |= 1ULL << (j % 64);
+            if (rule == CONDITION_FALSE) b.require_false[i][j / 64] |= 1ULL << (j % 64);
+        }
+    }
+    for (size_t i = 0; i < row_count; ++i)
+    {
+        bool tested = false;
+        for (size_t w = 0; w < words; ++w)
+        {
+            tested = tested || b.require_true[i][w] || b.require_false[i][w];
+        }
+        if (tested)
+        {   // conditions no rule depends on are skipped entirely.
+            dd->vars[dd->var_count++] = (uint32_t) i;
+        }
+    }
+    b.memo.resize(dd->var_count);
+
+    decision_diagram_builder_t::column_set_t all(words, ~0ULL);
+    if (column_count % 64)
+    {
+        all[words - 1] = (1ULL << (column_count % 64)) - 1;
+    }
+    uint32_t root = decision_diagram_node(&b, 0, all);
+    if (b.overflow)
+    {
+        return false;
+    }
+
+    size_t counts_size = b.counts.size();
+    dd->root       = root;
+    dd->node_count = b.next.size() / 2;
+    dd->leaf_count = b.leaves.size();
+    dd->next       = (uint32_t*) malloc((b.next.size() + 1) * sizeof(uint32_t));
+    dd->counts     = (uint8_t *) malloc(counts_size + 1);
+    if (b.next.size()) memcpy(dd->next, &b.next[0], b.next.size() * sizeof(uint32_t));
+    if (counts_size)   memcpy(dd->counts, &b.counts[0], counts_size);
+    dd->compiled   = true;
+    return true;
+}
+
+/// @summary Frees the storage associated with a decision diagram.
+/// @param dd The decision diagram to free.
+static void decision_diagram_free(decision_diagram_t *dd)
+{
+    free(dd->counts);
+    free(dd->next);
+    output_groups_free(&dd->groups);
+    dd->counts   = NULL;
+    dd->next     = NULL;
+    dd->compiled = false;
+}
+
+/// @summary Evaluates a decision diagram for a single bitfield.
+/// @param dd A compiled decision diagram.
+/// @param bits The bitfield of the record to evaluate.
+/// @return The index of the leaf (action set) reached.
+static inline uint32_t decision_diagram_eval(decision_diagram_t const *dd, uint32_t bits)
+{
+    uint32_t const *next = dd->next;
+    uint32_t        n    = dd->root;
+    for (size_t level = 0; level < dd->var_count; ++level)
+    {
+        n = next[2 * n + ((bits >> dd->vars[level]) & 1)];
+    }
+    return n;
+}
+
+/// @summary Classifies records using a decision diagram, or its fallback kernel
+/// if the condition table was too large to compile. Produces output identical
+/// to classify(). Output tables are grown as needed.
+/// @param dd The decision diagram.
+/// @param masks The masks generated from each column in the condition table.
+/// @param outputs An array of output tables, one for each column.
+/// @param column_count The number of columns in the condition table.
+/// @param ids An array of IDs associated with each input record.
+/// @param bits An array of bitfields computed for each input record.
+/// @param record_count The number of input records.
+static void classify_decision_diagram(decision_diagram_t const *dd, query_mask_t const *masks, table_t **outputs, size_t column_count, id_t const *ids, uint32_t const *bits, size_t record_count)
+{
+    if (!dd->compiled)
+    {
+        dd->fallback(masks, outputs, column_count, ids, bits, record_count);
+        return;
+    }
+
+    size_t const group_count = dd->groups.group_count;
+    uint32_t     leaves[Fused_Block_Size];
+    for (size_t base = 0; base < record_count; base += Fused_Block_Size)
+    {
+        size_t n = (record_count - base) < Fused_Block_Size ? (record_count - base) : Fused_Block_Size;
+        for (size_t i = 0; i < n; ++i)
+        {
+            leaves[i] = decision_diagram_eval(dd, bits[base + i]);
+        }
+        for (size_t g = 0; g < group_count; ++g)
+        {
+            table_t  *table  = dd->groups.groups[g].table;
+            uint32_t  repeat = dd->groups.groups[g].count;
+            table_reserve(table, table->count + n * repeat + 1);
+            id_t     *storage = table->storage;
+            size_t    count   = table->count;
+            for (size_t i = 0; i < n; ++i)
+            {
+                uint32_t hits = dd->counts[leaves[i] * group_count + g];
+                storage[count] = ids[base + i];
+                count += (hits != 0) ? 1 : 0;
+                for (uint32_t r = 1; r < hits; ++r)
+                {
+                    storage[count++] = ids[base + i];
+                }
+            }
+            table->count = count;
+        }
+    }
+}
+
+/*//////////////////////
+//  Hit Policies      //
+//////////////////////*/
+/// @summary Define how the matching rules of a condition table produce output.
+enum hit_policy_e
+{
+    HIT_POLICY_COLLECT                 = 0, // every matching rule writes; an ID may appear several times in a table
+    HIT_POLICY_FIRST                   = 1, // only the first matching rule, in rule order, writes
+    HIT_POLICY_PRIORITY                = 2, // only the matching rule whose action was declared earliest writes
+    HIT_POLICY_UNIQUE                  = 3, // each action with at least one matching rule writes once
+    HIT_POLICY_COUNT                   = 4
+};
+
+/// @summary A lookup table of strings for pretty-printing and parsing hit_policy_e values.
+static char const *Hit_Policy_Names[HIT_POLICY_COUNT] =
+{
+    "collect",
+    "first",
+    "priority",
+    "unique"
+};
+
+/// @summary Classifies records according to a hit policy. Under every policy
+/// except HIT_POLICY_COLLECT a record produces at most one write per output
+/// table, and the per-column speculative store of classify() is replaced by
+/// one store per record (first, priority) or one per output table (unique).
+/// Output tables are grown as needed.
+/// @param policy One of hit_policy_e.
+/// @param masks The masks generated from each column in the condition table.
+/// @param outputs An array of output tables, one for each column.
+/// @param column_count The number of columns in the condition table.
+/// @param priorities For HIT_POLICY_PRIORITY, the priority of each column; lower
+/// values win, and ties go to the earlier column. Ignored by other policies.
+/// By convention the priority of a column is the declaration index of its
+/// action: action_e order (reject, manual, immediate) for the compiled-in
+/// table, and the order of the action lines for a table loaded from a file.
+/// @param ids An array of IDs associated with each input record.
+/// @param bits An array of bitfields computed for each input record.
+/// @param record_count The number of input records.
+static void classify_hit_policy(hit_policy_e policy, query_mask_t const *masks, table_t **outputs, size_t column_count, uint32_t const *priorities, id_t const *ids, uint32_t const *bits, size_t record_count)
+{
+    if (policy == HIT_POLICY_COLLECT)
+    {
+        output_groups_t groups;
+        output_groups_build(&groups, outputs, column_count);
+        for (size_t g = 0; g < groups.group_count; ++g)
+        {
+            table_t *table = groups.groups[g].table;
+            table_reserve(table, table->count + record_count * groups.groups[g].count + 1);
+        }
+        output_groups_free(&groups);
+        classify(masks, outputs, column_count, ids, bits, record_count);
+        return;
+    }
+
+    output_groups_t groups;
+    output_groups_build(&groups, outputs, column_count);
+    for (size_t g = 0; g < groups.group_count; ++g)
+    {
+        table_t *table = groups.groups[g].table;
+        table_reserve(table, table->count + record_count + 1);
+    }
+
+    if (policy == HIT_POLICY_UNIQUE)
+    {
+        for (size_t g = 0; g < groups.group_count; ++g)
+        {
+            output_group_t const *grp     = &groups.groups[g];
+            uint32_t const       *cols    = &groups.columns[grp->first];
+            id_t                 *storage = grp->table->storage;
+            size_t                n       = grp->table->count;
+            for (size_t i = 0; i < record_count; ++i)
+            {
+                uint32_t hit = 0;
+                for (uint32_t k = 0; k < grp->count; ++k)
+                {
+                    query_mask_t const *mask = &masks[cols[k]];
+                    hit |= bits_all_set((bits[i] ^ mask->bits_false) | mask->bits_ignore);
+                }
+                storage[n] = ids[i];
+                n += hit;
+            }
+            grp->table->count = n;
+        }
+        output_groups_free(&groups);
+        return;
+    }
+
+    // first and priority both evaluate columns in a fixed order and keep the
+    // first match; visiting the order backwards makes that a conditional move.
+    std::vector<uint32_t> order(column_count);
+    for (size_t j = 0; j < column_count; ++j)
+    {
+        order[j] = (uint32_t) j;
+    }
+    if (policy == HIT_POLICY_PRIORITY && priorities != NULL)
+    {
+        std::stable_sort(order.begin(), order.end(), [priorities](uint32_t a, uint32_t b) { return priorities[a] < priorities[b]; });
+    }
+    id_t                  sink_storage[1];
+    table_t               sink    = { 0, 1, sink_storage }; // absorbs the store for records that match nothing
+    std::vector<table_t*> targets(outputs, outputs + column_count);
+    targets.push_back(&sink);
+    for (size_t i = 0; i < record_count; ++i)
+    {
+        uint32_t bitfield = bits[i];
+        size_t   winner   = column_count;
+        for (size_t k = column_count; k-- > 0; )
+        {
+            query_mask_t const *mask = &masks[order[k]];
+            uint32_t met = bits_all_set((bitfield ^ mask->bits_false) | mask->bits_ignore);
+            winner = met ? order[k] : winner;
+        }
+        table_t *table = targets[winner];
+        table->storage[table->count] = ids[i];
+        table->count += (winner != column_count) ? 1 : 0;
+    }
+    output_groups_free(&groups);
+}
+
+/*////////////////////////////////
+//  Incremental Classification  //
+////////////////////////////////*/
+/// @summary Maintains the output tables of a condition table under a stream
+/// of record updates. Each output table holds an ID at most once, as under
+/// HIT_POLICY_UNIQUE, and a position index per table gives O(1) insertion
+/// and removal, so the cost of a batch depends on its size and not on the
+/// number of records. Removal moves the last entry of a table into the gap,
+/// so tables are not kept in ID order. IDs index the position tables
+/// directly, so they should be dense.
+struct incremental_classifier_t
+{
+    query_mask_t const   *masks;        /// The masks generated from each column in the condition table
+    size_t                column_count; /// The number of columns in the condition table
+    output_groups_t       groups;       /// The columns of the condition table grouped by output table
+    std::vector<uint32_t> *positions;   /// For each group, one plus the position of each ID in its table, or zero
+    table_t              *added;        /// For each group, the IDs added to its table since the last batch began
+    table_t              *removed;      /// For each group, the IDs removed from its table since the last batch began
+};
+
+/// @summary Classifies an initial record set and builds the position index.
+/// Any existing contents of the output tables are replaced.
+/// @param inc The incremental classifier to initialize.
+/// @param masks The masks generated from each column in the condition table.
+/// The masks must remain valid for the lifetime of the classifier.
+/// @param outputs An array of output tables, one for each column.
+/// @param column_count The number of columns in the condition table.
+/// @param ids An array of IDs associated with each input record.
+/// @param bits An array of bitfields computed for each input record.
+/// @param record_count The number of input records.
+static void incremental_classifier_init(incremental_classifier_t *inc, query_mask_t const *masks, table_t **outputs, size_t column_count, id_t const *ids, uint32_t const *bits, size_t record_count)
+{
+    inc->masks        = masks;
+    inc->column_count = column_count;
+    output_groups_build(&inc->groups, outputs, column_count);
+    inc->positions    = new std::vector<uint32_t>[inc->groups.group_count];
+    inc->added        = (table_t*) malloc(inc->groups.group_count * sizeof(table_t));
+    inc->removed      = (table_t*) malloc(inc->groups.group_count * sizeof(table_t));
+
+    id_t id_limit = 0;
+    for (size_t i = 0; i < record_count; ++i)
+    {
+        id_limit = ids[i] >= id_limit ? ids[i] + 1 : id_limit;
+    }
+    for (size_t g = 0; g < inc->groups.group_count; ++g)
+    {
+        table_clear(inc->groups.groups[g].table);
+        table_init(&inc->added  [g], 1024);
+        table_init(&inc->removed[g], 1024);
+        inc->positions[g].assign(id_limit, 0);
+    }
+    classify_hit_policy(HIT_POLICY_UNIQUE, masks, outputs, column_count, NULL, ids, bits, record_count);
+    for (size_t g = 0; g < inc->groups.group_count; ++g)
+    {
+        table_t const *table = inc->groups.groups[g].table;
+        for (size_t k = 0; k < table->count; ++k)
+        {
+            inc->positions[g][table->storage[k]] = (uint32_t)(k + 1);
+        }
+    }
+}
+
+/// @summary Frees the storage associated with an incremental classifier. The
+/// output tables are not freed.
+/// @param inc The incremental classifier to free.
+static void incremental_classifier_free(incremental_classifier_t *inc)
+{
+    for (size_t g = 0; g < inc->groups.group_count; ++g)
+    {
+        table_free(&inc->added  [g]);
+        table_free(&inc->removed[g]);
+    }
+    free(inc->removed);
+    free(inc->added);
+    delete[] inc->positions;
+    output_groups_free(&inc->groups);
+    inc->positions = NULL;
+    inc->added     = NULL;
+    inc->removed   = NULL;
+}
+
+/// @summary Clears the add and remove deltas before a new batch of updates.
+/// @param inc The incremental classifier.
+static void incremental_begin_batch(incremental_classifier_t *inc)
+{
+    for (size_t g = 0; g < inc->groups.group_count; ++g)
+    {
+        table_clear(&inc->added  [g]);
+        table_clear(&inc->removed[g]);
+    }
+}
+
+/// @summary Sets the membership of an ID in one output table, recording the
+/// change, if any, in the group's deltas.
+/// @param inc The incremental classifier.
+/// @param g The zero-based index of the output group.
+/// @param id The ID to insert or remove.
+/// @param member true if the ID should be in the table.
+static void incremental_assign(incremental_classifier_t *inc, size_t g, id_t id, bool member)
+{
+    std::vector<uint32_t> &positions = inc->positions[g];
+    table_t               *table     = inc->groups.groups[g].table;
+    if (id >= positions.size())
+    {
+        if (!member) return;
+        positions.resize((size_t) id + 1, 0);
+    }
+    uint32_t position = positions[id];
+    if (member && position == 0)
+    {
+        table_reserve(table, table->count + 1);
+        table->storage[table->count++] = id;
+        positions[id] = (uint32_t) table->count;
+        table_put(&inc->added[g], id);
+    }
+    else if (!member && position != 0)
+    {
+        // move the last entry into the vacated slot.
+        id_t last = table->storage[--table->count];
+        table->storage[position - 1] = last;
+        positions[last] = position;
+        positions[id]   = 0;
+        table_put(&inc->removed[g], id);
+    }
+}
+
+/// @summary Applies a batch of new or modified records. Only the bitfields of
+/// the updated records are computed, and the output tables are patched in
+/// place. An ID that is added and then removed within a batch, or the
+/// reverse, appears in both deltas.
+/// @param inc The incremental classifier.
+/// @param records The new contents of each updated record, identified by ID.
+/// @param count The number of updated records.
+static void incremental_apply(incremental_classifier_t *inc, record_t const *records, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        uint32_t bitfield;
+        generate_bitfields(&bitfield, &records[i], 1);
+        for (size_t g = 0; g < inc->groups.group_count; ++g)
+        {
+            output_group_t const *grp = &inc->groups.groups[g];
+            uint32_t              hit = 0;
+            for (uint32_t k = 0; k < grp->count; ++k)
+            {
+                query_mask_t const *mask = &inc->masks[inc->groups.columns[grp->first + k]];
+                hit |= bits_all_set((bitfield ^ mask->bits_false) | mask->bits_ignore);
+            }
+            incremental_assign(inc, g, records[i].id, hit != 0);
+        }
+    }
+}
+
+/// @summary Removes records from every output table, for example when an
+/// application is withdrawn.
+/// @param inc The incremental classifier.
+/// @param ids The IDs of the records to remove.
+/// @param count The number of IDs.
+static void incremental_remove(incremental_classifier_t *inc, id_t const *ids, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        for (size_t g = 0; g < inc->groups.group_count; ++g)
+        {
+            incremental_assign(inc, g, ids[i], false);
+        }
+    }
+}
+
+/*//////////////////////
+//  Bitmap Outputs    //
+//////////////////////*/
+/// @summary The number of IDs covered by one compressed bitmap container.
+static const size_t Roaring_Chunk_Bits  = 65536;
+
+/// @summary The number of 64-bit words in a bitmap container.
+static const size_t Roaring_Chunk_Words = Roaring_Chunk_Bits / 64;
+
+/// @summary Containers with at most this many IDs are stored as sorted arrays
+/// of 16-bit values; larger ones as bitmaps. At 4096 entries both forms
+/// occupy 8KB.
+static const size_t Roaring_Array_Max   = 4096;
+
+/// @summary An uncompressed set of IDs, one bit per possible ID. Suited to
+/// dense results, where it needs 1/32nd of the space of a table_t.
+struct bitset_t
+{
+    size_t       bit_count;   /// The number of IDs the set can hold, [0, bit_count)
+    size_t       word_count;  /// The number of 64-bit words in the set
+    uint64_t    *words;       /// Bit (id % 64) of word (id / 64) is set if id is present
+};
+
+/// @summary One 65536-ID chunk of a compressed bitmap. Exactly one of array
+/// and bitmap is non-NULL.
+struct roaring_container_t
+{
+    uint32_t     key;         /// The upper 16 bits of every ID in the container
+    uint32_t     cardinality; /// The number of IDs in the container
+    uint16_t    *array;       /// The sorted low 16 bits of each ID, if cardinality <= Roaring_Array_Max
+    uint64_t    *bitmap;      /// Roaring_Chunk_Words words of bits, otherwise
+};
+
+/// @summary A Roaring-style compressed set of IDs, made of containers sorted
+/// by key. Suited to sparse or clustered results.
+struct roaring_bitmap_t
+{
+    std::vector<roaring_container_t> containers;
+};
+
+/// @summary Counts the number of set bits in a 64-bit value.
+/// @param x The input value.
+/// @return The number of bits set in x.
+static inline uint32_t popcount64(uint64_t x)
+{
+    x =  x - ((x >> 1) & 0x5555555555555555ULL);
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (uint32_t)((x * 0x0101010101010101ULL) >> 56);
+}
+
+/// @summary Finds the index of the lowest set bit in a non-zero value.
+/// @param x The input value, which must be non-zero.
+/// @return The zero-based index of the lowest set bit.
+static inline uint32_t ctz64(uint64_t x)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, x);
+    return (uint32_t) index;
+#else
+    return (uint32_t) __builtin_ctzll(x);
+#endif
+}
+
+/// @summary Initializes an empty bitset able to hold IDs in [0, bit_count).
+/// @param set The bitset to initialize.
+/// @param bit_count The number of possible IDs.
+static void bitset_init(bitset_t *set, size_t bit_count)
+{
+    set->bit_count  = bit_count;
+    set->word_count = (bit_count + 63) / 64;
+    set->words      = (uint64_t*) calloc(set->word_count ? set->word_count : 1, sizeof(uint64_t));
+}
+
+/// @summary Frees the storage associated with a bitset.
+/// @param set The bitset to free.
+static void bitset_free(bitset_t *set)
+{
+    free(set->words);
+    set->bit_count  = 0;
+    set->word_count = 0;
+    set->words      = NULL;
+}
+
+/// @summary Removes every ID from a bitset.
+/// @param set The bitset to clear.
+static void bitset_clear(bitset_t *set)
+{
+    memset(set->words, 0, set->word_count * sizeof(uint64_t));
+}
+
+/// @summary Counts the IDs in a bitset.
+/// @param set The bitset.
+/// @return The number of IDs present.
+static size_t bitset_count(bitset_t const *set)
+{
+    size_t n = 0;
+    for (size_t w = 0; w < set->word_count; ++w)
+    {
+        n += popcount64(set->words[w]);
+    }
+    return n;
+}
+
+/// @summary Computes dst = a AND b, a OR b or a AND NOT b, one word at a time.
+/// All three bitsets must have the same bit_count; dst may alias a or b.
+/// @param dst The output bitset.
+/// @param a The first input.
+/// @param b The second input.
+static void bitset_and(bitset_t *dst, bitset_t const *a, bitset_t const *b)
+{
+    for (size_t w = 0; w < dst->word_count; ++w) dst->words[w] = a->words[w] & b->words[w];
+}
+static void bitset_or(bitset_t *dst, bitset_t const *a, bitset_t const *b)
+{
+    for (size_t w = 0; w < dst->word_count; ++w) dst->words[w] = a->words[w] | b->words[w];
+}
+static void bitset_andnot(bitset_t *dst, bitset_t const *a, bitset_t const *b)
+{
+    for (size_t w = 0; w < dst->word_count; ++w) dst->words[w] = a->words[w] & ~b->words[w];
+}
+
+/// @summary Calls a function for each ID in a set of bitset words, in
+/// ascending order, clearing the lowest set bit of each word in turn.
+/// @param words The words to scan.
+/// @param word_count The number of words.
+/// @param base The ID corresponding to bit zero of words[0].
+/// @param func A callable invoked as func(id_t).
+template <typename id_func_t>
+static inline void bitwords_for_each(uint64_t const *words, size_t word_count, id_t base, id_func_t const &func)
+{
+    for (size_t w = 0; w < word_count; ++w)
+    {
+        uint64_t word = words[w];
+        while (word)
+        {
+            func((id_t)(base + w * 64 + ctz64(word)));
+            word &= word - 1;
+        }
+    }
+}
+
+/// @summary Calls a function for each ID in a bitset, in ascending order.
+/// @param set The bitset.
+/// @param func A callable invoked as func(id_t).
+template <typename id_func_t>
+static void bitset_for_each(bitset_t const *set, id_func_t const &func)
+{
+    bitwords_for_each(set->words, set->word_count, 0, func);
+}
+
+/// @summary Classifies records into one bitset per column, with set semantics
+/// as under HIT_POLICY_UNIQUE: columns sharing an output set it once. Each
+/// column's matches are accumulated in a register and stored once per 64
+/// consecutive IDs, so dense IDs cost one memory write per 64 records per
+/// column instead of one per record.
+/// @param masks The masks generated from each column in the condition table.
+/// @param outputs An array of output bitsets, one for each column. Every
+/// ID must be less than the bit_count of each output.
+/// @param column_count The number of columns in the condition table.
+/// @param ids An array of IDs associated with each input record.
+/// @param bits An array of bitfields computed for each input record.
+/// @param record_count The number of input records.
+static void classify_bitset(query_mask_t const *masks, bitset_t **outputs, size_t column_count, id_t const *ids, uint32_t const *bits, size_t record_count)
+{
+    std::vector<uint64_t> acc(column_count, 0);
+    size_t                word = record_count ? ids[0] >> 6 : 0;
+    for (size_t i = 0; i < record_count; ++i)
+    {
+        id_t id = ids[i];
+        if ((id >> 6) != word)
+        {
+            for (size_t j = 0; j < column_count; ++j)
+            {
+                outputs[j]->words[word] |= acc[j];
+                acc[j] = 0;
+            }
+            word = id >> 6;
+        }
+        uint32_t bitfield = bits[i];
+        for (size_t j = 0; j < column_count; ++j)
+        {
+            uint32_t met = bits_all_set((bitfield ^ masks[j].bits_false) | masks[j].bits_ignore);
+            acc[j] |= (uint64_t) met << (id & 63);
+        }
+    }
+    for (size_t j = 0; j < column_count && record_count > 0; ++j)
+    {
+        outputs[j]->words[word] |= acc[j];
+    }
+}
+
+/// @summary Classifies records into bitsets like classify_bitset(), using
+/// AVX2 for aligned runs of 64 consecutive IDs: each column's match bits are
+/// gathered eight records at a time with a compare and movemask, and the
+/// finished word is stored directly. Other records use classify_bitset().
+/// @param masks The masks generated from each column in the condition table.
+/// @param outputs An array of output bitsets, one for each column.
+/// @param column_count The number of columns in the condition table.
+/// @param ids An array of IDs associated with each input record.
+/// @param bits An array of bitfields computed for each input record.
+/// @param record_count The number of input records.
+TARGET_AVX2
+static void classify_bitset_avx2(query_mask_t const *masks, bitset_t **outputs, size_t column_count, id_t const *ids, uint32_t const *bits, size_t record_count)
+{
+    __m256i const ones = _mm256_set1_epi32(-1);
+    __m256i const iota = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    size_t        tail = 0; // the first record not yet classified
+    size_t        i    = 0;
+    while (i + 64 <= record_count)
+    {
+        id_t base = ids[i];
+        if ((base & 63) != 0)
+        {
+            i += 64 - (base & 63); // skip to where the next aligned ID would be.
+            continue;
+        }
+        bool dense = ids[i + 63] == base + 63; // the cheap endpoint test first
+        if (dense)
+        {
+            __m256i same = ones;
+            for (size_t k = 0; k < 64; k += 8)
+            {
+                __m256i expect = _mm256_add_epi32(_mm256_set1_epi32((int32_t)(base + k)), iota);
+                __m256i actual = _mm256_loadu_si256((__m256i const*) &ids[i + k]);
+                same = _mm256_and_si256(same, _mm256_cmpeq_epi32(expect, actual));
+            }
+            dense = _mm256_movemask_epi8(same) == -1;
+        }
+        if (!dense)
+        {
+            // no record before the first one to break the run holds an
+            // aligned ID, so the search resumes there.
+            size_t k = 1;
+            while (ids[i + k] == base + k)
+            {
+                ++k;
+            }
+            i += k;
+            continue;
+        }
+        classify_bitset(masks, outputs, column_count, ids + tail, bits + tail, i - tail);
+        __m256i b[8];
+        for (size_t k = 0; k < 8; ++k)
+        {
+            b[k] = _mm256_loadu_si256((__m256i const*) &bits[i + k * 8]);
+        }
+        for (size_t j = 0; j < column_count; ++j)
+        {
+            __m256i  f    = _mm256_set1_epi32((int32_t) masks[j].bits_false);
+            __m256i  g    = _mm256_set1_epi32((int32_t) masks[j].bits_ignore);
+            uint64_t word = 0;
+            for (size_t k = 0; k < 8; ++k)
+            {
+                __m256i met = _mm256_cmpeq_epi32(_mm256_or_si256(_mm256_xor_si256(b[k], f), g), ones);
+                word |= (uint64_t)(uint32_t) _mm256_movemask_ps(_mm256_castsi256_ps(met)) << (k * 8);
+            }
+            outputs[j]->words[base >> 6] |= word;
+        }
+        i   += 64;
+        tail = i;
+    }
+    classify_bitset(masks, outputs, column_count, ids + tail, bits + tail, record_count - tail);
+}
+
+/// @summary A bitset classifier, classify_bitset or classify_bitset_avx2.
+typedef void (*classify_bitset_func_t)(query_mask_t const*, bitset_t**, size_t, id_t const*, uint32_t const*, size_t);
+
+/// @summary Frees the storage owned by a container.
+/// @param c The container to free.
+static void roaring_container_free(roaring_container_t *c)
+{
+    free(c->array);
+    free(c->bitmap);
+    c->array  = NULL;
+    c->bitmap = NULL;
+}
+
+/// @summary Expands a container into Roaring_Chunk_Words words of bits.
+/// @param c The container.
+/// @param words The destination words, overwritten.
+static void roaring_container_expand(roaring_container_t const *c, uint64_t *words)
+{
+    if (c->bitmap)
+    {
+        memcpy(words, c->bitmap, Roaring_Chunk_Words * sizeof(uint64_t));
+        return;
+    }
+    memset(words, 0, Roaring_Chunk_Words * sizeof(uint64_t));
+    for (uint32_t k = 0; k < c->cardinality; ++k)
+    {
+        words[c->array[k] >> 6] |= 1ULL << (c->array[k] & 63);
+    }
+}
+
+/// @summary Builds a container from Roaring_Chunk_Words words of bits,
+/// choosing the smaller representation.
+/// @param c The container to populate.
+/// @param key The upper 16 bits of the IDs in the chunk.
+/// @param words The bits of the chunk.
+/// @return false if the chunk is empty, in which case no container is created.
+static bool roaring_container_pack(roaring_container_t *c, uint32_t key, uint64_t const *words)
+{
+    uint32_t cardinality = 0;
+    for (size_t w = 0; w < Roaring_Chunk_Words; ++w)
+    {
+        cardinality += popcount64(words[w]);
+    }
+    if (cardinality == 0)
+        return false;
+
+    c->key         = key;
+    c->cardinality = cardinality;
+    c->array       = NULL;
+    c->bitmap      = NULL;
+    if (cardinality <= Roaring_Array_Max)
+    {
+        uint32_t n = 0;
+        c->array   = (uint16_t*) malloc(cardinality * sizeof(uint16_t));
+        bitwords_for_each(words, Roaring_Chunk_Words, 0, [c, &n](id_t low) { c->array[n++] = (uint16_t) low; });
+    }
+    else
+    {
+        c->bitmap = (uint64_t*) malloc(Roaring_Chunk_Words * sizeof(uint64_t));
+        memcpy(c->bitmap, words, Roaring_Chunk_Words * sizeof(uint64_t));
+    }
+    return true;
+}
+
+/// @summary Initializes an empty compressed bitmap.
+/// @param r The compressed bitmap to initialize.
+static void roaring_init(roaring_bitmap_t *r)
+{
+    r->containers.clear();
+}
+
+/// @summary Removes every ID from a compressed bitmap, freeing its containers.
+/// @param r The compressed bitmap to clear.
+static void roaring_clear(roaring_bitmap_t *r)
+{
+    for (size_t i = 0; i < r->containers.size(); ++i)
+    {
+        roaring_container_free(&r->containers[i]);
+    }
+    r->containers.clear();
+}
+
+/// @summary Frees the storage associated with a compressed bitmap.
+/// @param r The compressed bitmap to free.
+static void roaring_free(roaring_bitmap_t *r)
+{
+    roaring_clear(r);
+    r->containers.shrink_to_fit();
+}
+
+/// @summary Merges one chunk of bits into a compressed bitmap. Chunks are
+/// usually added in ascending key order, which appends; otherwise the chunk
+/// is ORed into, or inserted among, the existing containers.
+/// @param r The compressed bitmap.
+/// @param key The upper 16 bits of the IDs in the chunk.
+/// @param words Roaring_Chunk_Words words of bits. Modified if the chunk is
+/// merged with an existing container.
+static void roaring_add_chunk(roaring_bitmap_t *r, uint32_t key, uint64_t *words)
+{
+    std::vector<roaring_container_t> &cs = r->containers;
+    size_t pos = cs.size();
+    while (pos > 0 && cs[pos - 1].key > key)
+    {
+        --pos;
+    }
+    roaring_container_t c;
+    if (pos > 0 && cs[pos - 1].key == key)
+    {
+        uint64_t existing[Roaring_Chunk_Words];
+        roaring_container_expand(&cs[pos - 1], existing);
+        for (size_t w = 0; w < Roaring_Chunk_Words; ++w)
+        {
+            words[w] |= existing[w];
+        }
+        roaring_container_free(&cs[pos - 1]);
+        roaring_container_pack(&cs[pos - 1], key, words);
+    }
+    else if (roaring_container_pack(&c, key, words))
+    {
+        cs.insert(cs.begin() + pos, c);
+    }
+}
+
+/// @summary Counts the IDs in a compressed bitmap.
+/// @param r The compressed bitmap.
+/// @return The number of IDs present.
+static size_t roaring_count(roaring_bitmap_t const *r)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < r->containers.size(); ++i)
+    {
+        n += r->containers[i].cardinality;
+    }
+    return n;
+}
+
+/// @summary Computes the number of bytes used by a compressed bitmap.
+/// @param r The compressed bitmap.
+/// @return The size of the containers and their contents, in bytes.
+static size_t roaring_bytes(roaring_bitmap_t const *r)
+{
+    size_t n = r->containers.size() * sizeof(roaring_container_t);
+    for (size_t i = 0; i < r->containers.size(); ++i)
+    {
+        roaring_container_t const *c = &r->containers[i];
+        n += c->bitmap ? Roaring_Chunk_Words * sizeof(uint64_t) : c->cardinality * sizeof(uint16_t);
+    }
+    return n;
+}
+
+/// @summary Calls a function for each ID in a compressed bitmap, in ascending order.
+/// @param r The compressed bitmap.
+/// @param func A callable invoked as func(id_t).
+template <typename id_func_t>
+static void roaring_for_each(roaring_bitmap_t const *r, id_func_t const &func)
+{
+    for (size_t i = 0; i < r->containers.size(); ++i)
+    {
+        roaring_container_t const *c    = &r->containers[i];
+        id_t                       base = (id_t) c->key << 16;
+        if (c->bitmap)
+        {
+            bitwords_for_each(c->bitmap, Roaring_Chunk_Words, base, func);
+        }
+        else for (uint32_t k = 0; k < c->cardinality; ++k)
+        {
+            func(base | c->array[k]);
+        }
+    }
+}
+
+/// @summary Define the set operations supported on compressed bitmaps.
+enum set_op_e
+{
+    SET_OP_AND                         = 0, // IDs present in both inputs
+    SET_OP_OR                          = 1, // IDs present in either input
+    SET_OP_ANDNOT                      = 2, // IDs present in the first input but not the second
+    SET_OP_COUNT                       = 3
+};
+
+/// @summary A lookup table of strings for pretty-printing set_op_e values.
+static char const *Set_Op_Names[SET_OP_COUNT] =
+{
+    "AND",
+    "OR",
+    "ANDNOT"
+};
+
+/// @summary Computes a set operation on two compressed bitmaps, merging their
+/// containers by key. Two array containers are merged directly; any other
+/// pair is combined as bitmaps and repacked.
+/// @param dst The output compressed bitmap; cleared first. Must not alias a or b.
+/// @param a The first input.
+/// @param b The second input.
+/// @param op One of set_op_e.
+static void roaring_set_op(roaring_bitmap_t *dst, roaring_bitmap_t const *a, roaring_bitmap_t const *b, set_op_e op)
+{
+    uint64_t wa[Roaring_Chunk_Words];
+    uint64_t wb[Roaring_Chunk_Words];
+    size_t   i = 0, j = 0;
+    roaring_clear(dst);
+    while (i < a->containers.size() || j < b->containers.size())
+    {
+        roaring_container_t const *ca = (i < a->containers.size()) ? &a->containers[i] : NULL;
+        roaring_container_t const *cb = (j < b->containers.size()) ? &b->containers[j] : NULL;
+        uint32_t                   ka = ca ? ca->key : UINT32_MAX;
+        uint32_t                   kb = cb ? cb->key : UINT32_MAX;
+        uint32_t                   key = ka < kb ? ka : kb;
+        ca = (ka == key) ? ca : NULL;
+        cb = (kb == key) ? cb : NULL;
+        i += ca ? 1 : 0;
+        j += cb ? 1 : 0;
+        if ((op == SET_OP_AND && (!ca || !cb)) || (op == SET_OP_ANDNOT && !ca))
+            continue;
+
+        roaring_container_t c;
+        if (ca && cb && ca->array && cb->array)
+        {
+            // merge the sorted arrays.
+            uint16_t out[2 * Roaring_Array_Max];
+            uint32_t n = 0, x = 0, y = 0;
+            while (x < ca->cardinality || y < cb->cardinality)
+            {
+                uint32_t va = (x < ca->cardinality) ? ca->array[x] : 0x10000;
+                uint32_t vb = (y < cb->cardinality) ? cb->array[y] : 0x10000;
+                bool     in = (op == SET_OP_OR) || (op == SET_OP_AND ? va == vb : va < vb);
+                if (in) out[n++] = (uint16_t)(va <= vb ? va : vb);
+                x += (va <= vb) ? 1 : 0;
+                y += (vb <= va) ? 1 : 0;
+            }
+            if (n == 0)
+                continue;
+            if (n <= Roaring_Array_Max)
+            {
+                c.key         = key;
+                c.cardinality = n;
+                c.bitmap      = NULL;
+                c.array       = (uint16_t*) malloc(n * sizeof(uint16_t));
+                memcpy(c.array, out, n * sizeof(uint16_t));
+                dst->containers.push_back(c);
+                continue;
+            }
+        }
+        if (ca) roaring_container_expand(ca, wa); else memset(wa, 0, sizeof(wa));
+        if (cb) roaring_container_expand(cb, wb); else memset(wb, 0, sizeof(wb));
+        for (size_t w = 0; w < Roaring_Chunk_Words; ++w)
+        {
+            wa[w] = (op == SET_OP_AND) ? (wa[w] & wb[w]) : ((op == SET_OP_OR) ? (wa[w] | wb[w]) : (wa[w] & ~wb[w]));
+        }
+        if (roaring_container_pack(&c, key, wa))
+        {
+            dst->containers.push_back(c);
+        }
+    }
+}
+
+/// @summary Classifies records into one compressed bitmap per column, with
+/// set semantics as classify_bitset(). Matches are gathered into a dense
+/// 8KB chunk per output, which stays in cache, and each chunk is packed into
+/// a container when the IDs move on to the next chunk.
+/// @param masks The masks generated from each column in the condition table.
+/// @param outputs An array of output bitmaps, one for each column.
+/// @param column_count The number of columns in the condition table.
+/// @param ids An array of IDs associated with each input record.
+/// @param bits An array of bitfields computed for each input record.
+/// @param record_count The number of input records.
+/// @param kernel The bitset classifier used for each chunk.
+static void classify_roaring(query_mask_t const *masks, roaring_bitmap_t **outputs, size_t column_count, id_t const *ids, uint32_t const *bits, size_t record_count, classify_bitset_func_t kernel)
+{
+    // columns sharing an output share one chunk.
+    std::vector<roaring_bitmap_t*> targets;
+    std::vector<uint32_t>          slot(column_count);
+    for (size_t j = 0; j < column_count; ++j)
+    {
+        size_t t = std::find(targets.begin(), targets.end(), outputs[j]) - targets.begin();
+        if (t == targets.size()) targets.push_back(outputs[j]);
+        slot[j] = (uint32_t) t;
+    }
+    std::vector<uint64_t> chunks(targets.size() * Roaring_Chunk_Words, 0);
+    std::vector<bitset_t> views(targets.size());
+    std::vector<bitset_t*> view_outputs(column_count);
+    for (size_t t = 0; t < targets.size(); ++t)
+    {
+        views[t].bit_count  = Roaring_Chunk_Bits;
+        views[t].word_count = Roaring_Chunk_Words;
+        views[t].words      = &chunks[t * Roaring_Chunk_Words];
+    }
+    for (size_t j = 0; j < column_count; ++j)
+    {
+        view_outputs[j] = &views[slot[j]];
+    }
+
+    // classify runs of records within a chunk with IDs rebased to the chunk.
+    std::vector<id_t> low(Roaring_Chunk_Bits);
+    size_t i = 0;
+    while (i < record_count)
+    {
+        uint32_t key   = ids[i] >> 16;
+        size_t   start = i;
+        while (i < record_count && (ids[i] >> 16) == key && i - start < Roaring_Chunk_Bits)
+        {
+            low[i - start] = ids[i] & 0xFFFF;
+            ++i;
+        }
+        kernel(masks, &view_outputs[0], column_count, &low[0], bits + start, i - start);
+        for (size_t t = 0; t < targets.size(); ++t)
+        {
+            roaring_add_chunk(targets[t], key, views[t].words);
+            memset(views[t].words, 0, Roaring_Chunk_Words * sizeof(uint64_t));
+        }
+    }
+}
+
+/*//////////////////////
+//  Packed ID Lists   //
+//////////////////////*/
+/// @summary The number of IDs in each packed block. Blocks are packed as 32
+/// groups of four IDs, one bit-packed stream per SSE2 lane.
+static const size_t Packed_Block_Size = 128;
+
+/// @summary A compressed list of IDs, for nondecreasing sequences such as
+/// classify() output. Complete blocks of Packed_Block_Size IDs store the
+/// differences between consecutive IDs, bit-packed at the width of the
+/// largest difference in the block (SIMD-BP128 layout); the final partial
+/// block is kept uncompressed until it fills. Decreasing IDs are allowed
+/// but cost a full 32 bits per ID in their block.
+struct packed_id_list_t
+{
+    size_t                count;         /// The total number of IDs in the list
+    id_t                  base;          /// The ID preceding the partial block, or zero
+    std::vector<uint32_t> words;         /// The packed blocks, 4 * width words per block
+    std::vector<uint32_t> block_offset;  /// The index in words of the start of each block
+    std::vector<id_t>     block_base;    /// The ID preceding each block's first ID
+    std::vector<uint8_t>  block_width;   /// The number of bits per difference in each block
+    size_t                pending_count; /// The number of IDs in the partial block
+    id_t                  pending[Packed_Block_Size]; /// The partial block, uncompressed
+};
+
+/// @summary Initializes an empty packed ID list.
+/// @param list The list to initialize.
+static void packed_ids_init(packed_id_list_t *list)
+{
+    list->count         = 0;
+    list->base          = 0;
+    list->pending_count = 0;
+    list->words.clear();
+    list->block_offset.clear();
+    list->block_base.clear();
+    list->block_width.clear();
+}
+
+/// @summary Removes every ID from a packed ID list, keeping its storage.
+/// @param list The list to clear.
+static void packed_ids_clear(packed_id_list_t *list)
+{
+    packed_ids_init(list);
+}
+
+/// @summary Frees the storage associated with a packed ID list.
+/// @param list The list to free.
+static void packed_ids_free(packed_id_list_t *list)
+{
+    packed_ids_init(list);
+    list->words.shrink_to_fit();
+    list->block_offset.shrink_to_fit();
+    list->block_base.shrink_to_fit();
+    list->block_width.shrink_to_fit();
+}
+
+/// @summary Computes the number of bytes used by a packed ID list.
+/// @param list The packed ID list.
+/// @return The size of the packed data, block index and partial block, in bytes.
+static size_t packed_ids_bytes(packed_id_list_t const *list)
+{
+    return list->words.size() * sizeof(uint32_t) +
+           list->block_offset.size() * (sizeof(uint32_t) + sizeof(id_t) + sizeof(uint8_t)) +
+           list->pending_count * sizeof(id_t);
+}
+
+/// @summary Packs the partial block once it is full. Differences are formed
+/// four at a time with SSE2, and each lane's 32 differences are packed into
+/// width consecutive 32-bit words of that lane.
+/// @param list The packed ID list, whose partial block holds Packed_Block_Size IDs.
+static void packed_ids_pack_block(packed_id_list_t *list)
+{
+    __m128i d[Packed_Block_Size / 4];
+    __m128i prev = _mm_set1_epi32((int32_t) list->base);
+    __m128i any  = _mm_setzero_si128();
+    for (size_t i = 0; i < Packed_Block_Size / 4; ++i)
+    {
+        __m128i v = _mm_loadu_si128((__m128i const*) &list->pending[i * 4]);
+        __m128i s = _mm_or_si128(_mm_slli_si128(v, 4), _mm_srli_si128(prev, 12)); // v shifted up one ID
+        d[i] = _mm_sub_epi32(v, s);
+        any  = _mm_or_si128(any, d[i]);
+        prev = v;
+    }
+    any = _mm_or_si128(any, _mm_srli_si128(any, 8));
+    any = _mm_or_si128(any, _mm_srli_si128(any, 4));
+    uint32_t all   = (uint32_t) _mm_cvtsi128_si32(any);
+    uint32_t width = 0;
+    while (width < 32 && (all >> width) != 0)
+    {
+        ++width;
+    }
+
+    size_t offset = list->words.size();
+    list->block_offset.push_back((uint32_t) offset);
+    list->block_base.push_back(list->base);
+    list->block_width.push_back((uint8_t) width);
+    list->words.resize(offset + 4 * width);
+
+    __m128i  acc   = _mm_setzero_si128();
+    uint32_t shift = 0;
+    size_t   w     = 0;
+    for (size_t i = 0; i < Packed_Block_Size / 4 && width > 0; ++i)
+    {
+        acc    = _mm_or_si128(acc, _mm_sll_epi32(d[i], _mm_cvtsi32_si128((int) shift)));
+        shift += width;
+        if (shift >= 32)
+        {
+            _mm_storeu_si128((__m128i*) &list->words[offset + 4 * w++], acc);
+            shift -= 32;
+            // carry the bits of d[i] that did not fit; none if it ended exactly.
+            acc = shift ? _mm_srl_epi32(d[i], _mm_cvtsi32_si128((int)(width - shift))) : _mm_setzero_si128();
+        }
+    }
+    list->base          = list->pending[Packed_Block_Size - 1];
+    list->pending_count = 0;
+}
+
+/// @summary Appends an ID to a packed ID list.
+/// @param list The packed ID list.
+/// @param id The ID to append.
+static inline void packed_ids_append(packed_id_list_t *list, id_t id)
+{
+    list->pending[list->pending_count++] = id;
+    list->count++;
+    if (list->pending_count == Packed_Block_Size)
+    {
+        packed_ids_pack_block(list);
+    }
+}
+
+/// @summary Decodes a single packed block: unpacks each lane's differences
+/// with SSE2 shifts and restores the IDs with a four-wide prefix sum.
+/// @param list The packed ID list.
+/// @param block The zero-based index of the block.
+/// @param out Storage for Packed_Block_Size IDs.
+static inline void packed_ids_decode_block(packed_id_list_t const *list, size_t block, id_t *out)
+{
+    uint32_t       width = list->block_width[block];
+    uint32_t const *in   = &list->words[list->block_offset[block]];
+    __m128i        mask  = _mm_set1_epi32(width == 32 ? -1 : (int32_t)((1U << width) - 1));
+    __m128i        prev  = _mm_set1_epi32((int32_t) list->block_base[block]);
+    __m128i        cur   = width ? _mm_loadu_si128((__m128i const*) in) : _mm_setzero_si128();
+    uint32_t       shift = 0;
+    size_t         w     = 0;
+    for (size_t i = 0; i < Packed_Block_Size / 4; ++i)
+    {
+        __m128i v = _mm_srl_epi32(cur, _mm_cvtsi32_si128((int) shift));
+        shift += width;
+        if (shift >= 32 && width > 0)
+        {
+            shift -= 32;
+            if (++w < width)
+            {
+                cur = _mm_loadu_si128((__m128i const*) &in[4 * w]);
+                // the high bits of this difference start the next word.
+                if (shift) v = _mm_or_si128(v, _mm_sll_epi32(cur, _mm_cvtsi32_si128((int)(width - shift))));
+            }
+        }
+        v    = _mm_and_si128(v, mask);
+        v    = _mm_add_epi32(v, _mm_slli_si128(v, 4));
+        v    = _mm_add_epi32(v, _mm_slli_si128(v, 8));
+        v    = _mm_add_epi32(v, _mm_shuffle_epi32(prev, _MM_SHUFFLE(3, 3, 3, 3)));
+        _mm_storeu_si128((__m128i*) &out[i * 4], v);
+        prev = v;
+    }
+}
+
+/// @summary Decodes every ID in a packed ID list.
+/// @param list The packed ID list.
+/// @param out Storage for list->count IDs.
+static void packed_ids_decode(packed_id_list_t const *list, id_t *out)
+{
+    size_t block_count = list->block_width.size();
+    for (size_t b = 0; b < block_count; ++b)
+    {
+        packed_ids_decode_block(list, b, out + b * Packed_Block_Size);
+    }
+    memcpy(out + block_count * Packed_Block_Size, list->pending, list->pending_count * sizeof(id_t));
+}
+
+/// @summary Classifies records, appending matches to packed ID lists in the
+/// same order as classify() writes them to tables. The append is the same
+/// speculative store into the partial block; a block is packed each time
+/// Packed_Block_Size IDs have accumulated for an output.
+/// @param masks The masks generated from each column in the condition table.
+/// @param outputs An array of packed ID lists, one for each column.
+/// @param column_count The number of columns in the condition table.
+/// @param ids An array of IDs associated with each input record.
+/// @param bits An array of bitfields computed for each input record.
+/// @param record_count The number of input records.
+static void classify_packed(query_mask_t const *masks, packed_id_list_t **outputs, size_t column_count, id_t const *ids, uint32_t const *bits, size_t record_count)
+{
+    for (size_t i = 0; i < record_count; ++i)
+    {
+        id_t     id       = ids[i];
+        uint32_t bitfield = bits[i];
+        for (size_t j = 0; j < column_count; ++j)
+        {
+            packed_id_list_t *list = outputs[j];
+            uint32_t          met  = bits_all_set((bitfield ^ masks[j].bits_false) | masks[j].bits_ignore);
+            list->pending[list->pending_count] = id;
+            list->pending_count += met;
+            list->count         += met;
+            if (list->pending_count == Packed_Block_Size)
+            {
+                packed_ids_pack_block(list);
+            }
+        }
+    }
+}
+
+/*///////////////////////////////
+//  Condition Table Loader     //
+///////////////////////////////*/
+/// @summary Identifies a prepared table cache file and its format version.
+static const uint32_t Prepared_Table_Magic   = 0x4C425443U; // 'CTBL'
+static const uint32_t Prepared_Table_Version = 2;
+
+/// @summary Define where a prepared table was obtained from.
+enum table_source_e
+{
+    TABLE_SOURCE_PARSED                = 0, // the text file was parsed and validated
+    TABLE_SOURCE_DISK_CACHE            = 1, // loaded from the binary cache file
+    TABLE_SOURCE_MEMORY_CACHE          = 2, // found in the in-process cache
+    TABLE_SOURCE_COUNT                 = 3
+};
+
+/// @summary A lookup table of strings for pretty-printing table_source_e values.
+static char const *Table_Source_Names[TABLE_SOURCE_COUNT] =
+{
+    "parsed",
+    "disk cache",
+    "memory cache"
+};
+
+/// @summary A condition table loaded at runtime and prepared for classification.
+/// Rule cells are stored at the bit index of the named condition, so row_count
+/// covers every bit up to the highest condition referenced.
+struct prepared_table_t
+{
+    uint64_t                  hash;          /// The FNV-1a hash of the source text
+    size_t                    row_count;     /// The number of condition rows (bits)
+    size_t                    column_count;  /// The number of rules
+    size_t                    issue_count;   /// The number of problems reported by validation
+    hit_policy_e              hit_policy;    /// How matching rules produce output
+    std::vector<std::string>  action_names;  /// The name of each action, in declaration order
+    std::vector<uint32_t>     column_action; /// The action index of each rule
+    std::vector<rule_e>       rules;         /// column_count * row_count rules, column-major
+    std::vector<query_mask_t> masks;         /// The mask for each rule
+};
+
+/// @summary Caches prepared tables in memory and on disk, keyed by the hash of
+/// the source text, so reloading an unchanged table skips parsing entirely.
+struct table_cache_t
+{
+    std::string                           directory; /// Where cache files are written
+    std::map<uint64_t, prepared_table_t>  memory;    /// Tables prepared by this process
+};
+
+/// @summary A constraint between two conditions declared by a table file.
+struct condition_pair_t
+{
+    uint32_t     a;           /// The bit index of the first condition
+    uint32_t     b;           /// The bit index of the second condition
+    bool         complement;  /// true if exactly one is true, false if at most one is true
+};
+
+/// @summary Computes the 64-bit FNV-1a hash of a block of memory.
+/// @param data The data to hash.
+/// @param size The number of bytes to hash.
+/// @return The hash value.
+static uint64_t fnv1a64(void const *data, size_t size)
+{
+    uint8_t const *p = (uint8_t const*) data;
+    uint64_t       h = 0xCBF29CE484222325ULL;
+    for (size_t i = 0; i < size; ++i)
+    {
+        h ^= p[i];
+        h *= 0x100000001B3ULL;
+    }
+    return h;
+}
+
+/// @summary Reads an entire file into memory.
+/// @param path The path of the file to read.
+/// @param data On return, the contents of the file.
+/// @return true if the file was read.
+static bool read_file(char const *path, std::string *data)
+{
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL)
+    {
+        return false;
+    }
+    char   buffer[65536];
+    size_t n;
+    data->clear();
+    while ((n = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+    {
+        data->append(buffer, n);
+    }
+    bool ok = (ferror(fp) == 0);
+    fclose(fp);
+    return ok;
+}
+
+/// @summary Determines whether an assignment of condition bits satisfies the
+/// exclusive and complement constraints declared by a table file.
+/// @param bits The condition bits.
+/// @param pairs The declared constraints.
+/// @return true if the assignment is possible.
+static bool condition_pairs_allow(uint32_t bits, std::vector<condition_pair_t> const &pairs)
+{
+    for (size_t k = 0; k < pairs.size(); ++k)
+    {
+        uint32_t a = (bits >> pairs[k].a) & 1;
+        uint32_t b = (bits >> pairs[k].b) & 1;
+        if (a && b) return false;
+        if (pairs[k].complement && !a && !b) return false;
+    }
+    return true;
+}
+
+/// @summary Reports rules that can never match a record, and rules for which
+/// every matching record also matches some earlier rule, printing one line per
+/// problem to stdout. Rules with more than 20 don't-care cells are only checked
+/// for being covered by a single earlier rule.
+/// @param table The table to validate.
+/// @param pairs The exclusive and complement constraints declared by the file.
+/// @param path The file name to use in messages.
+/// @return The number of problems reported.
+static size_t prepared_table_validate(prepared_table_t const *table, std::vector<condition_pair_t> const &pairs, char const *path)
+{
+    size_t issues = 0;
+    size_t rows   = table->row_count;
+    for (size_t j = 0; j < table->column_count; ++j)
+    {
+        rule_e const *rule  = &table->rules[j * rows];
+        uint32_t      fixed = 0; // the bits constrained by the rule
+        uint32_t      value = 0; // the required values of the constrained bits
+        uint32_t      free_bits[MAX_BITS];
+        size_t        free_count = 0;
+        for (size_t i = 0; i < rows; ++i)
+        {
+            if (rule[i] == CONDITION_NULL) free_bits[free_count++] = (uint32_t) i;
+            else fixed |= 1U << i;
+            if (rule[i] == CONDITION_TRUE) value |= 1U << i;
+        }
+
+        if (free_count > 20)
+        {
+            for (size_t k = 0; k < j; ++k)
+            {
+                query_mask_t const *earlier = &table->masks[k];
+                // rule k covers rule j if every cell k constrains is constrained identically by j.
+                uint32_t k_fixed = ~earlier->bits_ignore;
+                if ((k_fixed & ~fixed) == 0 && (((value ^ ~earlier->bits_false) & k_fixed) == 0))
+                {
+                    printf("%s: rule %u (%s) is shadowed by rule %u (%s).\n", path, (uint32_t) j + 1,
+                        table->action_names[table->column_action[j]].c_str(), (uint32_t) k + 1,
+                        table->action_names[table->column_action[k]].c_str());
+                    issues++;
+                    break;
+                }
+            }
+            continue;
+        }
+
+        // enumerate every record the rule can match.
+        bool     satisfiable = false;
+        bool     shadowed    = true;
+        uint32_t shadow_rule = 0;
+        for (uint32_t m = 0; m < (1U << free_count); ++m)
+        {
+            uint32_t bits = value;
+            for (size_t f = 0; f < free_count; ++f)
+            {
+                bits |= ((m >> f) & 1) << free_bits[f];
+            }
+            if (!condition_pairs_allow(bits, pairs))
+            {
+                continue;
+            }
+            satisfiable = true;
+            bool covered = false;
+            for (size_t k = 0; k < j && !covered; ++k)
+            {
+                query_mask_t const *earlier = &table->masks[k];
+                if (((bits ^ earlier->bits_false) | earlier->bits_ignore) == 0xFFFFFFFFU)
+                {
+                    covered     = true;
+                    shadow_rule = (uint32_t) k;
+                }
+            }
+            if (!covered)
+            {
+                shadowed = false;
+                break;
+            }
+        }
+        if (!satisfiable)
+        {
+            printf("%s: rule %u (%s) is unsatisfiable.\n", path, (uint32_t) j + 1,
+                table->action_names[table->column_action[j]].c_str());
+            issues++;
+        }
+        else if (shadowed)
+        {
+            printf("%s: rule %u (%s) is fully shadowed by earlier rules (e.g. rule %u, %s).\n", path, (uint32_t) j + 1,
+                table->action_names[table->column_action[j]].c_str(), shadow_rule + 1,
+                table->action_names[table->column_action[shadow_rule]].c_str());
+            issues++;
+        }
+    }
+    return issues;
+}
+
+/// @summary Parses a condition table file. See res/loan_rules.ctbl for the format.
+/// @param table The table to populate.
+/// @param text The contents of the file.
+/// @param path The file name to use in messages.
+/// @param error A buffer that receives a description of the first error.
+/// @param error_size The size of the error buffer, in bytes.
+/// @return true if the file was parsed successfully.
+static bool prepared_table_parse(prepared_table_t *table, std::string const &text, char const *path, char *error, size_t error_size)
+{
+    std::vector<uint32_t>         condition_bits; // bit index of each declared condition
+    std::vector<condition_pair_t> pairs;
+    size_t                        line_number = 0;
+    size_t                        pos         = 0;
+
+    table->hash         = fnv1a64(text.data(), text.size());
+    table->row_count    = 0;
+    table->column_count = 0;
+    table->issue_count  = 0;
+    table->hit_policy   = HIT_POLICY_COLLECT;
+    table->action_names.clear();
+    table->column_action.clear();
+    table->rules.clear();
+    table->masks.clear();
+
+    while (pos < text.size())
+    {
+        size_t end = text.find('\n', pos);
+        if (end == std::string::npos) end = text.size();
+        std::string line = text.substr(pos, end - pos);
+        pos = end + 1;
+        line_number++;
+
+        size_t hash_mark = line.find('#');
+        if (hash_mark != std::string::npos) line.resize(hash_mark);
+        std::vector<std::string> tokens;
+        for (size_t i = 0; i < line.size(); )
+        {
+            while (i < line.size() && (line[i] == ' ' || line[i] == '\t' || line[i] == '\r')) ++i;
+            size_t start = i;
+            while (i < line.size() && !(line[i] == ' ' || line[i] == '\t' || line[i] == '\r')) ++i;
+            if (i > start) tokens.push_back(line.substr(start, i - start));
+        }
+        if (tokens.empty())
+        {
+            continue;
+        }
+
+        std::string const &keyword = tokens[0];
+        if (keyword == "condition" && tokens.size() == 2)
+        {
+            if (!table->rules.empty())
+            {
+                snprintf(error, error_size, "%s(%u): conditions must be declared before rules.", path, (uint32_t) line_number);
+                return false;
+            }
+            size_t bit = 0;
+            while (bit < Condition_Name_Count && tokens[1] != Condition_Names[bit]) ++bit;
+            if (bit == Condition_Name_Count)
+            {
+                snprintf(error, error_size, "%s(%u): unknown condition '%s'.", path, (uint32_t) line_number, tokens[1].c_str());
+                return false;
+            }
+            if (std::find(condition_bits.begin(), condition_bits.end(), (uint32_t) bit) != condition_bits.end())
+            {
+                snprintf(error, error_size, "%s(%u): condition '%s' is declared twice.", path, (uint32_t) line_number, tokens[1].c_str());
+                return false;
+            }
+            condition_bits.push_back((uint32_t) bit);
+            if (bit + 1 > table->row_count) table->row_count = bit + 1;
+        }
+        else if (keyword == "hit_policy" && tokens.size() == 2)
+        {
+            size_t policy = 0;
+            while (policy < HIT_POLICY_COUNT && tokens[1] != Hit_Policy_Names[policy]) ++policy;
+            if (policy == HIT_POLICY_COUNT)
+            {
+                snprintf(error, error_size, "%s(%u): unknown hit policy '%s'.", path, (uint32_t) line_number, tokens[1].c_str());
+                return false;
+            }
+            table->hit_policy = (hit_policy_e) policy;
+        }
+        else if (keyword == "action" && tokens.size() == 2)
+        {
+            if (std::find(table->action_names.begin(), table->action_names.end(), tokens[1]) != table->action_names.end())
+            {
+                snprintf(error, error_size, "%s(%u): action '%s' is declared twice.", path, (uint32_t) line_number, tokens[1].c_str());
+                return false;
+            }
+            table->action_names.push_back(tokens[1]);
+        }
+        else if ((keyword == "exclusive" || keyword == "complement") && tokens.size() == 3)
+        {
+            condition_pair_t pair;
+            uint32_t        *ends[2] = { &pair.a, &pair.b };
+            for (size_t k = 0; k < 2; ++k)
+            {
+                size_t bit = 0;
+                while (bit < Condition_Name_Count && tokens[1 + k] != Condition_Names[bit]) ++bit;
+                if (bit == Condition_Name_Count)
+                {
+                    snprintf(error, error_size, "%s(%u): unknown condition '%s'.", path, (uint32_t) line_number, tokens[1 + k].c_str());
+                    return false;
+                }
+                *ends[k] = (uint32_t) bit;
+            }
+            pair.complement = (keyword == "complement");
+            pairs.push_back(pair);
+        }
+        else if (keyword == "rule" && tokens.size() >= 2)
+        {
+            if (tokens.size() != 2 + condition_bits.size())
+            {
+                snprintf(error, error_size, "%s(%u): expected %u cells, found %u.", path, (uint32_t) line_number,
+                    (uint32_t) condition_bits.size(), (uint32_t)(tokens.size() - 2));
+                return false;
+            }
+            size_t action = 0;
+            while (action < table->action_names.size() && tokens[1] != table->action_names[action]) ++action;
+            if (action == table->action_names.size())
+            {
+                snprintf(error, error_size, "%s(%u): unknown action '%s'.", path, (uint32_t) line_number, tokens[1].c_str());
+                return false;
+            }
+            // rows are stored at their bit index; rows no condition names are don't care.
+            std::vector<rule_e> column(Condition_Name_Count, CONDITION_NULL);
+            for (size_t k = 0; k < condition_bits.size(); ++k)
+            {
+                std::string const &cell = tokens[2 + k];
+                if      (cell == "T") column[condition_bits[k]] = CONDITION_TRUE;
+                else if (cell == "F") column[condition_bits[k]] = CONDITION_FALSE;
+                else if (cell == "-") column[condition_bits[k]] = CONDITION_NULL;
+                else
+                {
+                    snprintf(error, error_size, "%s(%u): invalid cell '%s'; expected T, F or -.", path, (uint32_t) line_number, cell.c_str());
+                    return false;
+                }
+            }
+            table->rules.insert(table->rules.end(), column.begin(), column.end());
+            table->column_action.push_back((uint32_t) action);
+            table->column_count++;
+        }
+        else
+        {
+            snprintf(error, error_size, "%s(%u): unrecognized line '%s'.", path, (uint32_t) line_number, keyword.c_str());
+            return false;
+        }
+    }
+    if (table->column_count == 0)
+    {
+        snprintf(error, error_size, "%s: the table defines no rules.", path);
+        return false;
+    }
+
+    // compact the columns from Condition_Name_Count rows to row_count rows.
+    std::vector<rule_e> compact(table->column_count * table->row_count);
+    table->masks.resize(table->column_count);
+    for (size_t j = 0; j < table->column_count; ++j)
+    {
+        for (size_t i = 0; i < table->row_count; ++i)
+        {
+            compact[j * table->row_count + i] = table->rules[j * Condition_Name_Count + i];
+        }
+        build_column_mask(&table->masks[j], &compact[j * table->row_count], table->row_count);
+    }
+    table->rules.swap(compact);
+    table->issue_count = prepared_table_validate(table, pairs, path);
+    return true;
+}
+
+/// @summary Builds the path of the cache file for a given content hash.
+/// @param cache The table cache.
+/// @param hash The hash of the table's source text.
+/// @return The path of the cache file.
+static std::string table_cache_path(table_cache_t const *cache, uint64_t hash)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "ctbl-%016" PRIx64 ".bin", hash);
+    return cache->directory.empty() ? std::string(name) : cache->directory + "/" + name;
+}
+
+/// @summary Writes a prepared table to the disk cache. Failures are ignored;
+/// the table will simply be parsed again next time.
+/// @param cache The table cache.
+/// @param table The prepared table to write.
+static void table_cache_write(table_cache_t const *cache, prepared_table_t const *table)
+{
+    std::string path = table_cache_path(cache, table->hash);
+    FILE       *fp   = fopen(path.c_str(), "wb");
+    if (fp == NULL)
+    {
+        return;
+    }
+    uint64_t header[8] =
+    {
+        Prepared_Table_Magic, Prepared_Table_Version, table->hash,
+        table->row_count, table->column_count, table->issue_count, table->action_names.size(),
+        (uint64_t) table->hit_policy
+    };
+    fwrite(header, sizeof(header), 1, fp);
+    for (size_t a = 0; a < table->action_names.size(); ++a)
+    {
+        uint32_t length = (uint32_t) table->action_names[a].size();
+        fwrite(&length, sizeof(length), 1, fp);
+        fwrite(table->action_names[a].data(), 1, length, fp);
+    }
+    fwrite(&table->column_action[0], sizeof(uint32_t), table->column_count, fp);
+    fwrite(&table->rules[0], sizeof(rule_e), table->rules.size(), fp);
+    fwrite(&table->masks[0], sizeof(query_mask_t), table->column_count, fp);
+    fclose(fp);
+}
+
+/// @summary Reads a prepared table from the disk cache.
+/// @param cache The table cache.
+/// @param hash The hash of the table's source text.
+/// @param table The prepared table to populate.
+/// @return true if a valid cache file was found.
+static bool table_cache_read(table_cache_t const *cache, uint64_t hash, prepared_table_t *table)
+{
+    std::string data;
+    if (!read_file(table_cache_path(cache, hash).c_str(), &data))
+    {
+        return false;
+    }
+    uint64_t header[8];
+    size_t   pos = sizeof(header);
+    if (data.size() < pos)
+    {
+        return false;
+    }
+    memcpy(header, data.data(), sizeof(header));
+    if (header[0] != Prepared_Table_Magic || header[1] != Prepared_Table_Version || header[2] != hash || header[3] > MAX_BITS || header[7] >= HIT_POLICY_COUNT)
+    {
+        return false;
+    }
+    table->hash         = hash;
+    table->row_count    = (size_t) header[3];
+    table->column_count = (size_t) header[4];
+    table->issue_count  = (size_t) header[5];
+    table->hit_policy   = (hit_policy_e) header[7];
+    table->action_names.resize((size_t) header[6]);
+    for (size_t a = 0; a < table->action_names.size(); ++a)
+    {
+        uint32_t length;
+        if (data.size() < pos + sizeof(length)) return false;
+        memcpy(&length, data.data() + pos, sizeof(length));
+        pos += sizeof(length);
+        if (data.size() < pos + length) return false;
+        table->action_names[a].assign(data.data() + pos, length);
+        pos += length;
+    }
+    size_t payload = table->column_count * (sizeof(uint32_t) + table->row_count * sizeof(rule_e) + sizeof(query_mask_t));
+    if (table->column_count == 0 || data.size() != pos + payload)
+    {
+        return false;
+    }
+    table->column_action.resize(table->column_count);
+    table->rules.resize(table->column_count * table->row_count);
+    table->masks.resize(table->column_count);
+    memcpy(&table->column_action[0], data.data() + pos, table->column_count * sizeof(uint32_t));
+    pos += table->column_count * sizeof(uint32_t);
+    memcpy(&table->rules[0], data.data() + pos, table->rules.size() * sizeof(rule_e));
+    pos += table->rules.size() * sizeof(rule_e);
+    memcpy(&table->masks[0], data.data() + pos, table->column_count * sizeof(query_mask_t));
+    // a corrupt or stale file must not index past the action names.
+    for (size_t j = 0; j < table->column_count; ++j)
+    {
+        if (table->column_action[j] >= table->action_names.size()) return false;
+    }
+    for (size_t i = 0; i < table->rules.size(); ++i)
+    {
+        if (table->rules[i] > CONDITION_NULL) return false;
+    }
+    return true;
+}
+
+/// @summary Loads a condition table file, using the in-memory cache, then the
+/// disk cache, and finally parsing and validating the text. Newly parsed
+/// tables are added to both caches.
+/// @param cache The table cache.
+/// @param path The path of the condition table file.
+/// @param table On return, the prepared table.
+/// @param source On return, one of table_source_e.
+/// @param error A buffer that receives a description of any error.
+/// @param error_size The size of the error buffer, in bytes.
+/// @return true if the table was loaded.
+static bool table_cache_load(table_cache_t *cache, char const *path, prepared_table_t *table, table_source_e *source, char *error, size_t error_size)
+{
+    std::string text;
+    if (!read_file(path, &text))
+    {
+        snprintf(error, error_size, "%s: unable to read file.", path);
+        return false;
+    }
+    uint64_t hash = fnv1a64(text.data(), text.size());
+    std::map<uint64_t, prepared_table_t>::const_iterator it = cache->memory.find(hash);
+    if (it != cache->memory.end())
+    {
+        *table  = it->second;
+        *source = TABLE_SOURCE_MEMORY_CACHE;
+        return true;
+    }
+    if (table_cache_read(cache, hash, table))
+    {
+        cache->memory[hash] = *table;
+        *source = TABLE_SOURCE_DISK_CACHE;
+        return true;
+    }
+    if (!prepared_table_parse(table, text, path, error, error_size))
+    {
+        return false;
+    }
+    table_cache_write(cache, table);
+    cache->memory[hash] = *table;
+    *source = TABLE_SOURCE_PARSED;
+    return true;
+}
+
+/// @summary Maps each rule of a prepared table to an output table by action name.
+/// @param table The prepared table.
+/// @param names The names of the available actions.
+/// @param tables The output table for each name.
+/// @param count The number of available actions.
+/// @param outputs On return, the output table for each rule.
+/// @param error A buffer that receives a description of any error.
+/// @param error_size The size of the error buffer, in bytes.
+/// @return true if every action used by the table was bound.
+static bool prepared_table_bind(prepared_table_t const *table, char const **names, table_t **tables, size_t count, std::vector<table_t*> *outputs, char *error, size_t error_size)
+{
+    outputs->resize(table->column_count);
+    for (size_t j = 0; j < table->column_count; ++j)
+    {
+        std::string const &action = table->action_names[table->column_action[j]];
+        size_t k = 0;
+        while (k < count && action != names[k]) ++k;
+        if (k == count)
+        {
+            snprintf(error, error_size, "no output table for action '%s'.", action.c_str());
+            return false;
+        }
+        (*outputs)[j] = tables[k];
+    }
+    return true;
+}
+
+/*//////////////////////
+//  Shared Scans      //
+//////////////////////*/
+/// @summary A prepared table registered with a multi_query_t, with the output
+/// table of each of its rules.
+struct multi_query_table_t
+{
+    prepared_table_t const *table;    /// The prepared table, owned by the caller
+    std::vector<table_t*>   outputs;  /// The output table for each rule
+    output_groups_t         groups;   /// The rules grouped by output table
+};
+
+/// @summary Classifies one set of records against many condition tables in a
+/// single pass. The predicates tested by any registered table are evaluated
+/// once per block of records, and every table is classified from that block
+/// while it is in cache, so the records are read from memory once however
+/// many tables there are.
+struct multi_query_t
+{
+    std::vector<multi_query_table_t> tables;     /// The registered tables
+    uint32_t                         predicates; /// The union of the rows tested by the tables
+    size_t                           block_size; /// The number of records per block
+    uint32_t                        *block;      /// The bitfields of the current block
+};
+
+/// @summary Fills in a prepared table from rules built in memory rather than
+/// parsed from a file. The table is not validated.
+/// @param table The prepared table to populate.
+/// @param rules column_count * row_count rules, column-major.
+/// @param column_action The action index of each rule.
+/// @param column_count The number of rules.
+/// @param row_count The number of condition rows (bits).
+/// @param action_names The name of each action.
+/// @param action_count The number of actions.
+static void prepared_table_build(prepared_table_t *table, rule_e const *rules, uint32_t const *column_action, size_t column_count, size_t row_count, char const **action_names, size_t action_count)
+{
+    table->hash         = fnv1a64(rules, column_count * row_count * sizeof(rule_e));
+    table->row_count    = row_count;
+    table->column_count = column_count;
+    table->issue_count  = 0;
+    table->hit_policy   = HIT_POLICY_COLLECT;
+    table->action_names.assign(action_names, action_names + action_count);
+    table->column_action.assign(column_action, column_action + column_count);
+    table->rules.assign(rules, rules + column_count * row_count);
+    table->masks.resize(column_count);
+    for (size_t j = 0; j < column_count; ++j)
+    {
+        build_column_mask(&table->masks[j], &rules[j * row_count], row_count);
+    }
+}
+
+/// @summary Generates bitfields holding only a subset of the predicates, one
+/// predicate at a time over the block. Bits outside the subset are zero.
+/// @param dst The destination bitfields, of at least count elements.
+/// @param src The source record store.
+/// @param first The index of the first record in src to process.
+/// @param count The number of items to read from src and write to dst.
+/// @param predicates A bitfield with bit i set if predicate i (a bit_ids_e) is needed.
+static void generate_predicates(uint32_t *dst, record_store_t const *src, size_t first, size_t count, uint32_t predicates)
+{
+    uint32_t const all = (1U << Condition_Name_Count) - 1;
+    if ((predicates & all) == all)
+    {
+        generate_bitfields(dst, src, first, count);
+        return;
+    }
+    uint32_t const *salary   = src->annual_salary   + first;
+    uint32_t const *loan     = src->loan_amount     + first;
+    uint8_t  const *verify_a = src->verify_address  + first;
+    uint8_t  const *verify_i = src->verify_identity + first;
+    memset(dst, 0, count * sizeof(uint32_t));
+    if (predicates & (1U << PROOF_OF_ADDRESS))
+    {
+        for (size_t i = 0; i < count; ++i)
+            dst[i] |= proof_of_address_bit(bitmap_get(src->address_valid, first + i), verify_a[i]) << PROOF_OF_ADDRESS;
+    }
+    if (predicates & (1U << PROOF_OF_IDENTITY))
+    {
+        for (size_t i = 0; i < count; ++i)
+            dst[i] |= proof_of_identity_bit(bitmap_get(src->identity_valid, first + i), verify_i[i]) << PROOF_OF_IDENTITY;
+    }
+    if (predicates & ((1U << LOAN_LT_SALARY) | (1U << LOAN_GE_SALARY)))
+    {
+        uint32_t keep = predicates & ((1U << LOAN_LT_SALARY) | (1U << LOAN_GE_SALARY));
+        for (size_t i = 0; i < count; ++i)
+        {
+            uint32_t lt = (uint32_t)(loan[i] < salary[i]);
+            dst[i] |= ((lt << LOAN_LT_SALARY) | ((lt ^ 1) << LOAN_GE_SALARY)) & keep;
+        }
+    }
+    if (predicates & (1U << EXISTING_OWNER))
+    {
+        for (size_t i = 0; i < count; ++i)
+            dst[i] |= bitmap_get(src->owns_other_home, first + i) << EXISTING_OWNER;
+    }
+}
+
+/// @summary Initializes an empty multi-table executor.
+/// @param mq The executor to initialize. Free with multi_query_free().
+/// @param block_size The number of records per block, or zero to use Fused_Block_Size.
+static void multi_query_init(multi_query_t *mq, size_t block_size=0)
+{
+    mq->tables.clear();
+    mq->predicates = 0;
+    mq->block_size = block_size ? block_size : Fused_Block_Size;
+    mq->block      = (uint32_t*) malloc(mq->block_size * sizeof(uint32_t));
+}
+
+/// @summary Frees the resources held by a multi-table executor. The registered
+/// prepared tables and output tables are not freed.
+/// @param mq The executor to free.
+static void multi_query_free(multi_query_t *mq)
+{
+    for (size_t t = 0; t < mq->tables.size(); ++t)
+    {
+        output_groups_free(&mq->tables[t].groups);
+    }
+    mq->tables.clear();
+    free(mq->block);
+    mq->block = NULL;
+}
+
+/// @summary Registers a prepared table, adding the rows it tests to the set of
+/// predicates evaluated for each record.
+/// @param mq The executor.
+/// @param table The prepared table, which must outlive the executor.
+/// @param outputs The output table for each rule of the table.
+/// @return The index of the table within the executor.
+static size_t multi_query_add(multi_query_t *mq, prepared_table_t const *table, table_t **outputs)
+{
+    multi_query_table_t entry;
+    entry.table = table;
+    entry.outputs.assign(outputs, outputs + table->column_count);
+    output_groups_build(&entry.groups, &entry.outputs[0], table->column_count);
+    for (size_t j = 0; j < table->column_count; ++j)
+    {
+        uint32_t rows = table->row_count < 32 ? ((1U << table->row_count) - 1) : 0xFFFFFFFFU;
+        mq->predicates |= ~table->masks[j].bits_ignore & rows;
+    }
+    mq->tables.push_back(entry);
+    return mq->tables.size() - 1;
+}
+
+/// @summary Classifies every record of a store against every registered table
+/// in one pass. Produces, for each table, output identical to generating the
+/// full bitfield array and classifying it with that table alone.
+/// @param mq The executor.
+/// @param kernel The classify kernel used for tables with the collect hit policy.
+/// @param store The input record store. IDs are read from its id column.
+static void multi_query_run(multi_query_t *mq, classify_func_t kernel, record_store_t const *store)
+{
+    for (size_t i = 0; i < store->count; i += mq->block_size)
+    {
+        size_t n = (store->count - i) < mq->block_size ? (store->count - i) : mq->block_size;
+        generate_predicates(mq->block, store, i, n, mq->predicates);
+        for (size_t t = 0; t < mq->tables.size(); ++t)
+        {
+            multi_query_table_t    *entry = &mq->tables[t];
+            prepared_table_t const *table = entry->table;
+            if (table->hit_policy == HIT_POLICY_COLLECT)
+            {
+                for (size_t g = 0; g < entry->groups.group_count; ++g)
+                {
+                    table_t *output = entry->groups.groups[g].table;
+                    table_reserve(output, output->count + n * entry->groups.groups[g].count + 1);
+                }
+                kernel(&table->masks[0], &entry->outputs[0], table->column_count, store->id + i, mq->block, n);
+            }
+            else // actions are prioritized in declaration order.
+            {
+                classify_hit_policy(table->hit_policy, &table->masks[0], &entry->outputs[0], table->column_count, &table->column_action[0], store->id + i, mq->block, n);
+            }
+        }
+    }
+}
+
+/*//////////////////////
+//  Bitfield Index    //
+//////////////////////*/
+/// @summary The magic number at the start of a bitfield index file ('CTBLBITS').
+static const uint64_t Bitfield_Index_Magic   = 0x53544942424C5443ULL;
+
+/// @summary The current version of the bitfield index file format.
+static const uint32_t Bitfield_Index_Version = 1;
+
+/// @summary The version of the predicates evaluated by generate_bitfields().
+/// Increment this whenever a predicate changes meaning, so that persisted
+/// indexes are rebuilt rather than reused.
+static const uint32_t Predicate_Set_Version  = 1;
+
+/// @summary The default number of records per index block. Must be a multiple
+/// of 64 so blocks cover whole bitmap words.
+static const size_t Bitfield_Index_Block_Size = 16384;
+
+/// @summary Bitfields computed for a record store, persisted next to the
+/// record data. Each block of records carries a stamp, a hash of the
+/// predicate inputs of its records, which identifies the blocks that must be
+/// recomputed after the records change.
+struct bitfield_index_t
+{
+    uint64_t              predicate_hash; /// The predicate_set_hash() of the bitfields
+    size_t                record_count;   /// The number of records covered by the index
+    size_t                block_size;     /// The number of records per block
+    std::vector<uint64_t> stamps;         /// The input stamp of each block
+    std::vector<uint32_t> bits;           /// The bitfield of each record
+};
+
+/// @summary Header of a bitfield index file, followed by the block stamps and
+/// then the bitfields.
+struct bitfield_index_header_t
+{
+    uint64_t              magic;          /// Bitfield_Index_Magic
+    uint32_t              version;        /// Bitfield_Index_Version
+    uint32_t              block_size;     /// The number of records per block
+    uint64_t              predicate_hash; /// The predicate_set_hash() of the bitfields
+    uint64_t              record_count;   /// The number of bitfields in the file
+};
+
+/// @summary Initializes an empty bitfield index.
+/// @param index The bitfield index to initialize.
+static void bitfield_index_init(bitfield_index_t *index)
+{
+    index->predicate_hash = 0;
+    index->record_count   = 0;
+    index->block_size     = 0;
+    index->stamps.clear();
+    index->bits.clear();
+}
+
+/// @summary Computes a hash identifying the predicate set: the condition
+/// names, in bit order, and Predicate_Set_Version.
+/// @return The predicate set hash.
+static uint64_t predicate_set_hash(void)
+{
+    std::string key;
+    char        version[32];
+    snprintf(version, sizeof(version), "v%u", Predicate_Set_Version);
+    key = version;
+    for (size_t i = 0; i < Condition_Name_Count; ++i)
+    {
+        key += ':';
+        key += Condition_Names[i];
+    }
+    return fnv1a64(key.data(), key.size());
+}
+
+/// @summary Mixes a byte range into four independent multiply-xor lanes, so
+/// the multiplies overlap rather than forming one long dependency chain.
+/// @param lanes The four lane states.
+/// @param data The data to hash.
+/// @param size The number of bytes to hash.
+static inline void stamp_bytes(uint64_t *lanes, void const *data, size_t size)
+{
+    uint8_t const *p = (uint8_t const*) data;
+    size_t         i = 0;
+    for ( ; i + 32 <= size; i += 32)
+    {
+        uint64_t w[4];
+        memcpy(w, p + i, sizeof(w));
+        for (size_t k = 0; k < 4; ++k)
+        {
+            lanes[k] = (lanes[k] ^ w[k]) * 0x9E3779B97F4A7C15ULL;
+        }
+    }
+    for ( ; i < size; ++i)
+    {
+        lanes[i & 3] = (lanes[i & 3] ^ p[i]) * 0x100000001B3ULL;
+    }
+}
+
+/// @summary Computes the stamp of a block of records from the columns read by
+/// generate_bitfields(). The ID column is not included.
+/// @param store The record store.
+/// @param first The index of the first record in the block, a multiple of 64.
+/// @param count The number of records in the block.
+/// @return The block stamp.
+static uint64_t record_block_stamp(record_store_t const *store, size_t first, size_t count)
+{
+    uint64_t lanes[4] = { 1, 2, 3, 4 };
+    size_t   words    = (count + 63) / 64;
+    stamp_bytes(lanes, store->annual_salary   + first, count * sizeof(uint32_t));
+    stamp_bytes(lanes, store->loan_amount     + first, count * sizeof(uint32_t));
+    stamp_bytes(lanes, store->verify_address  + first, count * sizeof(uint8_t));
+    stamp_bytes(lanes, store->verify_identity + first, count * sizeof(uint8_t));
+    if (count & 63)
+    {
+        // ignore bitmap bits past the end of the store.
+        uint64_t tail = (1ULL << (count & 63)) - 1;
+        uint64_t last[3] =
+        {
+            store->owns_other_home[(first / 64) + words - 1] & tail,
+            store->address_valid  [(first / 64) + words - 1] & tail,
+            store->identity_valid [(first / 64) + words - 1] & tail
+        };
+        words--;
+        stamp_bytes(lanes, last, sizeof(last));
+    }
+    stamp_bytes(lanes, store->owns_other_home + first / 64, words * sizeof(uint64_t));
+    stamp_bytes(lanes, store->address_valid   + first / 64, words * sizeof(uint64_t));
+    stamp_bytes(lanes, store->identity_valid  + first / 64, words * sizeof(uint64_t));
+    return mix64(lanes[0] ^ mix64(lanes[1] ^ mix64(lanes[2] ^ mix64(lanes[3] ^ count))));
+}
+
+/// @summary Recomputes the bitfields and stamp of a single block.
+/// @param index The bitfield index.
+/// @param store The record store.
+/// @param block The zero-based block index.
+static void bitfield_index_compute_block(bitfield_index_t *index, record_store_t const *store, size_t block)
+{
+    size_t first = block * index->block_size;
+    size_t count = (first + index->block_size <= index->record_count) ? index->block_size : index->record_count - first;
+    generate_bitfields(&index->bits[first], store, first, count);
+    index->stamps[block] = record_block_stamp(store, first, count);
+}
+
+/// @summary Resizes an index to cover a record store and recomputes every
+/// block whose stamp no longer matches its records. Blocks added by growth,
+/// and the final block if its length changed, are always recomputed.
+/// @param index The bitfield index. If its predicate hash or block size is
+/// out of date, it is rebuilt from scratch.
+/// @param store The record store.
+/// @param block_size The number of records per block; zero uses Bitfield_Index_Block_Size.
+/// @return The number of blocks recomputed.
+static size_t bitfield_index_refresh(bitfield_index_t *index, record_store_t const *store, size_t block_size)
+{
+    if (block_size == 0) block_size = Bitfield_Index_Block_Size;
+    block_size = (block_size + 63) & ~size_t(63);
+
+    uint64_t predicate_hash = predicate_set_hash();
+    size_t   valid_blocks   = index->stamps.size();
+    if (index->predicate_hash != predicate_hash || index->block_size != block_size)
+    {
+        valid_blocks = 0;
+    }
+
+    size_t block_count    = (store->count + block_size - 1) / block_size;
+    index->predicate_hash = predicate_hash;
+    index->block_size     = block_size;
+    index->record_count   = store->count;
+    index->stamps.resize(block_count);
+    index->bits.resize(store->count);
+
+    size_t recomputed = 0;
+    for (size_t b = 0; b < block_count; ++b)
+    {
+        size_t first = b * block_size;
+        size_t count = (first + block_size <= store->count) ? block_size : store->count - first;
+        if (b >= valid_blocks || index->stamps[b] != record_block_stamp(store, first, count))
+        {
+            bitfield_index_compute_block(index, store, b);
+            recomputed++;
+        }
+    }
+    return recomputed;
+}
+
+/// @summary Updates an index after a known range of records was modified in
+/// place. Only the blocks overlapping the range are touched; nothing else is
+/// read.
+/// @param index The bitfield index, covering every record in the store.
+/// @param store The record store.
+/// @param first The index of the first modified record.
+/// @param count The number of modified records.
+/// @return The number of blocks recomputed.
+static size_t bitfield_index_update(bitfield_index_t *index, record_store_t const *store, size_t first, size_t count)
+{
+    if (count == 0)
+        return 0;
+
+    size_t first_block = first / index->block_size;
+    size_t last_block  = (first + count - 1) / index->block_size;
+    for (size_t b = first_block; b <= last_block; ++b)
+    {
+        bitfield_index_compute_block(index, store, b);
+    }
+    return last_block - first_block + 1;
+}
+
+/// @summary Writes a bitfield index to a file.
+/// @param path The path of the file to write.
+/// @param index The bitfield index.
+/// @return true if the file was written.
+static bool bitfield_index_write(char const *path, bitfield_index_t const *index)
+{
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL)
+        return false;
+
+    bitfield_index_header_t header;
+    header.magic          = Bitfield_Index_Magic;
+    header.version        = Bitfield_Index_Version;
+    header.block_size     = (uint32_t) index->block_size;
+    header.predicate_hash = index->predicate_hash;
+    header.record_count   = index->record_count;
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+    ok = ok && fwrite(index->stamps.data(), sizeof(uint64_t), index->stamps.size(), fp) == index->stamps.size();
+    ok = ok && fwrite(index->bits.data()  , sizeof(uint32_t), index->bits.size()  , fp) == index->bits.size();
+    ok = (fclose(fp) == 0) && ok;
+    return ok;
+}
+
+/// @summary Returns the size of an open file.
+/// @param fp The file.
+/// @return The size of the file in bytes, or zero if it cannot be determined.
+static uint64_t file_size(FILE *fp)
+{
+#if defined(_WIN32)
+    __int64 size = _filelengthi64(_fileno(fp));
+    return size > 0 ? (uint64_t) size : 0;
+#else
+    struct stat st;
+    return fstat(fileno(fp), &st) == 0 ? (uint64_t) st.st_size : 0;
+#endif
+}
+
+/// @summary Reads a bitfield index from a file. An index written for a
+/// different predicate set is read, but will be rebuilt by refresh. The
+/// header's record count is checked against the file size before anything
+/// is allocated from it.
+/// @param path The path of the file to read.
+/// @param index The bitfield index to populate.
+/// @return true if the file was read.
+static bool bitfield_index_read(char const *path, bitfield_index_t *index)
+{
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL)
+        return false;
+
+    bitfield_index_header_t header;
+    uint64_t size = file_size(fp);
+    bool ok = fread(&header, sizeof(header), 1, fp) == 1 &&
+              header.magic   == Bitfield_Index_Magic     &&
+              header.version == Bitfield_Index_Version   &&
+              header.block_size > 0 && (header.block_size % 64) == 0 &&
+              header.record_count <= size / sizeof(uint32_t);
+    if (ok)
+    {
+        uint64_t blocks = (header.record_count + header.block_size - 1) / header.block_size;
+        ok = sizeof(header) + blocks * sizeof(uint64_t) + header.record_count * sizeof(uint32_t) == size;
+    }
+    if (ok)
+    {
+        size_t block_count   = (size_t)((header.record_count + header.block_size - 1) / header.block_size);
+        index->predicate_hash = header.predicate_hash;
+        index->record_count   = (size_t) header.record_count;
+        index->block_size     = header.block_size;
+        index->stamps.resize(block_count);
+        index->bits.resize(index->record_count);
+        ok = fread(index->stamps.data(), sizeof(uint64_t), block_count, fp) == block_count &&
+             fread(index->bits.data()  , sizeof(uint32_t), index->record_count, fp) == index->record_count;
+    }
+    fclose(fp);
+    if (!ok)
+    {
+        bitfield_index_init(index);
+    }
+    return ok;
+}
+
+/// @summary Loads the bitfield index stored next to a record set, refreshes
+/// any blocks whose records have changed, and writes it back if anything
+/// was recomputed.
+/// @param path The path of the index file.
+/// @param store The record store the index describes.
+/// @param index The bitfield index to populate.
+/// @param recomputed On return, the number of blocks recomputed.
+/// @return true if the index is up to date on disk.
+static bool bitfield_index_load(char const *path, record_store_t const *store, bitfield_index_t *index, size_t *recomputed)
+{
+    bitfield_index_init(index);
+    bitfield_index_read(path, index);
+    *recomputed = bitfield_index_refresh(index, store, index->block_size);
+    if (*recomputed == 0)
+        return true;
+    return bitfield_index_write(path, index);
+}
+
+/*/////////////////
+//  Entry Point  //
+/////////////////*/
+#define NANOS_PER_USEC    1000ULL
+#define NANOS_PER_MSEC    1000ULL * NANOS_PER_USEC
+#define NANOS_PER_SECOND  1000ULL * NANOS_PER_MSEC
+
+/// @summary Record the start and end of a timed interval in both timestamp
+/// ticks and CPU timestamp counter cycles.
+struct bench_timer_t
+{
+    uint64_t start;       /// The starting time, in timestamp ticks
+    uint64_t end;         /// The ending time, in timestamp ticks
+    uint64_t start_cycles;/// The starting value of the CPU timestamp counter
+    uint64_t end_cycles;  /// The ending value of the CPU timestamp counter
+};
+
+static uint64_t
+timestamp_in_ticks
+(
+    void
+)
+{
+#if defined(_WIN32)
+    LARGE_INTEGER ticks;
+    QueryPerformanceCounter(&ticks);
+    return (uint64_t) ticks.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * NANOS_PER_SECOND + (uint64_t) ts.tv_nsec;
+#endif
+}
+
+static uint64_t
+timestamp_counts_per_second
+(
+    void
+)
+{
+#if defined(_WIN32)
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    return (uint64_t) frequency.QuadPart;
+#else
+    return NANOS_PER_SECOND;
+#endif
+}
+
+static uint64_t
+timestamp_delta_nanoseconds
+(
+    uint64_t ts_enter, 
+    uint64_t ts_leave
+)
+{
+    /* scale the tick value by the nanoseconds-per-second multiplier 
+     * before scaling back down by ticks-per-second to avoid loss of precision.
+     */
+    return (1000000000ULL * (ts_leave - ts_enter)) / timestamp_counts_per_second();
+}
+
+/// @summary Reads the CPU timestamp counter. The counter runs at a constant
+/// rate on current x86 processors, which is not necessarily the core clock.
+/// @return The current value of the timestamp counter.
+static inline uint64_t timestamp_in_cycles(void)
+{
+    return (uint64_t) __rdtsc();
+}
+
+static inline void timer_start(bench_timer_t *time)
+{
+    time->start        = timestamp_in_ticks();
+    time->start_cycles = timestamp_in_cycles();
+    time->end          = 0;
+    time->end_cycles   = 0;
+}
+
+static inline void timer_stop(bench_timer_t *time)
+{
+    time->end_cycles   = timestamp_in_cycles();
+    time->end          = timestamp_in_ticks();
+}
+
+static inline uint64_t duration(bench_timer_t const *time)
+{
+    return timestamp_delta_nanoseconds(time->start, time->end);
+}
+
+static inline float duration_sec(bench_timer_t const *time)
+{
+    return float(timestamp_delta_nanoseconds(time->start, time->end)) / float(NANOS_PER_SECOND);
+}
+
+static inline uint64_t duration_cycles(bench_timer_t const *time)
+{
+    return time->end_cycles - time->start_cycles;
+}
+
+/*////////////////////////
+//  Benchmark Harness   //
+////////////////////////*/
+/// @summary Define the hardware events that can be counted around each kernel.
+enum perf_counter_e
+{
+    PERF_COUNTER_INSTRUCTIONS          = 0, // retired instructions
+    PERF_COUNTER_BRANCH_MISSES         = 1, // mispredicted branches
+    PERF_COUNTER_LLC_MISSES            = 2, // last-level cache misses
+    PERF_COUNTER_DTLB_MISSES           = 3, // data TLB misses on loads
+    PERF_COUNTER_COUNT                 = 4
+};
+
+/// @summary A lookup table of strings for pretty-printing perf_counter_e values.
+static char const *Perf_Counter_Names[PERF_COUNTER_COUNT] =
+{
+    "instructions",
+    "branch_misses",
+    "llc_misses",
+    "dtlb_misses"
+};
+
+/// @summary The hardware counters opened for the calling process. Counters
+/// are inherited by threads created after they are opened, so they also
+/// cover the parallel kernels.
+struct perf_counters_t
+{
+    int      fd[PERF_COUNTER_COUNT];   /// The perf event descriptors, or -1
+    bool     available;                /// true if every counter opened
+};
+
+/// @summary Opens the hardware counters with perf_event_open. Counting is
+/// Linux-only; elsewhere, or when the kernel refuses (see
+/// /proc/sys/kernel/perf_event_paranoid), the counters are unavailable.
+/// @param counters The counter set to initialize.
+/// @return true if all of the counters could be opened.
+static bool perf_counters_open(perf_counters_t *counters)
+{
+    counters->available = false;
+    for (size_t i = 0; i < PERF_COUNTER_COUNT; ++i)
+    {
+        counters->fd[i] = -1;
+    }
+#if defined(__linux__)
+    uint32_t const types[PERF_COUNTER_COUNT] =
+    {
+        PERF_TYPE_HARDWARE,
+        PERF_TYPE_HARDWARE,
+        PERF_TYPE_HARDWARE,
+        PERF_TYPE_HW_CACHE
+    };
+    uint64_t const configs[PERF_COUNTER_COUNT] =
+    {
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_BRANCH_MISSES,
+        PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)
+    };
+    for (size_t i = 0; i < PERF_COUNTER_COUNT; ++i)
+    {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.type           = types[i];
+        attr.size           = sizeof(attr);
+        attr.config         = configs[i];
+        attr.disabled       = 1;
+        attr.inherit        = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv     = 1;
+        counters->fd[i]     = (int) syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+        if (counters->fd[i] < 0)
+        {
+            for (size_t j = 0; j < i; ++j)
+            {
+                close(counters->fd[j]);
+                counters->fd[j] = -1;
+            }
+            counters->fd[i] = -1;
+            return false;
+        }
+    }
+    counters->available = true;
+#endif
+    return counters->available;
+}
+
+/// @summary Closes any counters opened by perf_counters_open.
+/// @param counters The counter set to close.
+static void perf_counters_close(perf_counters_t *counters)
+{
+#if defined(__linux__)
+    for (size_t i = 0; i < PERF_COUNTER_COUNT; ++i)
+    {
+        if (counters->fd[i] >= 0) close(counters->fd[i]);
+        counters->fd[i] = -1;
+    }
+#endif
+    counters->available = false;
+}
+
+/// @summary Resets and starts the counters.
+/// @param counters The counter set to start.
+static void perf_counters_start(perf_counters_t *counters)
+{
+#if defined(__linux__)
+    for (size_t i = 0; i < PERF_COUNTER_COUNT && counters->available; ++i)
+    {
+        ioctl(counters->fd[i], PERF_EVENT_IOC_RESET , 0);
+        ioctl(counters->fd[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+#else
+    UNUSED(counters);
+#endif
+}
+
+/// @summary Stops the counters and adds their values to a running total.
+/// @param counters The counter set to stop.
+/// @param totals PERF_COUNTER_COUNT values to accumulate into.
+static void perf_counters_stop(perf_counters_t *counters, uint64_t *totals)
+{
+#if defined(__linux__)
+    for (size_t i = 0; i < PERF_COUNTER_COUNT && counters->available; ++i)
+    {
+        uint64_t value = 0;
+        ioctl(counters->fd[i], PERF_EVENT_IOC_DISABLE, 0);
+        if (read(counters->fd[i], &value, sizeof(value)) == (ssize_t) sizeof(value))
+        {
+            totals[i] += value;
+        }
+    }
+#else
+    UNUSED(counters);
+    UNUSED(totals);
+#endif
+}
+
+/// @summary Settings for a benchmark session, taken from the command line.
+struct bench_config_t
+{
+    size_t                   iterations;  /// The number of timed passes per kernel
+    size_t                   warmups;     /// The number of untimed passes before timing
+    std::vector<std::string> kernels;     /// The kernel selectors; empty to run everything
+    perf_counters_t          counters;    /// Hardware counters, if requested and available
+    bool                     use_counters;/// true if hardware counters were requested
+};
+
+/// @summary The measurements taken for a single kernel.
+struct bench_result_t
+{
+    std::string              name;        /// The kernel name, as group/variant
+    size_t                   records;     /// The number of records processed per pass
+    uint64_t                 bytes;       /// The estimated number of bytes moved per pass
+    std::vector<uint64_t>    samples;     /// The duration of each timed pass, in nanoseconds
+    std::vector<uint64_t>    cycles;      /// The timestamp counter cycles for each timed pass
+    uint64_t                 counters[PERF_COUNTER_COUNT]; /// Counter totals over all timed passes
+    bool                     has_counters;/// true if counters contains valid data
+};
+
+/// @summary Summary statistics derived from the samples of a bench_result_t.
+struct bench_stats_t
+{
+    uint64_t                 min_ns;      /// The fastest pass
+    uint64_t                 median_ns;   /// The median pass
+    uint64_t                 p99_ns;      /// The 99th percentile pass
+    uint64_t                 median_cycles;/// The median timestamp counter cycles per pass
+    double                   records_per_sec; /// Throughput at the median pass
+    double                   bytes_per_sec;   /// Bandwidth at the median pass
+};
+
+/// @summary Determines whether a kernel was selected on the command line.
+/// A selector matches a kernel with the same name, or every kernel in the
+/// group it names, so 'simd' selects 'simd/avx2' and 'simd/sse4.2'.
+/// @param config The benchmark settings.
+/// @param name The kernel name, as group/variant.
+/// @return true if the kernel should run.
+static bool bench_selected(bench_config_t const *config, char const *name)
+{
+    if (config->kernels.empty())
+        return true;
+
+    size_t name_len = strlen(name);
+    for (size_t i = 0; i < config->kernels.size(); ++i)
+    {
+        std::string const &sel = config->kernels[i];
+        if (sel == "all" || sel == name)
+            return true;
+        if (sel.size() < name_len && strncmp(name, sel.c_str(), sel.size()) == 0 && name[sel.size()] == '/')
+            return true;
+    }
+    return false;
+}
+
+/// @summary Computes summary statistics for a set of samples.
+/// @param result The measurements for a kernel.
+/// @param stats The statistics to fill out.
+static void bench_compute_stats(bench_result_t const *result, bench_stats_t *stats)
+{
+    std::vector<uint64_t> ns(result->samples);
+    std::vector<uint64_t> cy(result->cycles);
+    memset(stats, 0, sizeof(bench_stats_t));
+    if (ns.empty())
+        return;
+
+    std::sort(ns.begin(), ns.end());
+    std::sort(cy.begin(), cy.end());
+    size_t p99           = (ns.size() * 99 + 99) / 100; // nearest rank
+    stats->min_ns        = ns[0];
+    stats->median_ns     = ns[ns.size() / 2];
+    stats->p99_ns        = ns[p99 - 1];
+    stats->median_cycles = cy[cy.size() / 2];
+    if (stats->median_ns > 0)
+    {
+        double seconds         = double(stats->median_ns) / double(NANOS_PER_SECOND);
+        stats->records_per_sec = double(result->records) / seconds;
+        stats->bytes_per_sec   = double(result->bytes  ) / seconds;
+    }
+}
+
+/// @summary Runs a kernel for the configured number of warmup and timed
+/// passes. The body is invoked once per pass, with reset called beforehand
+/// outside of the timed region.
+/// @param config The benchmark settings.
+/// @param results The list of results to append to.
+/// @param name The kernel name, as group/variant.
+/// @param records The number of records processed by each pass.
+/// @param input_bytes The number of bytes read by each pass.
+/// @param reset A callable that returns the outputs to their initial state.
+/// @param body A callable that performs one pass.
+/// @return The result appended to results, or NULL if the kernel was not selected.
+template <typename reset_func_t, typename body_func_t>
+static bench_result_t* bench_run(bench_config_t *config, std::vector<bench_result_t> *results, char const *name, size_t records, uint64_t input_bytes, reset_func_t reset, body_func_t body)
+{
+    if (!bench_selected(config, name))
+        return NULL;
+
+    bench_result_t result;
+    result.name         = name;
+    result.records      = records;
+    result.bytes        = input_bytes;
+    result.has_counters = config->counters.available;
+    memset(result.counters, 0, sizeof(result.counters));
+    for (size_t iter = 0; iter < config->warmups; ++iter)
+    {
+        reset();
+        body();
+    }
+    for (size_t iter = 0; iter < config->iterations; ++iter)
+    {
+        bench_timer_t time;
+        reset();
+        perf_counters_start(&config->counters);
+        timer_start(&time);
+        body();
+        timer_stop(&time);
+        perf_counters_stop(&config->counters, result.counters);
+        result.samples.push_back(duration(&time));
+        result.cycles.push_back(duration_cycles(&time));
+    }
+    results->push_back(result);
+    return &results->back();
+}
+
+/// @summary Prints a table of statistics for each benchmarked kernel.
+/// @param results The benchmark results.
+static void bench_print(std::vector<bench_result_t> const &results)
+{
+    printf("%-28s %12s %12s %12s %9s %10s %10s", "kernel", "min ms", "median ms", "p99 ms", "cyc/rec", "Mrec/s", "MB/s");
+    if (!results.empty() && results[0].has_counters)
+        printf(" %10s %10s %10s %10s", "instr/rec", "brmiss/rec", "llcmiss/rec", "tlbmiss/rec");
+    printf("\n");
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        bench_result_t const &r = results[i];
+        bench_stats_t         s;
+        bench_compute_stats(&r, &s);
+        printf("%-28s %12.3f %12.3f %12.3f %9.2f %10.1f %10.1f", r.name.c_str(),
+            double(s.min_ns) / 1.0e6, double(s.median_ns) / 1.0e6, double(s.p99_ns) / 1.0e6,
+            double(s.median_cycles) / double(r.records), s.records_per_sec / 1.0e6, s.bytes_per_sec / (1024.0 * 1024.0));
+        if (r.has_counters)
+        {
+            double passes = double(r.samples.size()) * double(r.records);
+            for (size_t c = 0; c < PERF_COUNTER_COUNT; ++c)
+            {
+                printf(" %10.3f", double(r.counters[c]) / passes);
+            }
+        }
+        printf("\n");
+    }
+}
+
+/// @summary Writes the benchmark results as JSON, for regression tracking.
+/// @param path The path of the file to write.
+/// @param config The benchmark settings.
+/// @param results The benchmark results.
+/// @param record_count The number of generated records.
+/// @param gen The parameters used to generate the records.
+/// @param simd_level The name of the best SIMD level supported by the host.
+/// @return true if the file was written.
+static bool bench_write_json(char const *path, bench_config_t const *config, std::vector<bench_result_t> const &results, size_t record_count, generator_params_t const *gen, char const *simd_level)
+{
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL)
+        return false;
+
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"record_count\": %" PRIu64 ",\n", (uint64_t) record_count);
+    fprintf(fp, "  \"generator\": { \"seed\": %" PRIu64 ", \"null_address\": %g, \"null_identity\": %g, \"home_owner\": %g, "
+                "\"salary\": \"%s:%u:%u\", \"loan\": \"%s:%u:%u\", \"cluster_size\": %u, \"sorted_salary\": %s },\n",
+                gen->seed, gen->null_address, gen->null_identity, gen->home_owner,
+                Distribution_Names[gen->salary_distribution], gen->salary_min, gen->salary_max,
+                Distribution_Names[gen->loan_distribution], gen->loan_min, gen->loan_max,
+                (uint32_t) gen->cluster_size, gen->sorted_salary ? "true" : "false");
+    fprintf(fp, "  \"iterations\": %" PRIu64 ",\n"  , (uint64_t) config->iterations);
+    fprintf(fp, "  \"warmups\": %" PRIu64 ",\n"     , (uint64_t) config->warmups);
+    fprintf(fp, "  \"simd_level\": \"%s\",\n"       , simd_level);
+    fprintf(fp, "  \"hardware_threads\": %u,\n"     , (uint32_t) std::thread::hardware_concurrency());
+    fprintf(fp, "  \"results\": [\n");
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        bench_result_t const &r = results[i];
+        bench_stats_t         s;
+        bench_compute_stats(&r, &s);
+        fprintf(fp, "    {\n");
+        fprintf(fp, "      \"name\": \"%s\",\n", r.name.c_str());
+        fprintf(fp, "      \"records\": %" PRIu64 ",\n", (uint64_t) r.records);
+        fprintf(fp, "      \"bytes\": %" PRIu64 ",\n", r.bytes);
+        fprintf(fp, "      \"min_ns\": %" PRIu64 ",\n", s.min_ns);
+        fprintf(fp, "      \"median_ns\": %" PRIu64 ",\n", s.median_ns);
+        fprintf(fp, "      \"p99_ns\": %" PRIu64 ",\n", s.p99_ns);
+        fprintf(fp, "      \"median_cycles\": %" PRIu64 ",\n", s.median_cycles);
+        fprintf(fp, "      \"records_per_sec\": %.1f,\n", s.records_per_sec);
+        fprintf(fp, "      \"bytes_per_sec\": %.1f,\n", s.bytes_per_sec);
+        fprintf(fp, "      \"samples_ns\": [");
+        for (size_t j = 0; j < r.samples.size(); ++j)
+        {
+            fprintf(fp, "%s%" PRIu64, j ? ", " : "", r.samples[j]);
+        }
+        fprintf(fp, "],\n");
+        if (r.has_counters)
+        {
+            fprintf(fp, "      \"counters\": {");
+            for (size_t c = 0; c < PERF_COUNTER_COUNT; ++c)
+            {
+                fprintf(fp, "%s\"%s\": %" PRIu64, c ? ", " : " ", Perf_Counter_Names[c], r.counters[c]);
+            }
+            fprintf(fp, " }\n");
+        }
+        else
+        {
+            fprintf(fp, "      \"counters\": null\n");
+        }
+        fprintf(fp, "    }%s\n", (i + 1 < results.size()) ? "," : "");
+    }
+    fprintf(fp, "  ]\n");
+    fprintf(fp, "}\n");
+    return fclose(fp) == 0;
+}
+
+/*//////////////////////
+//  Streaming Ingest  //
+//////////////////////*/
+/// @summary The number of slots in each stream ring, a power of two.
+static const size_t Stream_Ring_Size    = 65536;
+
+/// @summary The largest micro-batch a stream worker classifies at once.
+static const size_t Stream_Max_Batch    = 4096;
+
+/// @summary The number of latency histogram buckets per power of two, which
+/// bounds the relative error of a reported percentile to 1/16.
+static const size_t Latency_Sub_Buckets = 16;
+
+/// @summary The number of latency histogram buckets, enough for any 64-bit
+/// nanosecond value.
+static const size_t Latency_Bucket_Count = 61 * Latency_Sub_Buckets;
+
+/// @summary A bounded lock-free queue (Vyukov's sequenced ring). Any number
+/// of threads may push and pop, so one type serves the multiple-producer
+/// input ring and the per-action output rings; each slot's sequence number
+/// says whether it is ready to be written or read.
+template <typename T>
+struct stream_ring_t
+{
+    struct slot_t
+    {
+        std::atomic<size_t>  sequence; /// Position the slot is ready for: pos to push, pos + 1 to pop
+        T                    item;     /// The queued item
+    };
+    slot_t                  *slots;    /// The ring of capacity slots
+    size_t                   mask;     /// capacity - 1
+    uint8_t                  pad0[64]; /// Keeps head off the line holding slots and mask
+    std::atomic<size_t>      head;     /// The next position to push
+    uint8_t                  pad1[64]; /// Keeps producers and consumers on separate lines
+    std::atomic<size_t>      tail;     /// The next position to pop
+};
+
+/// @summary Initializes an empty ring.
+/// @param ring The ring to initialize. Free with stream_ring_free().
+/// @param capacity The number of slots, a power of two.
+template <typename T>
+static void stream_ring_init(stream_ring_t<T> *ring, size_t capacity)
+{
+    ring->slots = new typename stream_ring_t<T>::slot_t[capacity];
+    ring->mask  = capacity - 1;
+    for (size_t i = 0; i < capacity; ++i)
+    {
+        ring->slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    ring->head.store(0, std::memory_order_relaxed);
+    ring->tail.store(0, std::memory_order_relaxed);
+}
+
+/// @summary Frees the slots of a ring.
+/// @param ring The ring to free.
+template <typename T>
+static void stream_ring_free(stream_ring_t<T> *ring)
+{
+    delete[] ring->slots;
+    ring->slots = NULL;
+}
+
+/// @summary Attempts to push an item onto a ring.
+/// @param ring The ring.
+/// @param item The item to push.
+/// @return true if the item was pushed, or false if the ring is full.
+template <typename T>
+static bool stream_ring_push(stream_ring_t<T> *ring, T const &item)
+{
+    size_t pos = ring->head.load(std::memory_order_relaxed);
+    for ( ; ; )
+    {
+        typename stream_ring_t<T>::slot_t *slot = &ring->slots[pos & ring->mask];
+        size_t   seq  = slot->sequence.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t) seq - (intptr_t) pos;
+        if (diff == 0)
+        {
+            if (ring->head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+            {
+                slot->item = item;
+                slot->sequence.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+        }
+        else if (diff < 0)
+        {
+            return false;
+        }
+        else
+        {
+            pos = ring->head.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+/// @summary Attempts to pop an item from a ring.
+/// @param ring The ring.
+/// @param item On return, the popped item.
+/// @return true if an item was popped, or false if the ring is empty.
+template <typename T>
+static bool stream_ring_pop(stream_ring_t<T> *ring, T *item)
+{
+    size_t pos = ring->tail.load(std::memory_order_relaxed);
+    for ( ; ; )
+    {
+        typename stream_ring_t<T>::slot_t *slot = &ring->slots[pos & ring->mask];
+        size_t   seq  = slot->sequence.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t) seq - (intptr_t)(pos + 1);
+        if (diff == 0)
+        {
+            if (ring->tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+            {
+                *item = slot->item;
+                slot->sequence.store(pos + ring->mask + 1, std::memory_order_release);
+                return true;
+            }
+        }
+        else if (diff < 0)
+        {
+            return false;
+        }
+        else
+        {
+            pos = ring->tail.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+/// @summary Backs off inside a spin loop. The first iterations only pause;
+/// later ones give up the CPU so oversubscribed hosts still make progress.
+/// @param spins The number of times the caller has spun so far; updated.
+static inline void stream_backoff(uint32_t *spins)
+{
+    if (++(*spins) < 64) _mm_pause();
+    else std::this_thread::yield();
+}
+
+/// @summary A log-linear histogram of latencies in nanoseconds.
+struct latency_histogram_t
+{
+    uint64_t counts[Latency_Bucket_Count]; /// The number of samples in each bucket
+    uint64_t total;                        /// The number of samples
+    uint64_t max_ns;                       /// The largest sample
+};
+
+/// @summary Finds the histogram bucket for a latency. Values below
+/// Latency_Sub_Buckets have a bucket each; above that, each power of two is
+/// split into Latency_Sub_Buckets equal buckets.
+/// @param ns The latency, in nanoseconds.
+/// @return The zero-based bucket index.
+static inline size_t latency_bucket(uint64_t ns)
+{
+    if (ns < Latency_Sub_Buckets)
+    {
+        return (size_t) ns;
+    }
+#if defined(_MSC_VER)
+    unsigned long top;
+    _BitScanReverse64(&top, ns);
+#else
+    uint32_t top = 63 - (uint32_t) __builtin_clzll(ns);
+#endif
+    return (size_t)(top - 3) * Latency_Sub_Buckets + (size_t)((ns >> (top - 4)) & (Latency_Sub_Buckets - 1));
+}
+
+/// @summary Returns the smallest latency that falls in a histogram bucket.
+/// @param bucket The zero-based bucket index.
+/// @return The lower bound of the bucket, in nanoseconds.
+static inline uint64_t latency_bucket_value(size_t bucket)
+{
+    if (bucket < Latency_Sub_Buckets)
+    {
+        return (uint64_t) bucket;
+    }
+    size_t top = bucket / Latency_Sub_Buckets + 3;
+    return (uint64_t)(Latency_Sub_Buckets + bucket % Latency_Sub_Buckets) << (top - 4);
+}
+
+/// @summary Resets a latency histogram to empty.
+/// @param hist The histogram to clear.
+static void latency_histogram_clear(latency_histogram_t *hist)
+{
+    memset(hist, 0, sizeof(latency_histogram_t));
+}
+
+/// @summary Adds a sample to a latency histogram.
+/// @param hist The histogram to update.
+/// @param ns The latency, in nanoseconds.
+static inline void latency_histogram_add(latency_histogram_t *hist, uint64_t ns)
+{
+    hist->counts[latency_bucket(ns)]++;
+    hist->total++;
+    hist->max_ns = ns > hist->max_ns ? ns : hist->max_ns;
+}
+
+/// @summary Adds every sample of one latency histogram to another.
+/// @param dst The histogram to update.
+/// @param src The histogram to add.
+static void latency_histogram_merge(latency_histogram_t *dst, latency_histogram_t const *src)
+{
+    for (size_t i = 0; i < Latency_Bucket_Count; ++i)
+    {
+        dst->counts[i] += src->counts[i];
+    }
+    dst->total += src->total;
+    dst->max_ns = src->max_ns > dst->max_ns ? src->max_ns : dst->max_ns;
+}
+
+/// @summary Finds a percentile of a latency histogram.
+/// @param hist The histogram.
+/// @param q The quantile, in [0, 1].
+/// @return The lower bound of the bucket holding the quantile, in nanoseconds.
+static uint64_t latency_histogram_percentile(latency_histogram_t const *hist, double q)
+{
+    uint64_t rank = (uint64_t)(q * double(hist->total));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < Latency_Bucket_Count; ++i)
+    {
+        seen += hist->counts[i];
+        if (seen > rank)
+        {
+            return latency_bucket_value(i);
+        }
+    }
+    return hist->max_ns;
+}
+
+/// @summary An application waiting in the input ring.
+struct stream_item_t
+{
+    record_t     record;   /// The application
+    uint64_t     enqueued; /// When the application was pushed, in timestamp ticks
+};
+
+/// @summary A decision published to an action's output ring.
+struct stream_decision_t
+{
+    id_t         id;       /// The ID of the application
+    uint64_t     enqueued; /// When the application was pushed, in timestamp ticks
+};
+
+/// @summary Settings for a streaming run.
+struct stream_config_t
+{
+    size_t       batch_size;  /// The largest micro-batch a worker classifies, at most Stream_Max_Batch
+    uint64_t     flush_ns;    /// How long a worker waits to fill a partial batch after its first record
+    size_t       producers;   /// The number of threads pushing applications
+    size_t       workers;     /// The number of threads classifying micro-batches
+    uint64_t     rate;        /// The total arrival rate in records per second, or zero for as fast as possible
+};
+
+/// @summary The shared state of a streaming run: the input ring, one output
+/// ring per action (output group), and the latency of every decision.
+struct stream_t
+{
+    stream_config_t                   config;       /// The run settings
+    query_mask_t const               *masks;        /// The masks generated from each column of the condition table
+    size_t                            column_count; /// The number of columns in the condition table
+    classify_func_t                   kernel;       /// The mask classify kernel
+    output_groups_t                   groups;       /// The columns of the condition table grouped by action
+    stream_ring_t<stream_item_t>      input;        /// Applications waiting to be classified
+    stream_ring_t<stream_decision_t> *actions;      /// One ring of decisions per output group
+    std::atomic<bool>                 closed;       /// Set once every producer has finished
+    std::atomic<size_t>               active;       /// The number of workers still running
+    latency_histogram_t               latency;      /// Push-to-publish latency of every record
+};
+
+/// @summary Initializes a stream. The output tables define the actions; the
+/// drained decisions are appended to them by stream_run().
+/// @param stream The stream to initialize. Free with stream_free().
+/// @param config The run settings.
+/// @param kernel The mask classify kernel.
+/// @param masks The masks generated from each column in the condition table.
+/// @param outputs An array of output tables, one for each column.
+/// @param column_count The number of columns in the condition table.
+static void stream_init(stream_t *stream, stream_config_t const *config, classify_func_t kernel, query_mask_t const *masks, table_t **outputs, size_t column_count)
+{
+    stream_config_t c = *config;
+    c.batch_size = std::max<size_t>(1, std::min(c.batch_size, Stream_Max_Batch));
+    c.producers  = std::max<size_t>(1, c.producers);
+    c.workers    = std::max<size_t>(1, c.workers);
+    stream->config       = c;
+    stream->masks        = masks;
+    stream->column_count = column_count;
+    stream->kernel       = kernel;
+    output_groups_build(&stream->groups, outputs, column_count);
+    stream_ring_init(&stream->input, Stream_Ring_Size);
+    stream->actions = new stream_ring_t<stream_decision_t>[stream->groups.group_count];
+    for (size_t g = 0; g < stream->groups.group_count; ++g)
+    {
+        stream_ring_init(&stream->actions[g], Stream_Ring_Size);
+    }
+    latency_histogram_clear(&stream->latency);
+}
+
+/// @summary Frees the rings of a stream.
+/// @param stream The stream to free.
+static void stream_free(stream_t *stream)
+{
+    for (size_t g = 0; g < stream->groups.group_count; ++g)
+    {
+        stream_ring_free(&stream->actions[g]);
+    }
+    delete[] stream->actions;
+    stream_ring_free(&stream->input);
+    output_groups_free(&stream->groups);
+}
+
+/// @summary Pulls micro-batches from the input ring until it is closed and
+/// empty. A batch is classified once it is full, or once flush_ns has passed
+/// since its first record arrived. Records are classified by their position
+/// in the batch, so each decision can be published with its own ID and
+/// arrival time.
+/// @param stream The stream.
+/// @param latency The worker's private latency histogram.
+static void stream_worker(stream_t *stream, latency_histogram_t *latency)
+{
+    size_t const    batch_size  = stream->config.batch_size;
+    uint64_t const  flush_ticks = stream->config.flush_ns * timestamp_counts_per_second() / NANOS_PER_SECOND;
+    output_groups_t const *groups = &stream->groups;
+    std::vector<stream_item_t> items(batch_size);
+    std::vector<record_t>      records(batch_size);
+    std::vector<id_t>          positions(batch_size);
+    std::vector<uint32_t>      bits(batch_size);
+    std::vector<table_t>       tables(groups->group_count);
+    std::vector<table_t*>      outputs(stream->column_count);
+    for (size_t i = 0; i < batch_size; ++i)
+    {
+        positions[i] = (id_t) i;
+    }
+    for (size_t g = 0; g < groups->group_count; ++g)
+    {
+        table_init(&tables[g], (uint32_t)(batch_size * groups->groups[g].count + 1));
+        for (uint32_t k = 0; k < groups->groups[g].count; ++k)
+        {
+            outputs[groups->columns[groups->groups[g].first + k]] = &tables[g];
+        }
+    }
+    for ( ; ; )
+    {
+        size_t   n     = 0;
+        uint64_t first = 0;
+        uint32_t spins = 0;
+        while (n < batch_size)
+        {
+            if (stream_ring_pop(&stream->input, &items[n]))
+            {
+                if (n++ == 0) first = timestamp_in_ticks();
+                spins = 0;
+                continue;
+            }
+            // check closed before retrying, so the final records are not missed.
+            bool closed = stream->closed.load(std::memory_order_acquire);
+            if (closed && !stream_ring_pop(&stream->input, &items[n]))
+            {
+                break;
+            }
+            else if (closed)
+            {
+                if (n++ == 0) first = timestamp_in_ticks();
+                continue;
+            }
+            if (n > 0 && timestamp_in_ticks() - first >= flush_ticks)
+            {
+                break;
+            }
+            stream_backoff(&spins);
+        }
+        if (n == 0)
+        {
+            break;
+        }
+        for (size_t i = 0; i < n; ++i)
+        {
+            records[i] = items[i].record;
+        }
+        generate_bitfields(&bits[0], &records[0], n);
+        for (size_t g = 0; g < groups->group_count; ++g)
+        {
+            table_clear(&tables[g]);
+        }
+        stream->kernel(stream->masks, &outputs[0], stream->column_count, &positions[0], &bits[0], n);
+        for (size_t g = 0; g < groups->group_count; ++g)
+        {
+            for (size_t k = 0; k < tables[g].count; ++k)
+            {
+                stream_item_t const &item = items[tables[g].storage[k]];
+                stream_decision_t    decision;
+                decision.id       = item.record.id;
+                decision.enqueued = item.enqueued;
+                for (uint32_t s = 0; !stream_ring_push(&stream->actions[g], decision); )
+                {
+                    stream_backoff(&s);
+                }
+            }
+        }
+        uint64_t published = timestamp_in_ticks();
+        for (size_t i = 0; i < n; ++i)
+        {
+            latency_histogram_add(latency, timestamp_delta_nanoseconds(items[i].enqueued, published));
+        }
+    }
+    for (size_t g = 0; g < groups->group_count; ++g)
+    {
+        table_free(&tables[g]);
+    }
+}
+
+/// @summary Streams records through the classifier: producer threads push
+/// them into the input ring (paced to config.rate, if set), workers classify
+/// micro-batches and publish decisions to the action rings, and the calling
+/// thread drains the action rings into the output tables. Each output table
+/// receives the same IDs as a sequential classify() over the records, though
+/// not necessarily in the same order.
+/// @param stream The stream.
+/// @param records The records to stream.
+/// @param record_count The number of records.
+static void stream_run(stream_t *stream, record_t const *records, size_t record_count)
+{
+    stream_config_t const &c = stream->config;
+    std::vector<std::thread>         threads;
+    std::vector<latency_histogram_t> latency(c.workers);
+    stream->closed.store(false, std::memory_order_relaxed);
+    stream->active.store(c.workers, std::memory_order_relaxed);
+    latency_histogram_clear(&stream->latency);
+    for (size_t w = 0; w < c.workers; ++w)
+    {
+        latency_histogram_clear(&latency[w]);
+        threads.push_back(std::thread([stream, &latency, w]()
+        {
+            stream_worker(stream, &latency[w]);
+            stream->active.fetch_sub(1, std::memory_order_release);
+        }));
+    }
+    std::atomic<size_t> producing(c.producers);
+    uint64_t const      start = timestamp_in_ticks();
+    uint64_t const      tps   = timestamp_counts_per_second();
+    for (size_t p = 0; p < c.producers; ++p)
+    {
+        threads.push_back(std::thread([stream, records, record_count, &producing, &c, start, tps, p]()
+        {
+            for (size_t i = p; i < record_count; i += c.producers)
+            {
+                uint32_t spins = 0;
+                if (c.rate)
+                {   // record i is due i / rate seconds after the start.
+                    uint64_t due = start + (uint64_t)((double(i) / double(c.rate)) * double(tps));
+                    while (timestamp_in_ticks() < due)
+                    {
+                        stream_backoff(&spins);
+                    }
+                }
+                stream_item_t item;
+                item.record   = records[i];
+                item.enqueued = timestamp_in_ticks();
+                for (spins = 0; !stream_ring_push(&stream->input, item); )
+                {
+                    stream_backoff(&spins);
+                }
+            }
+            if (producing.fetch_sub(1) == 1)
+            {
+                stream->closed.store(true, std::memory_order_release);
+            }
+        }));
+    }
+
+    // drain the decisions, finishing once the workers have stopped and every
+    // ring is empty.
+    uint32_t spins = 0;
+    for ( ; ; )
+    {
+        bool   finished = stream->active.load(std::memory_order_acquire) == 0;
+        size_t drained  = 0;
+        for (size_t g = 0; g < stream->groups.group_count; ++g)
+        {
+            stream_decision_t decision;
+            table_t          *table = stream->groups.groups[g].table;
+            while (stream_ring_pop(&stream->actions[g], &decision))
+            {
+                table_put(table, decision.id);
+                drained++;
+            }
+        }
+        if (finished && drained == 0)
+        {
+            break;
+        }
+        if (drained == 0) stream_backoff(&spins);
+        else spins = 0;
+    }
+    for (size_t t = 0; t < threads.size(); ++t)
+    {
+        threads[t].join();
+    }
+    for (size_t w = 0; w < c.workers; ++w)
+    {
+        latency_histogram_merge(&stream->latency, &latency[w]);
+    }
+}
+
+/*//////////////////////////////
+//  Adaptive Classification   //
+//////////////////////////////*/
+/// @summary The number of records the adaptive executor dispatches at once.
+static const size_t Adaptive_Block_Size       = 16384;
+
+/// @summary The number of records at the start of each block that are
+/// sampled to estimate selectivity and branch predictability.
+static const size_t Adaptive_Sample_Size      = 64;
+
+/// @summary The number of predictability classes. Class k holds blocks whose
+/// per-branch transition rate is below 4^(k-3), with the last class open.
+static const size_t Adaptive_Predict_Classes  = 4;
+
+/// @summary The number of block classes: predictability x low/high selectivity.
+static const size_t Adaptive_Class_Count      = Adaptive_Predict_Classes * 2;
+
+/// @summary A kernel that is not the cheapest for a class is re-measured
+/// once Adaptive_Explore_Interval * (cost / best cost)^2 blocks have passed
+/// since it was last measured, so costs track the data while slow kernels
+/// are rarely retried.
+static const uint32_t Adaptive_Explore_Interval = 64;
+
+/// @summary Define the kernels the adaptive executor can dispatch to.
+enum adaptive_kernel_e
+{
+    ADAPTIVE_KERNEL_BRANCHY            = 0, // a branch per column per record
+    ADAPTIVE_KERNEL_BRANCHLESS         = 1, // classify(): speculative writes
+    ADAPTIVE_KERNEL_SIMD               = 2, // the best SIMD mask kernel
+    ADAPTIVE_KERNEL_LUT                = 3, // the truth table, gather mode
+    ADAPTIVE_KERNEL_COUNT              = 4
+};
+
+/// @summary A lookup table of strings for pretty-printing adaptive_kernel_e values.
+static char const *Adaptive_Kernel_Names[ADAPTIVE_KERNEL_COUNT] =
+{
+    "branchy",
+    "branchless",
+    "simd",
+    "lut"
+};
+
+/// @summary Records how the adaptive executor handled one block.
+struct adaptive_decision_t
+{
+    uint32_t     first;        /// Index of the first record in the block
+    uint32_t     count;        /// The number of records in the block
+    float        selectivity;  /// Fraction of (record, column) pairs in the sample that matched
+    float        transitions;  /// Fraction of consecutive sampled records whose match changed, per column
+    uint8_t      block_class;  /// The block class derived from the two estimates
+    uint8_t      kernel;       /// The adaptive_kernel_e that ran the block
+    uint8_t      explored;     /// Non-zero if the kernel was chosen to measure it, not because it was cheapest
+    float        cycles;       /// Measured timestamp counter cycles per record
+};
+
+/// @summary Chooses a kernel for each block of records. A prefix of each
+/// block is sampled to place the block in a class; the kernel with the
+/// lowest measured cost for that class runs the block, and its cost is
+/// updated from the timestamp counter. Costs are cycles per record plus
+/// estimated match, so blocks that write more are comparable. The
+/// branch-free kernels cost the same however predictable the data is, so
+/// their measurements are shared by every predictability class.
+struct adaptive_classifier_t
+{
+    classify_func_t                  simd;       /// The best SIMD mask kernel
+    lut_classifier_t const          *lut;        /// The compiled truth table, or NULL if unavailable
+    int                              forced;     /// An adaptive_kernel_e to always run, or -1 to adapt
+    uint64_t                         block;      /// The number of blocks dispatched so far, over all calls
+    double                           cost    [Adaptive_Class_Count][ADAPTIVE_KERNEL_COUNT]; /// Smoothed cost
+    uint64_t                         measured[Adaptive_Class_Count][ADAPTIVE_KERNEL_COUNT]; /// Block of the last measurement, or zero
+    std::vector<adaptive_decision_t> decisions;  /// One entry per block of the most recent call
+};
+
+/// @summary Classifies records with a branch per column. Best when the
+/// branches are predictable, as on sorted or clustered data. Produces output
+/// identical to classify(). Output tables are grown as needed.
+/// @param masks The masks generated from each column in the condition table.
+/// @param outputs An array of output tables, one for each column.
+/// @param column_count The number of columns in the condition table.
+/// @param ids An array of IDs associated with each input record.
+/// @param bits An array of bitfields computed for each input record.
+/// @param record_count The number of input records.
+static void classify_branchy(query_mask_t const *masks, table_t **outputs, size_t column_count, id_t const *ids, uint32_t const *bits, size_t record_count)
+{
+    for (size_t i = 0; i < record_count; ++i)
+    {
+        uint32_t bitfield = bits[i];
+        for (size_t j = 0; j < column_count; ++j)
+        {
+            if (((bitfield ^ masks[j].bits_false) | masks[j].bits_ignore) == 0xFFFFFFFFU)
+            {
+                table_put(outputs[j], ids[i]);
+            }
+        }
+    }
+}
+
+/// @summary Initializes an adaptive executor with no measurements.
+/// @param ac The executor to initialize.
+/// @param simd The best SIMD mask kernel.
+/// @param lut A compiled truth table for the same condition table and outputs, or NULL.
+static void adaptive_classifier_init(adaptive_classifier_t *ac, classify_func_t simd, lut_classifier_t const *lut)
+{
+    ac->simd   = simd;
+    ac->lut    = (lut != NULL && lut->compiled) ? lut : NULL;
+    ac->forced = -1;
+    ac->block  = 0;
+    memset(ac->cost    , 0, sizeof(ac->cost));
+    memset(ac->measured, 0, sizeof(ac->measured));
+    ac->decisions.clear();
+}
+
+/// @summary Chooses the kernel for a block of a given class. Kernels not yet
+/// measured for the class are tried first, except that the branchy kernel is
+/// skipped when a more predictable class already shows it to be slower than
+/// the best kernel: branch misses only grow as predictability falls.
+/// @param ac The adaptive executor.
+/// @param c The class of the block.
+/// @param explored Set to true if the kernel is chosen only to measure it.
+/// @return The adaptive_kernel_e to run.
+static int adaptive_choose(adaptive_classifier_t *ac, size_t c, bool *explored)
+{
+    static const int order[ADAPTIVE_KERNEL_COUNT] = { ADAPTIVE_KERNEL_SIMD, ADAPTIVE_KERNEL_BRANCHLESS, ADAPTIVE_KERNEL_LUT, ADAPTIVE_KERNEL_BRANCHY };
+    int kernel_count = ac->lut ? ADAPTIVE_KERNEL_COUNT : ADAPTIVE_KERNEL_LUT;
+    int best         = -1;
+    for (int k = 0; k < kernel_count; ++k)
+    {
+        if (ac->measured[c][k] && (best < 0 || ac->cost[c][k] < ac->cost[c][best])) best = k;
+    }
+    *explored = true;
+    for (int o = 0; o < ADAPTIVE_KERNEL_COUNT; ++o)
+    {
+        int k = order[o];
+        if (k >= kernel_count || ac->measured[c][k])
+        {
+            continue;
+        }
+        if (k == ADAPTIVE_KERNEL_BRANCHY && best >= 0)
+        {
+            double bound = 0.0;
+            for (size_t p = 0; p < c / 2; ++p)
+            {
+                size_t c2 = p * 2 + (c & 1);
+                if (ac->measured[c2][k] && ac->cost[c2][k] > bound) bound = ac->cost[c2][k];
+            }
+            if (bound >= ac->cost[c][best])
+            {
+                ac->cost    [c][k] = bound;
+                ac->measured[c][k] = ac->block;
+                continue;
+            }
+        }
+        return k;
+    }
+    int    overdue = -1;
+    double most    = 1.0;
+    for (int k = 0; k < kernel_count; ++k)
+    {
+        double ratio = ac->cost[c][k] / ac->cost[c][best];
+        double due   = double(ac->block - ac->measured[c][k]) / (double(Adaptive_Explore_Interval) * ratio * ratio);
+        if (k != best && due >= most)
+        {
+            most    = due;
+            overdue = k;
+        }
+    }
+    if (overdue >= 0)
+    {
+        return overdue;
+    }
+    *explored = false;
+    return best;
+}
+
+/// @summary Samples the start of a block and classifies it.
+/// @param masks The masks generated from each column in the condition table.
+/// @param column_count The number of columns in the condition table.
+/// @param bits The bitfields of the block.
+/// @param count The number of records in the block.
+/// @param decision The decision to fill in with the estimates and class.
+static void adaptive_sample(query_mask_t const *masks, size_t column_count, uint32_t const *bits, size_t count, adaptive_decision_t *decision)
+{
+    size_t   n       = count < Adaptive_Sample_Size ? count : Adaptive_Sample_Size;
+    uint32_t matches = 0;
+    uint32_t changes = 0;
+    for (size_t j = 0; j < column_count; ++j)
+    {
+        uint32_t prev = 0;
+        for (size_t i = 0; i < n; ++i)
+        {
+            uint32_t met = bits_all_set((bits[i] ^ masks[j].bits_false) | masks[j].bits_ignore);
+            matches += met;
+            changes += (i > 0) ? (met ^ prev) : 0;
+            prev     = met;
+        }
+    }
+    double pairs = double(n * column_count);
+    decision->selectivity = float(n ? double(matches) / pairs : 0.0);
+    decision->transitions = float(n > 1 ? double(changes) / double((n - 1) * column_count) : 0.0);
+    size_t predict = 0;
+    for (double limit = 1.0 / 64.0; predict + 1 < Adaptive_Predict_Classes && decision->transitions >= limit; limit *= 4.0)
+    {
+        ++predict;
+    }
+    decision->block_class = (uint8_t)(predict * 2 + (decision->selectivity >= 0.25f ? 1 : 0));
+}
+
+/// @summary Classifies records block by block, choosing a kernel for each.
+/// Blocks run in order, so output is identical to classify(). The decision
+/// for every block is kept in ac->decisions. Output tables are grown as needed.
+/// @param ac The adaptive executor. Costs persist across calls.
+/// @param masks The masks generated from each column in the condition table.
+/// @param outputs An array of output tables, one for each column; the same
+/// tables the truth table, if any, was compiled for.
+/// @param column_count The number of columns in the condition table.
+/// @param ids An array of IDs associated with each input record.
+/// @param bits An array of bitfields computed for each input record.
+/// @param record_count The number of input records.
+static void classify_adaptive(adaptive_classifier_t *ac, query_mask_t const *masks, table_t **outputs, size_t column_count, id_t const *ids, uint32_t const *bits, size_t record_count)
+{
+    ac->decisions.clear();
+    for (size_t base = 0; base < record_count; base += Adaptive_Block_Size)
+    {
+        size_t              n = (record_count - base) < Adaptive_Block_Size ? (record_count - base) : Adaptive_Block_Size;
+        adaptive_decision_t d;
+        d.first    = (uint32_t) base;
+        d.count    = (uint32_t) n;
+        d.explored = 0;
+        adaptive_sample(masks, column_count, bits + base, n, &d);
+
+        size_t c        = d.block_class;
+        bool   explored = false;
+        int    k        = ac->forced >= 0 ? ac->forced : adaptive_choose(ac, c, &explored);
+        ac->block++;
+        d.kernel   = (uint8_t) k;
+        d.explored = explored ? 1 : 0;
+
+        uint64_t start = timestamp_in_cycles();
+        switch (k)
+        {
+            case ADAPTIVE_KERNEL_BRANCHY:
+                classify_branchy(masks, outputs, column_count, ids + base, bits + base, n);
+                break;
+            case ADAPTIVE_KERNEL_BRANCHLESS:
+                classify(masks, outputs, column_count, ids + base, bits + base, n);
+                break;
+            case ADAPTIVE_KERNEL_SIMD:
+                ac->simd(masks, outputs, column_count, ids + base, bits + base, n);
+                break;
+            default:
+                classify_lut(ac->lut, LUT_MODE_GATHER, masks, outputs, column_count, ids + base, bits + base, n);
+                break;
+        }
+        uint64_t cycles = timestamp_in_cycles() - start;
+        d.cycles = float(double(cycles) / double(n));
+
+        // a short final block is not representative of the class.
+        if (n == Adaptive_Block_Size || ac->measured[c][k] == 0)
+        {
+            double cost = double(cycles) / (double(n) * (1.0 + double(d.selectivity) * double(column_count)));
+            for (size_t p = 0; p < Adaptive_Predict_Classes; ++p)
+            {
+                size_t c2 = (k == ADAPTIVE_KERNEL_BRANCHY) ? c : p * 2 + (c & 1);
+                ac->cost    [c2][k] = ac->measured[c2][k] ? 0.75 * ac->cost[c2][k] + 0.25 * cost : cost;
+                ac->measured[c2][k] = ac->block;
+                if (k == ADAPTIVE_KERNEL_BRANCHY) break;
+            }
+        }
+        ac->decisions.push_back(d);
+    }
+}
+
+/*//////////////////////
+//  Telemetry         //
+//////////////////////*/
+/// @summary The number of condition bits with their own population counter.
+static const size_t Telemetry_Max_Bits    = 32;
+
+/// @summary The number of distinct kernel names that can be timed.
+static const size_t Telemetry_Max_Kernels = 64;
+
+/// @summary The number of records classified before they are counted, when a
+/// table has more than Telemetry_Max_Shared shared columns. Small enough that
+/// the block's bitfields are still in cache.
+static const size_t Telemetry_Count_Block = 2048;
+
+/// @summary The largest slowdown accepted from counting, as a fraction of the
+/// uncounted kernel's median time.
+static const double Telemetry_Max_Overhead = 0.02;
+
+/// @summary The counters owned by one thread. Only the owning thread writes
+/// them, once per kernel call, so a plain load and store suffice; other threads
+/// read them with relaxed loads when taking a snapshot.
+struct telemetry_counters_t
+{
+    std::atomic<uint64_t> classified;                          /// Records classified by counted kernels
+    std::atomic<uint64_t> column_hits[Telemetry_Max_Columns];  /// Matches of each column, by column index
+    std::atomic<uint64_t> generated;                           /// Bitfields generated by counted generators
+    std::atomic<uint64_t> condition_bits[Telemetry_Max_Bits];  /// Records with each condition bit set
+    std::atomic<uint64_t> kernel_calls  [Telemetry_Max_Kernels]; /// Calls of each kernel
+    std::atomic<uint64_t> kernel_records[Telemetry_Max_Kernels]; /// Records processed by each kernel
+    std::atomic<uint64_t> kernel_nanos  [Telemetry_Max_Kernels]; /// Time spent in each kernel
+};
+
+/// @summary The time spent in one kernel, summed over all threads.
+struct telemetry_kernel_t
+{
+    std::string  name;        /// The name the kernel was registered with
+    uint64_t     calls;       /// The number of calls
+    uint64_t     records;     /// The number of records processed
+    uint64_t     nanos;       /// The total time spent in the kernel, in nanoseconds
+};
+
+/// @summary The counters of every thread, summed at one point in time. The
+/// difference of two snapshots gives the counts over an interval, which shows
+/// how match rates drift.
+struct telemetry_snapshot_t
+{
+    uint64_t                         timestamp;     /// timestamp_in_ticks() when the snapshot was taken
+    uint64_t                         classified;    /// Records classified by counted kernels
+    uint64_t                         column_hits[Telemetry_Max_Columns];
+    uint64_t                         generated;     /// Bitfields generated by counted generators
+    uint64_t                         condition_bits[Telemetry_Max_Bits];
+    std::vector<telemetry_kernel_t>  kernels;       /// One entry per registered kernel name
+};
+
+/// @summary The signature of the counted classify kernels. The parameters are
+/// as for classify(), followed by the shared column weights and counts; see
+/// classify_counted_scalar().
+typedef void (*counted_func_t)(query_mask_t const*, table_t**, size_t, id_t const*, uint32_t const*, size_t, uint32_t const*, uint64_t*);
+
+/// @summary Guards the list of per-thread counters and the kernel names.
+static std::mutex                          Telemetry_Lock;
+
+/// @summary The counters of every thread that has recorded telemetry. Counters
+/// outlive their threads so that their counts stay in later snapshots.
+static std::vector<telemetry_counters_t*>  Telemetry_Threads;
+
+/// @summary The registered kernel names, indexed by kernel ID.
+static std::vector<std::string>            Telemetry_Kernel_Names;
+
+/// @summary The counters of the calling thread, or NULL until it records telemetry.
+static thread_local telemetry_counters_t  *Telemetry_Local = NULL;
+
+/// @summary Retrieves the counters of the calling thread, creating and
+/// registering them on first use.
+/// @return The calling thread's counters.
+static telemetry_counters_t* telemetry_local(void)
+{
+    if (Telemetry_Local == NULL)
+    {
+        telemetry_counters_t *counters = new telemetry_counters_t;
+        counters->classified.store(0, std::memory_order_relaxed);
+        counters->generated .store(0, std::memory_order_relaxed);
+        for (size_t j = 0; j < Telemetry_Max_Columns; ++j) counters->column_hits[j].store(0, std::memory_order_relaxed);
+        for (size_t b = 0; b < Telemetry_Max_Bits; ++b) counters->condition_bits[b].store(0, std::memory_order_relaxed);
+        for (size_t k = 0; k < Telemetry_Max_Kernels; ++k)
+        {
+            counters->kernel_calls  [k].store(0, std::memory_order_relaxed);
+            counters->kernel_records[k].store(0, std::memory_order_relaxed);
+            counters->kernel_nanos  [k].store(0, std::memory_order_relaxed);
+        }
+        std::lock_guard<std::mutex> guard(Telemetry_Lock);
+        Telemetry_Threads.push_back(counters);
+        Telemetry_Local = counters;
+    }
+    return Telemetry_Local;
+}
+
+/// @summary Adds to a counter owned by the calling thread.
+/// @param counter The counter to update.
+/// @param value The amount to add.
+static inline void telemetry_add(std::atomic<uint64_t> &counter, uint64_t value)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+/// @summary Retrieves the ID of a kernel name, registering it if necessary.
+/// Look the ID up once, outside any loop.
+/// @param name The kernel name, such as "classify/avx2".
+/// @return The kernel ID, or Telemetry_Max_Kernels if too many names are registered.
+static size_t telemetry_kernel_id(char const *name)
+{
+    std::lock_guard<std::mutex> guard(Telemetry_Lock);
+    for (size_t k = 0; k < Telemetry_Kernel_Names.size(); ++k)
+    {
+        if (Telemetry_Kernel_Names[k] == name) return k;
+    }
+    if (Telemetry_Kernel_Names.size() == Telemetry_Max_Kernels)
+    {
+        return Telemetry_Max_Kernels;
+    }
+    Telemetry_Kernel_Names.push_back(name);
+    return Telemetry_Kernel_Names.size() - 1;
+}
+
+/// @summary Records one call of a kernel on the calling thread.
+/// @param kernel_id The ID returned by telemetry_kernel_id().
+/// @param records The number of records processed by the call.
+/// @param start The timestamp_in_ticks() value at the start of the call.
+static void telemetry_record_call(size_t kernel_id, size_t records, uint64_t start)
+{
+    uint64_t nanos = timestamp_delta_nanoseconds(start, timestamp_in_ticks());
+    if (kernel_id < Telemetry_Max_Kernels)
+    {
+        telemetry_counters_t *counters = telemetry_local();
+        telemetry_add(counters->kernel_calls  [kernel_id], 1);
+        telemetry_add(counters->kernel_records[kernel_id], records);
+        telemetry_add(counters->kernel_nanos  [kernel_id], nanos);
+    }
+}
+
+/// @summary Classifies records four at a time using SSE4.2, counting the matches of each shared column.
+TARGET_SSE42 static void classify_counted_sse42(query_mask_t const *masks, table_t **outputs, size_t column_count, id_t const *ids, uint32_t const *bits, size_t record_count, uint32_t const *weights, uint64_t *shared_hits)
+{
+    classify_sse42_lanes<false, true>(masks, outputs, column_count, ids, 0, bits, record_count, weights, shared_hits);
+}
+
+/// @summary Classifies records eight at a time using AVX2, counting the matches of each shared column.
+TARGET_AVX2 static void classify_counted_avx2(query_mask_t const *masks, table_t **outputs, size_t column_count, id_t const *ids, uint32_t const *bits, size_t record_count, uint32_t const *weights, uint64_t *shared_hits)
+{
+    classify_avx2_lanes<false, true>(masks, outputs, column_count, ids, 0, bits, record_count, weights, shared_hits);
+}
+
+/// @summary Classifies records sixteen at a time using AVX-512F, counting the matches of each shared column.
+TARGET_AVX512 static void classify_counted_avx512(query_mask_t const *masks, table_t **outputs, size_t column_count, id_t const *ids, uint32_t const *bits, size_t record_count, uint32_t const *weights, uint64_t *shared_hits)
+{
+    classify_avx512_lanes<false, true>(masks, outputs, column_count, ids, 0, bits, record_count, weights, shared_hits);
+}
+
+/// @summary The counted classify kernel for each simd_level_e.
+static const counted_func_t Counted_Kernels[SIMD_LEVEL_COUNT] =
+{
+    classify_counted_scalar,
+    classify_counted_sse42,
+    classify_counted_avx2,
+    classify_counted_avx512
+};
+
+/// @summary Classifies records, adding the matches of each column and the
+/// time taken to the calling thread's counters. The first column of each
+/// output table is counted from the change in the table's count, less the
+/// matches of the table's shared columns, which the Counted kernels count in
+/// registers. Counts are published once per call. Produces output identical
+/// to Classify_Kernels[level].
+/// @param kernel_id The ID returned by telemetry_kernel_id() for the caller.
+/// @param level The simd_level_e of the kernel to run.
+/// @param masks The masks generated from each column in the condition table.
+/// @param outputs An array of output tables, one for each column.
+/// @param column_count The number of columns in the condition table. Columns
+/// beyond Telemetry_Max_Columns are classified but not counted.
+/// @param ids An array of IDs associated with each input record.
+/// @param bits An array of bitfields computed for each input record.
+/// @param record_count The number of input records.
+static void classify_counted(size_t kernel_id, simd_level_e level, query_mask_t const *masks, table_t **outputs, size_t column_count, id_t const *ids, uint32_t const *bits, size_t record_count)
+{
+    uint64_t start = timestamp_in_ticks();
+    if (column_count <= Telemetry_Max_Columns)
+    {
+        uint64_t hits   [Telemetry_Max_Columns] = { 0 };
+        uint32_t weights[Telemetry_Max_Columns];
+        size_t   before [Telemetry_Max_Columns];
+        size_t   shared = 0;
+        for (size_t j = 0; j < column_count; ++j)
+        {
+            size_t h = 0;
+            while (outputs[h] != outputs[j])
+            {
+                ++h;
+            }
+            weights[j] = (h < j && shared < Telemetry_Max_Shared) ? (1u << (8 * shared)) : 0;
+            before [j] = outputs[j]->count;
+            shared    += (h < j) ? 1 : 0;
+        }
+        if (shared <= Telemetry_Max_Shared)
+        {
+            uint64_t shared_hits[Telemetry_Max_Shared] = { 0 };
+            Counted_Kernels[level](masks, outputs, column_count, ids, bits, record_count, weights, shared_hits);
+            for (size_t j = 0, s = 0; j < column_count; ++j)
+            {
+                if (weights[j] != 0) hits[j] = shared_hits[s++];
+            }
+            for (size_t j = 0; j < column_count; ++j)
+            {
+                if (weights[j] != 0) continue;
+                hits[j] = outputs[j]->count - before[j];
+                for (size_t k = j + 1; k < column_count; ++k)
+                {
+                    if (outputs[k] == outputs[j]) hits[j] -= hits[k];
+                }
+            }
+        }
+        else
+        {
+            // too many shared columns to count in registers; count each block
+            // in a second pass while its bitfields are in cache.
+            for (size_t lo = 0; lo < record_count; lo += Telemetry_Count_Block)
+            {
+                size_t n = std::min(record_count - lo, Telemetry_Count_Block);
+                Classify_Kernels[level](masks, outputs, column_count, ids + lo, bits + lo, n);
+                count_column_hits(masks, column_count, bits + lo, n, hits);
+            }
+        }
+        telemetry_counters_t *counters = telemetry_local();
+        telemetry_add(counters->classified, record_count);
+        for (size_t j = 0; j < column_count; ++j)
+        {
+            telemetry_add(counters->column_hits[j], hits[j]);
+        }
+    }
+    else
+    {
+        Classify_Kernels[level](masks, outputs, column_count, ids, bits, record_count);
+    }
+    telemetry_record_call(kernel_id, record_count, start);
+}
+
+/// @summary Generates and counts the bitfields of a block of records. See
+/// generate_bitfields_store().
+/// @param dst The destination bitfields, of at least count elements.
+/// @param src The source record store.
+/// @param first The index of the first record in src to process.
+/// @param count The number of items to read from src and write to dst, at most Bit_Count_Block.
+/// @return The condition bit sums, as for generate_bitfields_store().
+NOINLINE static uint64_t generate_bitfields_block(uint32_t *dst, record_store_t const *src, size_t first, size_t count)
+{
+    return generate_bitfields_store<uint32_t, true>(dst, src, first, count);
+}
+
+/// @summary Generates bitfields using a structure of arrays data source, adding
+/// the number of records for which each predicate is true to the calling
+/// thread's counters. Produces output identical to generate_bitfields(). The
+/// bits are counted in registers by the generator's own loop.
+/// @param kernel_id The ID returned by telemetry_kernel_id() for the caller.
+/// @param dst The destination bitfields, of at least count elements.
+/// @param src The source record store.
+/// @param first The index of the first record in src to process.
+/// @param count The number of items to read from src and write to dst.
+static void generate_bitfields_counted(size_t kernel_id, uint32_t *dst, record_store_t const *src, size_t first, size_t count)
+{
+    uint64_t start = timestamp_in_ticks();
+    uint64_t counts[Condition_Name_Count] = { 0 };
+    for (size_t lo = 0; lo < count; lo += Bit_Count_Block)
+    {
+        size_t   n    = std::min(count - lo, Bit_Count_Block);
+        uint64_t sums = generate_bitfields_block(dst + lo, src, first + lo, n);
+        uint64_t lt   = (sums >> 32) & 0xFFFF;
+        counts[PROOF_OF_ADDRESS ] += (sums >>  0) & 0xFFFF;
+        counts[PROOF_OF_IDENTITY] += (sums >> 16) & 0xFFFF;
+        counts[LOAN_LT_SALARY   ] += lt;
+        counts[LOAN_GE_SALARY   ] += n - lt;
+        counts[EXISTING_OWNER   ] += (sums >> 48) & 0xFFFF;
+    }
+    telemetry_counters_t *counters = telemetry_local();
+    telemetry_add(counters->generated, count);
+    for (size_t b = 0; b < Condition_Name_Count; ++b)
+    {
+        telemetry_add(counters->condition_bits[b], counts[b]);
+    }
+    telemetry_record_call(kernel_id, count, start);
+}
+
+/// @summary Sums the counters of every thread. Counts published while the
+/// snapshot is taken may or may not be included.
+/// @param snapshot The snapshot to fill in.
+static void telemetry_snapshot(telemetry_snapshot_t *snapshot)
+{
+    std::lock_guard<std::mutex> guard(Telemetry_Lock);
+    snapshot->timestamp  = timestamp_in_ticks();
+    snapshot->classified = 0;
+    snapshot->generated  = 0;
+    memset(snapshot->column_hits   , 0, sizeof(snapshot->column_hits));
+    memset(snapshot->condition_bits, 0, sizeof(snapshot->condition_bits));
+    snapshot->kernels.resize(Telemetry_Kernel_Names.size());
+    for (size_t k = 0; k < snapshot->kernels.size(); ++k)
+    {
+        snapshot->kernels[k].name    = Telemetry_Kernel_Names[k];
+        snapshot->kernels[k].calls   = 0;
+        snapshot->kernels[k].records = 0;
+        snapshot->kernels[k].nanos   = 0;
+    }
+    for (size_t t = 0; t < Telemetry_Threads.size(); ++t)
+    {
+        telemetry_counters_t const *counters = Telemetry_Threads[t];
+        snapshot->classified += counters->classified.load(std::memory_order_relaxed);
+        snapshot->generated  += counters->generated .load(std::memory_order_relaxed);
+        for (size_t j = 0; j < Telemetry_Max_Columns; ++j) snapshot->column_hits[j] += counters->column_hits[j].load(std::memory_order_relaxed);
+        for (size_t b = 0; b < Telemetry_Max_Bits; ++b) snapshot->condition_bits[b] += counters->condition_bits[b].load(std::memory_order_relaxed);
+        for (size_t k = 0; k < snapshot->kernels.size(); ++k)
+        {
+            snapshot->kernels[k].calls   += counters->kernel_calls  [k].load(std::memory_order_relaxed);
+            snapshot->kernels[k].records += counters->kernel_records[k].load(std::memory_order_relaxed);
+            snapshot->kernels[k].nanos   += counters->kernel_nanos  [k].load(std::memory_order_relaxed);
+        }
+    }
+}
+
+/// @summary Computes the counts over the interval between two snapshots.
+/// @param delta The snapshot to fill in; its timestamp is the length of the interval, in ticks.
+/// @param before The earlier snapshot.
+/// @param after The later snapshot.
+static void telemetry_delta(telemetry_snapshot_t *delta, telemetry_snapshot_t const *before, telemetry_snapshot_t const *after)
+{
+    delta->timestamp  = after->timestamp  - before->timestamp;
+    delta->classified = after->classified - before->classified;
+    delta->generated  = after->generated  - before->generated;
+    for (size_t j = 0; j < Telemetry_Max_Columns; ++j) delta->column_hits[j] = after->column_hits[j] - before->column_hits[j];
+    for (size_t b = 0; b < Telemetry_Max_Bits; ++b) delta->condition_bits[b] = after->condition_bits[b] - before->condition_bits[b];
+    delta->kernels = after->kernels;
+    for (size_t k = 0; k < before->kernels.size() && k < delta->kernels.size(); ++k)
+    {
+        delta->kernels[k].calls   -= before->kernels[k].calls;
+        delta->kernels[k].records -= before->kernels[k].records;
+        delta->kernels[k].nanos   -= before->kernels[k].nanos;
+    }
+}
+
+/// @summary Prints a snapshot or interval: the match rate of each column, the
+/// rate at which each condition is true, and the time spent in each kernel.
+/// @param snapshot The snapshot to print.
+/// @param column_count The number of condition table columns to print.
+static void telemetry_print(telemetry_snapshot_t const *snapshot, size_t column_count)
+{
+    printf("Telemetry: %" PRIu64 " records classified, %" PRIu64 " bitfields generated.\n", snapshot->classified, snapshot->generated);
+    for (size_t j = 0; j < column_count && j < Telemetry_Max_Columns; ++j)
+    {
+        printf("  column %2u: %12" PRIu64 " hits (%5.1f%%)\n", (uint32_t) j, snapshot->column_hits[j],
+            snapshot->classified ? 100.0 * double(snapshot->column_hits[j]) / double(snapshot->classified) : 0.0);
+    }
+    for (size_t b = 0; b < Condition_Name_Count; ++b)
+    {
+        printf("  %-15s %12" PRIu64 " true (%5.1f%%)\n", Condition_Names[b], snapshot->condition_bits[b],
+            snapshot->generated ? 100.0 * double(snapshot->condition_bits[b]) / double(snapshot->generated) : 0.0);
+    }
+    for (size_t k = 0; k < snapshot->kernels.size(); ++k)
+    {
+        telemetry_kernel_t const *kernel = &snapshot->kernels[k];
+        printf("  %-24s %8" PRIu64 " calls %12" PRIu64 " records %10.3f ms %8.3f ns/record\n", kernel->name.c_str(), kernel->calls, kernel->records,
+            double(kernel->nanos) / 1000000.0, kernel->records ? double(kernel->nanos) / double(kernel->records) : 0.0);
+    }
+}
+
+/// @summary Advances a xorshift32 random number generator.
+/// @param state The generator state, which must be non-zero.
+/// @return The next value in the sequence.
+static inline uint32_t xorshift32(uint32_t *state)
+{
+    uint32_t x = *state;
+    x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+    return (*state = x);
+}
+
+/// @summary Generates a random condition table column and its mask.
+/// @param mask The output mask structure.
+/// @param rules Storage for row_count rules.
+/// @param row_count The number of rows in the condition table.
+/// @param state The state of a xorshift random number generator.
+template <typename bits_t>
+static void random_column_mask(query_mask_base_t<bits_t> *mask, rule_e *rules, size_t row_count, uint32_t *state)
+{
+    for (size_t i = 0; i < row_count; ++i)
+    {
+        uint32_t r = xorshift32(state) % 8; // mostly don't care, as in real rulebooks
+        rules[i] = (r == 0) ? CONDITION_FALSE : ((r == 1) ? CONDITION_TRUE : CONDITION_NULL);
+    }
+    build_column_mask(mask, rules, row_count);
+}
+
+/// @summary Measures the lookup table classifier against a mask kernel for
+/// random condition tables of increasing width, and prints the results.
+/// @param kernel The mask kernel to compare against.
+/// @param column_count The number of columns in the random condition tables.
+/// Columns are assigned round-robin to three output tables.
+/// @param record_count The number of random bitfields to classify.
+/// @param iterations The number of times to classify the bitfields.
+/// @return The smallest row count at which the mask kernel was faster, or zero.
+static size_t benchmark_lut_crossover(classify_func_t kernel, size_t column_count, size_t record_count, size_t iterations)
+{
+    static const size_t row_counts[] = { 5, 8, 10, 12, 14, 16, 18, 20, 22 };
+    uint32_t  state     = 0x9E3779B9U;
+    id_t     *ids       = (id_t    *) malloc(record_count * sizeof(id_t));
+    uint32_t *bits      = (uint32_t*) malloc(record_count * sizeof(uint32_t));
+    table_t   tables[3];
+    size_t    crossover = 0;
+    std::vector<query_mask_t> masks(column_count);
+    std::vector<table_t*>     outputs(column_count);
+    for (size_t t = 0; t < 3; ++t)
+    {
+        table_init(&tables[t], (uint32_t)(record_count + 1));
+    }
+    for (size_t j = 0; j < column_count; ++j)
+    {
+        outputs[j] = &tables[j % 3];
+    }
+    for (size_t i = 0; i < record_count; ++i)
+    {
+        ids[i] = (id_t) i;
+    }
+
+    printf("LUT crossover (%u records, %u columns):\n", (uint32_t) record_count, (uint32_t) column_count);
+    for (size_t r = 0; r < sizeof(row_counts) / sizeof(row_counts[0]); ++r)
+    {
+        size_t       row_count = row_counts[r];
+        rule_e       rules[MAX_BITS];
+        for (size_t j = 0; j < column_count; ++j)
+        {
+            random_column_mask(&masks[j], rules, row_count, &state);
+        }
+        for (size_t i = 0; i < record_count; ++i)
+        {
+            bits[i] = xorshift32(&state) & (uint32_t)((size_t(1) << row_count) - 1);
+        }
+
+        lut_classifier_t lut;
+        lut_classifier_build(&lut, &masks[0], &outputs[0], column_count, row_count, kernel, Lut_Limit_Rows);
+        bench_timer_t mask_time, lut_time;
+        timer_start(&mask_time);
+        for (size_t iter = 0; iter < iterations; ++iter)
+        {
+            table_clear(&tables[0]); table_clear(&tables[1]); table_clear(&tables[2]);
+            kernel(&masks[0], &outputs[0], column_count, ids, bits, record_count);
+        }
+        timer_stop(&mask_time);
+        timer_start(&lut_time);
+        for (size_t iter = 0; iter < iterations; ++iter)
+        {
+            table_clear(&tables[0]); table_clear(&tables[1]); table_clear(&tables[2]);
+            classify_lut(&lut, LUT_MODE_GATHER, &masks[0], &outputs[0], column_count, ids, bits, record_count);
+        }
+        timer_stop(&lut_time);
+        float mask_sec = duration_sec(&mask_time);
+        float lut_sec  = duration_sec(&lut_time);
+        printf("  %2u rows: %8u KB table, mask %f s, LUT %f s%s\n", (uint32_t) row_count,
+            (uint32_t)((lut.entry_count * lut.groups.group_count) / 1024), mask_sec, lut_sec,
+            (lut_sec > mask_sec) ? " (mask faster)" : "");
+        if (crossover == 0 && lut_sec > mask_sec)
+        {
+            crossover = row_count;
+        }
+        lut_classifier_free(&lut);
+    }
+    for (size_t t = 0; t < 3; ++t)
+    {
+        table_free(&tables[t]);
+    }
+    free(bits);
+    free(ids);
+    return crossover;
+}
+
+/// @summary Measures classify() throughput for one bitfield width using random
+/// condition tables with one row per bit, and prints the result.
+/// @param column_count The number of columns in the random condition table.
+/// @param record_count The number of random bitfields to classify.
+/// @param iterations The number of times to classify the bitfields.
+template <typename bits_t>
+static void benchmark_bitfield_width(size_t column_count, size_t record_count, size_t iterations)
+{
+    size_t const row_count = bits_width<bits_t>::value;
+    uint32_t     state     = 0x2545F491U;
+    id_t        *ids       = (id_t  *) malloc(record_count * sizeof(id_t));
+    bits_t      *bits      = (bits_t*) malloc(record_count * sizeof(bits_t));
+    rule_e       rules[Max_Bitfield_Width];
+    table_t      tables[3];
+    std::vector<query_mask_base_t<bits_t> > masks(column_count);
+    std::vector<table_t*>                   outputs(column_count);
+    for (size_t t = 0; t < 3; ++t)
+    {
+        table_init(&tables[t], (uint32_t)(record_count + 1));
+    }
+    for (size_t j = 0; j < column_count; ++j)
+    {
+        random_column_mask(&masks[j], rules, row_count, &state);
+        outputs[j] = &tables[j % 3];
+    }
+    for (size_t i = 0; i < record_count; ++i)
+    {
+        uint32_t words[sizeof(bits_t) / sizeof(uint32_t)];
+        for (size_t w = 0; w < sizeof(bits_t) / sizeof(uint32_t); ++w)
+        {
+            words[w] = xorshift32(&state);
+        }
+        memcpy(&bits[i], words, sizeof(bits_t));
+        ids[i] = (id_t) i;
+    }
+
+    bench_timer_t width_time;
+    timer_start(&width_time);
+    for (size_t iter = 0; iter < iterations; ++iter)
+    {
+        table_clear(&tables[0]); table_clear(&tables[1]); table_clear(&tables[2]);
+        classify(&masks[0], &outputs[0], column_count, ids, bits, record_count);
+    }
+    timer_stop(&width_time);
+    double seconds = duration_sec(&width_time);
+    double records = double(record_count) * double(iterations);
+    printf("  %3u-bit: %f s, %7.1f M records/s, %7.1f MB/s of bitfields\n", (uint32_t) row_count, seconds,
+        records / seconds / 1.0e6, records * double(sizeof(bits_t)) / seconds / (1024.0 * 1024.0));
+
+    for (size_t t = 0; t < 3; ++t)
+    {
+        table_free(&tables[t]);
+    }
+    free(bits);
+    free(ids);
+}
+
+/// @summary Generates a random condition table resembling a production
+/// rulebook: each rule extends one of a few shared prefixes over the first
+/// conditions with a couple of further conditions drawn from a small pool
+/// belonging to that prefix, and is otherwise don't care.
+/// @param rules Storage for column_count * row_count rules, column-major.
+/// @param column_count The number of columns (rules) to generate.
+/// @param row_count The number of rows (conditions), at least 8.
+/// @param state The state of a xorshift random number generator.
+static void random_rulebook(rule_e *rules, size_t column_count, size_t row_count, uint32_t *state)
+{
+    static const size_t prefix_count = 8;
+    rule_e prefixes[prefix_count][8];
+    for (size_t p = 0; p < prefix_count; ++p)
+    {
+        for (size_t i = 0; i < 8; ++i)
+        {
+            uint32_t r = xorshift32(state) % 8;
+            prefixes[p][i] = (r < 2) ? ((r == 0) ? CONDITION_FALSE : CONDITION_TRUE) : CONDITION_NULL;
+        }
+    }
+    for (size_t j = 0; j < column_count; ++j)
+    {
+        size_t        p      = xorshift32(state) % prefix_count;
+        rule_e       *column = &rules[j * row_count];
+        for (size_t i = 0; i < row_count; ++i)
+        {
+            column[i] = (i < 8) ? prefixes[p][i] : CONDITION_NULL;
+        }
+        for (size_t k = 0; k < 2; ++k)
+        {
+            size_t i  = 8 + (p * 2 + xorshift32(state) % 4) % (row_count - 8);
+            column[i] = (xorshift32(state) & 1) ? CONDITION_TRUE : CONDITION_FALSE;
+        }
+    }
+}
+
+/// @summary Measures the decision diagram classifier against a mask kernel on a
+/// random rulebook, checks that the outputs are identical, and prints the results.
+/// @param kernel The mask kernel to compare against.
+/// @param column_count The number of columns (rules) in the rulebook.
+/// @param row_count The number of rows (conditions) in the rulebook, in [8, 32].
+/// @param record_count The number of random bitfields to classify.
+/// @param iterations The number of times to classify the bitfields.
+/// @return true if the decision diagram output matched the mask kernel.
+static bool benchmark_decision_diagram(classify_func_t kernel, size_t column_count, size_t row_count, size_t record_count, size_t iterations)
+{
+    uint32_t  state = 0x6C8E9CF5U;
+    id_t     *ids   = (id_t    *) malloc(record_count * sizeof(id_t));
+    uint32_t *bits  = (uint32_t*) malloc(record_count * sizeof(uint32_t));
+    table_t   tables[6];
+    std::vector<rule_e>       rules(column_count * row_count);
+    std::vector<query_mask_t> masks(column_count);
+    std::vector<table_t*>     mask_outputs(column_count);
+    std::vector<table_t*>     dd_outputs(column_count);
+    for (size_t t = 0; t < 6; ++t)
+    {
+        table_init(&tables[t], (uint32_t)(record_count + 1));
+    }
+    random_rulebook(&rules[0], column_count, row_count, &state);
+    for (size_t j = 0; j < column_count; ++j)
+    {
+        build_column_mask(&masks[j], &rules[j * row_count], row_count);
+        mask_outputs[j] = &tables[0 + j % 3];
+        dd_outputs  [j] = &tables[3 + j % 3];
+    }
+    for (size_t i = 0; i < record_count; ++i)
+    {
+        ids [i] = (id_t) i;
+        bits[i] = xorshift32(&state) & (uint32_t)((1ULL << row_count) - 1);
+    }
+
+    decision_diagram_t dd;
+    decision_diagram_build(&dd, &rules[0], &dd_outputs[0], column_count, row_count, kernel);
+    bench_timer_t mask_time, dd_time;
+    timer_start(&mask_time);
+    for (size_t iter = 0; iter < iterations; ++iter)
+    {
+        table_clear(&tables[0]); table_clear(&tables[1]); table_clear(&tables[2]);
+        kernel(&masks[0], &mask_outputs[0], column_count, ids, bits, record_count);
+    }
+    timer_stop(&mask_time);
+    timer_start(&dd_time);
+    for (size_t iter = 0; iter < iterations; ++iter)
+    {
+        table_clear(&tables[3]); table_clear(&tables[4]); table_clear(&tables[5]);
+        classify_decision_diagram(&dd, &masks[0], &dd_outputs[0], column_count, ids, bits, record_count);
+    }
+    timer_stop(&dd_time);
+    bool match = table_equal(&tables[0], &tables[3]) && table_equal(&tables[1], &tables[4]) && table_equal(&tables[2], &tables[5]);
+    if (dd.compiled)
+    {
+        printf("  %4u rules x %2u conditions: %7u nodes, %5u leaves, mask %f s, diagram %f s, output %s\n",
+            (uint32_t) column_count, (uint32_t) row_count, (uint32_t) dd.node_count, (uint32_t) dd.leaf_count,
+            duration_sec(&mask_time), duration_sec(&dd_time), match ? "matches" : "DOES NOT MATCH");
+    }
+    else
+    {
+        printf("  %4u rules x %2u conditions: over %u nodes, used fallback kernel\n",
+            (uint32_t) column_count, (uint32_t) row_count, (uint32_t) Decision_Diagram_Max_Nodes);
+    }
+
+    decision_diagram_free(&dd);
+    for (size_t t = 0; t < 6; ++t)
+    {
+        table_free(&tables[t]);
+    }
+    free(bits);
+    free(ids);
+    return match;
+}
+
+/// @summary Classifies records using Condition_Table with a given bitfield
+/// width and compares the result against the 32-bit classifier.
+/// @param records The array of input records.
+/// @param ids An array of IDs associated with each input record.
+/// @param record_count The number of input records.
+/// @return true if the outputs are identical.
+template <typename bits_t>
+static bool verify_bitfield_width(record_t const *records, id_t const *ids, size_t record_count)
+{
+    query_mask_base_t<bits_t>   wide_masks[Table_Cols];
+    query_mask_t                masks[Table_Cols];
+    bits_t                     *wide_bits = (bits_t  *) malloc(record_count * sizeof(bits_t));
+    uint32_t                   *bits      = (uint32_t*) malloc(record_count * sizeof(uint32_t));
+    table_t                     tables[6];
+    table_t                    *wide_outputs[Table_Cols] = { &tables[0], &tables[0], &tables[2], &tables[2], &tables[1] };
+    table_t                    *outputs[Table_Cols]      = { &tables[3], &tables[3], &tables[5], &tables[5], &tables[4] };
+    for (size_t t = 0; t < 6; ++t)
+    {
+        table_init(&tables[t], (uint32_t)(2 * record_count + 1));
+    }
+    for (size_t j = 0; j < Table_Cols; ++j)
+    {
+        build_column_mask(&wide_masks[j], Condition_Table[j], Table_Rows);
+        build_column_mask(&masks[j], Condition_Table[j], Table_Rows);
+    }
+    generate_bitfields(wide_bits, records, record_count);
+    generate_bitfields(bits, records, record_count);
+    classify(wide_masks, wide_outputs, Table_Cols, ids, wide_bits, record_count);
+    classify(masks, outputs, Table_Cols, ids, bits, record_count);
+    bool match = table_equal(&tables[0], &tables[3]) && table_equal(&tables[1], &tables[4]) && table_equal(&tables[2], &tables[5]);
+    for (size_t t = 0; t < 6; ++t)
+    {
+        table_free(&tables[t]);
+    }
+    free(bits);
+    free(wide_bits);
+    return match;
+}
+
+/// @summary Measures classify() throughput for each supported bitfield width.
+/// @param column_count The number of columns in the random condition tables.
+/// @param record_count The number of random bitfields to classify.
+/// @param iterations The number of times to classify the bitfields.
+static void benchmark_bitfield_widths(size_t column_count, size_t record_count, size_t iterations)
+{
+    printf("Bitfield width throughput (%u records, %u columns):\n", (uint32_t) record_count, (uint32_t) column_count);
+    benchmark_bitfield_width<uint32_t >(column_count, record_count, iterations);
+    benchmark_bitfield_width<uint64_t >(column_count, record_count, iterations);
+    benchmark_bitfield_width<bits128_t>(column_count, record_count, iterations);
+    benchmark_bitfield_width<bits256_t>(column_count, record_count, iterations);
+}
+
+/// @summary Computes the output of the compiled-in condition table under the
+/// first or priority hit policy, one record and one column at a time, to check
+/// classify_hit_policy() against.
+/// @param policy HIT_POLICY_FIRST or HIT_POLICY_PRIORITY.
+/// @param bits An array of bitfields computed for each record in All_IDs.
+/// @param record_count The number of records.
+/// @param expected Three tables, indexed by action_e, that receive the IDs.
+static void hit_policy_reference(hit_policy_e policy, uint32_t const *bits, size_t record_count, table_t *expected)
+{
+    for (size_t a = 0; a < ACTION_COUNT; ++a)
+    {
+        table_clear(&expected[a]);
+    }
+    for (size_t i = 0; i < record_count; ++i)
+    {
+        size_t winner = Table_Cols;
+        for (size_t a = 0; a < ACTION_COUNT && winner == Table_Cols; ++a)
+        {
+            for (size_t j = 0; j < Table_Cols && winner == Table_Cols; ++j)
+            {
+                // first considers every column on the first pass; priority
+                // considers only the columns of one action per pass.
+                bool candidate = (policy == HIT_POLICY_FIRST) || (Condition_Actions[j] == (action_e) a);
+                bool met       = ((bits[i] ^ Table_Mask[j].bits_false) | Table_Mask[j].bits_ignore) == 0xFFFFFFFFU;
+                if (candidate && met) winner = j;
+            }
+        }
+        if (winner != Table_Cols)
+        {
+            table_put(&expected[Condition_Actions[winner]], All_IDs.storage[i]);
+        }
+    }
+}
+
+/// @summary Determines whether the output tables match a set of reference results.
+/// @param reference The expected contents of Output_Reject, Output_Manual and Output_Immediate.
+/// @return true if all three output tables match.
+static bool outputs_match(table_t const *reference)
+{
+    return table_equal(&Output_Reject   , &reference[0]) &&
+           table_equal(&Output_Manual   , &reference[1]) &&
+           table_equal(&Output_Immediate, &reference[2]);
+}
+
+/// @summary Determines whether the output tables contain the same IDs as a set
+/// of reference results, ignoring order.
+/// @param reference The expected contents of Output_Reject, Output_Manual and Output_Immediate.
+/// @return true if all three output tables contain the same IDs.
+static bool outputs_match_unordered(table_t const *reference)
+{
+    table_t const *actual[3] = { &Output_Reject, &Output_Manual, &Output_Immediate };
+    bool           match     = true;
+    for (size_t t = 0; t < 3 && match; ++t)
+    {
+        std::vector<id_t> a(actual[t]->storage, actual[t]->storage + actual[t]->count);
+        std::vector<id_t> b(reference[t].storage, reference[t].storage + reference[t].count);
+        std::sort(a.begin(), a.end());
+        std::sort(b.begin(), b.end());
+        match = (a == b);
+    }
+    return match;
+}
+
+/// @summary Builds a benchmark kernel name of the form group/variant, in
+/// lower case with spaces replaced by dashes, so it can be typed on the
+/// command line.
+/// @param group The kernel group, for example "simd".
+/// @param variant The kernel variant, for example "AVX2".
+/// @return The kernel name.
+static std::string bench_name(char const *group, char const *variant)
+{
+    std::string name = std::string(group) + "/" + variant;
+    for (size_t i = 0; i < name.size(); ++i)
+    {
+        char c  = name[i];
+        name[i] = (c == ' ') ? '-' : (char) tolower((unsigned char) c);
+    }
+    return name;
+}
+
+/// @summary Prints the outcome of a benchmarked kernel: its median time, the
+/// output table counts, and the result of a correctness check. Call bench_run
+/// in its own statement first: written as bench_report(bench_run(...), check),
+/// the check may be evaluated before the kernel runs, since the order in which
+/// arguments are evaluated is unspecified.
+/// @param result The result returned by bench_run, or NULL if the kernel did not run.
+/// @param match The result of comparing the output against the reference,
+/// computed after the kernel ran.
+/// @param against A description of the reference.
+static void bench_report(bench_result_t *result, bool match, char const *against)
+{
+    if (result == NULL)
+        return;
+
+    bench_stats_t stats;
+    // every kernel writes the output tables; count those writes as traffic.
+    result->bytes += (Output_Reject.count + Output_Manual.count + Output_Immediate.count) * sizeof(id_t);
+    bench_compute_stats(result, &stats);
+    printf("%s: %" PRIu64 " ns median.\n", result->name.c_str(), stats.median_ns);
+    printf("Reject:    %u.\n", (uint32_t) Output_Reject.count);
+    printf("Manual:    %u.\n", (uint32_t) Output_Manual.count);
+    printf("Immediate: %u.\n", (uint32_t) Output_Immediate.count);
+    if (against != NULL)
+        printf("Output %s %s.\n", match ? "matches" : "DOES NOT MATCH", against);
+    printf("\n");
+}
+
+/// @summary Returns the median duration of a benchmarked kernel in seconds.
+/// @param results The benchmark results.
+/// @param name The kernel name.
+/// @return The median duration, or zero if the kernel did not run.
+static double bench_median_sec(std::vector<bench_result_t> const &results, std::string const &name)
+{
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        if (results[i].name == name)
+        {
+            bench_stats_t stats;
+            bench_compute_stats(&results[i], &stats);
+            return double(stats.median_ns) / double(NANOS_PER_SECOND);
+        }
+    }
+    return 0.0;
+}
+
+int main(int argc, char **argv)
+{
+    size_t       record_count   = 40000000;
+    size_t       thread_count   = 0; // zero => use all hardware threads
+    size_t       numa_nodes     = 0; // zero => detect the NUMA topology
+    stream_config_t stream_config;
+    stream_config.batch_size = 64;
+    stream_config.flush_ns   = 20 * NANOS_PER_USEC;
+    stream_config.producers  = 1;
+    stream_config.workers    = 1;
+    stream_config.rate       = 0;
+    size_t       block_size     = 0; // zero => use Fused_Block_Size
+    char const  *table_path     = NULL;
+    char const  *cache_dir      = "";
+    char const  *json_path      = NULL;
+    char const  *load_path      = NULL;
+    char const  *save_path      = NULL;
+    char const  *adaptive_log   = NULL;
+
+    generator_params_t gen;
+    generator_params_init(&gen, 1);
+
+    bench_config_t config;
+    config.iterations   = 10;
+    config.warmups      = 1;
+    config.use_counters = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            thread_count = (size_t) strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--numa-nodes") == 0 && i + 1 < argc)
+        {
+            numa_nodes = (size_t) strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--stream-batch") == 0 && i + 1 < argc)
+        {
+            stream_config.batch_size = (size_t) strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--stream-flush-us") == 0 && i + 1 < argc)
+        {
+            stream_config.flush_ns = (uint64_t) strtoull(argv[++i], NULL, 10) * NANOS_PER_USEC;
+        }
+        else if (strcmp(argv[i], "--stream-producers") == 0 && i + 1 < argc)
+        {
+            stream_config.producers = (size_t) strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--stream-workers") == 0 && i + 1 < argc)
+        {
+            stream_config.workers = (size_t) strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--stream-rate") == 0 && i + 1 < argc)
+        {
+            stream_config.rate = (uint64_t) strtoull(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--adaptive-log") == 0 && i + 1 < argc)
+        {
+            adaptive_log = argv[++i];
+        }
+        else if (strcmp(argv[i], "--block") == 0 && i + 1 < argc)
+        {
+            block_size = (size_t) strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--table") == 0 && i + 1 < argc)
+        {
+            table_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc)
+        {
+            cache_dir = argv[++i];
+        }
+        else if (strcmp(argv[i], "--records") == 0 && i + 1 < argc)
+        {
+            record_count = (size_t) strtoull(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc)
+        {
+            config.iterations = (size_t) strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--warmups") == 0 && i + 1 < argc)
+        {
+            config.warmups = (size_t) strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--kernel") == 0 && i + 1 < argc)
+        {
+            // a comma-separated list of kernel names or groups.
+            char const *list = argv[++i];
+            while (*list)
+            {
+                char const *end = strchr(list, ',');
+                size_t      len = end ? (size_t)(end - list) : strlen(list);
+                if (len > 0) config.kernels.push_back(std::string(list, len));
+                list += end ? len + 1 : len;
+            }
+        }
+        else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+        {
+            json_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+        {
+            gen.seed = (uint64_t) strtoull(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--null-address") == 0 && i + 1 < argc)
+        {
+            gen.null_address = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--null-identity") == 0 && i + 1 < argc)
+        {
+            gen.null_identity = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--home-owner") == 0 && i + 1 < argc)
+        {
+            gen.home_owner = atof(argv[++i]);
+        }
+        else if ((strcmp(argv[i], "--salary") == 0 || strcmp(argv[i], "--loan") == 0) && i + 1 < argc)
+        {
+            // DIST[:MIN:MAX], for example normal:20000:150000.
+            bool           salary = strcmp(argv[i], "--salary") == 0;
+            char const    *spec   = argv[++i];
+            distribution_e dist   = DISTRIBUTION_COUNT;
+            for (int d = 0; d < DISTRIBUTION_COUNT; ++d)
+            {
+                size_t len = strlen(Distribution_Names[d]);
+                if (strncmp(spec, Distribution_Names[d], len) == 0 && (spec[len] == 0 || spec[len] == ':'))
+                    dist = (distribution_e) d;
+            }
+            unsigned int min = salary ? gen.salary_min : gen.loan_min;
+            unsigned int max = salary ? gen.salary_max : gen.loan_max;
+            char const  *range = strchr(spec, ':');
+            if (dist == DISTRIBUTION_COUNT || (range != NULL && (sscanf(range, ":%u:%u", &min, &max) != 2 || min > max)))
+            {
+                printf("ERROR: Expected uniform|normal[:MIN:MAX], got '%s'.\n", spec);
+                return 1;
+            }
+            if (salary) { gen.salary_distribution = dist; gen.salary_min = min; gen.salary_max = max; }
+            else        { gen.loan_distribution   = dist; gen.loan_min   = min; gen.loan_max   = max; }
+        }
+        else if (strcmp(argv[i], "--cluster") == 0 && i + 1 < argc)
+        {
+            gen.cluster_size = (size_t) strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--sorted-salary") == 0)
+        {
+            gen.sorted_salary = true;
+        }
+        else if (strcmp(argv[i], "--load-records") == 0 && i + 1 < argc)
+        {
+            load_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--save-records") == 0 && i + 1 < argc)
+        {
+            save_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--perf") == 0)
+        {
+            config.use_counters = true;
+        }
+        else if (strcmp(argv[i], "--pages") == 0 && i + 1 < argc)
+        {
+            char const *policy = argv[++i];
+            int         p      = 0;
+            while (p < PAGE_POLICY_COUNT && strcmp(policy, Page_Policy_Names[p]) != 0)
+            {
+                ++p;
+            }
+            if (p == PAGE_POLICY_COUNT)
+            {
+                printf("ERROR: unknown page policy '%s'; expected small or huge.\n", policy);
+                return 1;
+            }
+            Page_Policy = (page_policy_e) p;
+        }
+        else
+        {
+            printf("Usage: condtbl [--records N] [--iterations N] [--warmups N] [--kernel LIST] [--json FILE] [--perf]\n");
+            printf("               [--seed N] [--null-address F] [--null-identity F] [--home-owner F]\n");
+            printf("               [--salary DIST[:MIN:MAX]] [--loan DIST[:MIN:MAX]] [--cluster N] [--sorted-salary]\n");
+            printf("               [--load-records FILE] [--save-records FILE]\n");
+            printf("               [--threads N] [--block N] [--table FILE] [--cache DIR] [--pages small|huge]\n");
+            printf("               [--numa-nodes N] [--stream-batch N] [--stream-flush-us N] [--stream-producers N]\n");
+            printf("               [--stream-workers N] [--stream-rate N] [--adaptive-log FILE]\n");
+            return 1;
+        }
+    }
+    if (record_count == 0 || config.iterations == 0)
+    {
+        printf("ERROR: --records and --iterations must be greater than zero.\n");
+        return 1;
+    }
+    Page_Touch_Threads = thread_count ? thread_count : std::max<size_t>(1, std::thread::hardware_concurrency());
+    if (config.use_counters)
+    {
+        if (!perf_counters_open(&config.counters))
+            printf("Hardware counters are unavailable; continuing without them.\n");
+    }
+    else
+    {
+        for (size_t i = 0; i < PERF_COUNTER_COUNT; ++i)
+        {
+            config.counters.fd[i] = -1;
+        }
+        config.counters.available = false;
+    }
+
+    // map a saved record set, if one was specified; it replaces the generator.
+    record_file_t record_file;
+    memset(&record_file, 0, sizeof(record_file));
+    if (load_path != NULL)
+    {
+        char          error[256];
+        bench_timer_t map_time;
+        timer_start(&map_time);
+        if (!record_file_open(&record_file, load_path, error, sizeof(error)))
+        {
+            printf("ERROR: %s\n", error);
+            return 1;
+        }
+        timer_stop(&map_time);
+        record_count = record_file.store.count;
+        printf("Mapped %u records from %s in %.1f us.\n", (uint32_t) record_count, load_path, double(duration(&map_time)) / 1000.0);
+        if (record_count == 0)
+        {
+            printf("ERROR: %s contains no records.\n", load_path);
+            return 1;
+        }
+    }
+
+    // a record can be written once by each column that targets a table.
+    table_init(&Output_Immediate, (uint32_t)(record_count * 2));
+    table_init(&Output_Manual   , (uint32_t)(record_count * 1));
+    table_init(&Output_Reject   , (uint32_t)(record_count * 2));
+    table_init(&All_IDs         , (uint32_t) record_count);
+    memory_touch(All_IDs.storage, record_count * sizeof(id_t));
+
+    // generate some records, or copy the mapped records into the in-memory
+    // layouts used by the array of structures and comparison kernels.
+    bench_timer_t generate_records_time;
+    timer_start(&generate_records_time);
+    Records.resize(record_count);
+    if (load_path != NULL)
+    {
+        printf("Copying %u mapped records for the comparison kernels...", (uint32_t) record_count);
+        fflush(stdout);
+        for (size_t i = 0; i < record_count; ++i)
+        {
+            record_file_get(&record_file, i, &Records[i]);
+        }
+        memcpy(All_IDs.storage, record_file.store.id, record_count * sizeof(id_t));
+    }
+    else
+    {
+        printf("Generating test data of %u records (seed %" PRIu64 ")...", (uint32_t) record_count, gen.seed);
+        fflush(stdout);
+        generate_records_parallel(&Records[0], All_IDs.storage, record_count, Next_ID, &gen, thread_count);
+        Next_ID += (id_t) record_count;
+    }
+    All_IDs.count = record_count;
+    timer_stop(&generate_records_time);
+    printf("DONE (%f seconds).\n", duration_sec(&generate_records_time));
+    if (save_path != NULL)
+    {
+        bench_timer_t save_time;
+        timer_start(&save_time);
+        bool saved = record_file_write(save_path, &Records[0], record_count);
+        timer_stop(&save_time);
+        if (!saved)
+        {
+            printf("ERROR: Unable to write record file %s.\n", save_path);
+            return 1;
+        }
+        printf("Saved %u records to %s in %f seconds.\n", (uint32_t) record_count, save_path, duration_sec(&save_time));
+    }
+
+    // convert to structure-of-arrays form.
+    record_store_build(&Record_Store, &Records[0], Records.size());
+
+    std::vector<bench_result_t> results;
+    auto no_reset      = [](){};
+    auto reset_outputs = []()
+    {
+        table_clear(&Output_Reject);
+        table_clear(&Output_Manual);
+        table_clear(&Output_Immediate);
+    };
+    uint64_t const bitfield_bytes = record_count * sizeof(uint32_t);
+    uint64_t const classify_bytes = record_count * (sizeof(uint32_t) + sizeof(id_t));
+
+    // perform one-time preprocessing, comparing the record layouts.
+    uint32_t *bitfields     = (uint32_t*) memory_alloc(bitfield_bytes);
+    uint32_t *bitfields_aos = (uint32_t*) memory_alloc(bitfield_bytes);
+    memory_touch(bitfields    , bitfield_bytes);
+    memory_touch(bitfields_aos, bitfield_bytes);
+    generate_bitfields(bitfields_aos, &Records[0], Records.size());
+    generate_bitfields(bitfields, &Record_Store, 0, Record_Store.count);
+    bench_run(&config, &results, "generate/aos", record_count, record_count * sizeof(record_t) + bitfield_bytes, no_reset, [&]()
+    {
+        generate_bitfields(bitfields_aos, &Records[0], Records.size());
+    });
+    bench_run(&config, &results, "generate/soa", record_count, uint64_t(double(record_count) * record_store_bytes_per_record()) + bitfield_bytes, no_reset, [&]()
+    {
+        generate_bitfields(bitfields, &Record_Store, 0, Record_Store.count);
+    });
+    if (load_path != NULL)
+    {
+        // zero-copy: predicates are evaluated straight from the mapped columns.
+        uint32_t *bitfields_mapped = (uint32_t*) memory_alloc(bitfield_bytes);
+        bench_run(&config, &results, "generate/mapped", record_count, uint64_t(double(record_count) * record_store_bytes_per_record()) + bitfield_bytes, no_reset, [&]()
+        {
+            generate_bitfields(bitfields_mapped, &record_file.store, 0, record_file.store.count);
+        });
+        generate_bitfields(bitfields_mapped, &record_file.store, 0, record_file.store.count);
+        printf("Bitfields from mapped columns %s.\n", memcmp(bitfields, bitfields_mapped, record_count * sizeof(uint32_t)) == 0 ? "match" : "DO NOT MATCH");
+        memory_free(bitfields_mapped, bitfield_bytes);
+    }
+    // maintain bitfields incrementally: a full build, a refresh that finds
+    // nothing changed, and an update after a small batch of modified records.
+    bitfield_index_t index;
+    bitfield_index_init(&index);
+    size_t   delta_first = record_count / 2;
+    size_t   delta_count = (record_count - delta_first) < 1000 ? (record_count - delta_first) : 1000;
+    uint64_t store_bytes = uint64_t(double(record_count) * record_store_bytes_per_record());
+    auto swap_delta_amounts = [&]()
+    {
+        // swapping salary and loan amount flips the loan < salary predicate.
+        for (size_t i = delta_first; i < delta_first + delta_count; ++i)
+        {
+            std::swap(Record_Store.annual_salary[i], Record_Store.loan_amount[i]);
+        }
+    };
+    bench_run(&config, &results, "index/build", record_count, store_bytes + bitfield_bytes, [&]() { bitfield_index_init(&index); }, [&]()
+    {
+        bitfield_index_refresh(&index, &Record_Store, 0);
+    });
+    bitfield_index_refresh(&index, &Record_Store, 0);
+    bench_run(&config, &results, "index/refresh", record_count, store_bytes, no_reset, [&]()
+    {
+        bitfield_index_refresh(&index, &Record_Store, 0);
+    });
+    swap_delta_amounts();
+    bench_run(&config, &results, "index/update", delta_count, delta_count * (record_store_bytes_per_record() + sizeof(uint32_t)), no_reset, [&]()
+    {
+        bitfield_index_update(&index, &Record_Store, delta_first, delta_count);
+    });
+    bitfield_index_update(&index, &Record_Store, delta_first, delta_count);
+    {
+        std::vector<uint32_t> expected(record_count);
+        generate_bitfields(&expected[0], &Record_Store, 0, record_count);
+        bool   update_match = memcmp(&expected[0], &index.bits[0], record_count * sizeof(uint32_t)) == 0;
+        swap_delta_amounts();
+        size_t recomputed   = bitfield_index_refresh(&index, &Record_Store, 0);
+        bool   refresh_match = memcmp(bitfields, &index.bits[0], record_count * sizeof(uint32_t)) == 0;
+        printf("Bitfield index %s after updating %u records; refresh after reverting recomputed %u of %u blocks and %s.\n",
+            update_match ? "matches" : "DOES NOT MATCH", (uint32_t) delta_count, (uint32_t) recomputed, (uint32_t) index.stamps.size(),
+            refresh_match ? "matches" : "DOES NOT MATCH");
+    }
+    if (load_path != NULL)
+    {
+        // the index for a record file is kept next to it, and only the blocks
+        // that changed since it was written are recomputed.
+        std::string   index_path = std::string(load_path) + ".bits";
+        size_t        recomputed = 0;
+        bench_timer_t index_time;
+        timer_start(&index_time);
+        bool saved = bitfield_index_load(index_path.c_str(), &record_file.store, &index, &recomputed);
+        timer_stop(&index_time);
+        printf("Bitfield index %s: %u of %u blocks recomputed in %f seconds%s; bitfields %s.\n", index_path.c_str(),
+            (uint32_t) recomputed, (uint32_t) index.stamps.size(), duration_sec(&index_time), saved ? "" : " (NOT SAVED)",
+            memcmp(bitfields, &index.bits[0], record_count * sizeof(uint32_t)) == 0 ? "match" : "DO NOT MATCH");
+    }
+    bitfield_index_init(&index);
+    printf("Generate bitfields (AoS): %u bytes per record.\n", (uint32_t) sizeof(record_t));
+    printf("Generate bitfields (SoA): %.3f bytes per record.\n", record_store_bytes_per_record());
+    printf("Bitfields %s.\n\n", memcmp(bitfields, bitfields_aos, record_count * sizeof(uint32_t)) == 0 ? "match" : "DO NOT MATCH");
+    memory_free(bitfields_aos, bitfield_bytes);
+    for (size_t i = 0; i < Table_Cols; ++i)
+    {
+        build_column_mask(&Table_Mask[i], Condition_Table[i], Table_Rows);
+    }
+
+    table_t *outputs[] = {
+        &Output_Reject,
+        &Output_Reject,
+        &Output_Immediate,
+        &Output_Immediate,
+        &Output_Manual
+    };
+
+    // keep the scalar results so the other kernels can be checked against them.
+    table_t reference[3];
+    reset_outputs();
+    classify(Table_Mask, outputs, Table_Cols, All_IDs.storage, bitfields, record_count);
+    table_init(&reference[0]); table_copy(&reference[0], &Output_Reject);
+    table_init(&reference[1]); table_copy(&reference[1], &Output_Manual);
+    table_init(&reference[2]); table_copy(&reference[2], &Output_Immediate);
+
+    // and the expected results of the first and priority hit policies.
+    table_t first_reference[ACTION_COUNT];
+    table_t priority_reference[ACTION_COUNT];
+    for (size_t a = 0; a < ACTION_COUNT; ++a)
+    {
+        table_init(&first_reference[a]);
+        table_init(&priority_reference[a]);
+    }
+    hit_policy_reference(HIT_POLICY_FIRST   , bitfields, record_count, first_reference);
+    hit_policy_reference(HIT_POLICY_PRIORITY, bitfields, record_count, priority_reference);
+
+    // each kernel's output is checked in a separate statement, after it has run.
+    bench_result_t *run = NULL;
+    run = bench_run(&config, &results, "classify/branchy", record_count, record_count * sizeof(record_t), reset_outputs, [&]()
+    {
+        for (size_t i = 0; i < record_count; ++i)
+        {
+            check_record(&Records[i], outputs);
+        }
+    });
+    bench_report(run, outputs_match(reference), "the scalar kernel");
+
+    run = bench_run(&config, &results, "classify/branchless", record_count, classify_bytes, reset_outputs, [&]()
+    {
+        classify(Table_Mask, outputs, Table_Cols, All_IDs.storage, bitfields, record_count);
+    });
+    bench_report(run, outputs_match(reference), "the scalar kernel");
+
+    run = bench_run(&config, &results, "specialized/branchless", record_count, classify_bytes, reset_outputs, [&]()
+    {
+        classify_specialized<condition_table_spec_t>(outputs, All_IDs.storage, bitfields, record_count);
+    });
+    bench_report(run, outputs_match(reference), "the scalar kernel");
+
+    simd_level_e simd_level = detect_simd_level();
+    simd_init();
+    for (int level = SIMD_LEVEL_SCALAR + 1; level <= simd_level; ++level)
+    {
+        run = bench_run(&config, &results, bench_name("simd", Simd_Level_Names[level]).c_str(), record_count, classify_bytes, reset_outputs, [&]()
+        {
+            Classify_Kernels[level](Table_Mask, outputs, Table_Cols, All_IDs.storage, bitfields, record_count);
+        });
+        bench_report(run, outputs_match(reference), "the scalar kernel");
+    }
+
+    // classify into selection vectors, reading only the bitfields. Dense IDs
+    // are the positions offset by the first ID, so nothing is looked up;
+    // otherwise positions are converted to IDs after the scan.
+    bool     implicit_ids = ids_dense(All_IDs.storage, record_count);
+    uint32_t first_id     = (implicit_ids && record_count) ? All_IDs.storage[0] : 0;
+    auto materialize_outputs = [&]()
+    {
+        selection_materialize(&Output_Reject   , All_IDs.storage);
+        selection_materialize(&Output_Manual   , All_IDs.storage);
+        selection_materialize(&Output_Immediate, All_IDs.storage);
+    };
+    for (int level = SIMD_LEVEL_SCALAR; level <= simd_level; ++level)
+    {
+        run = bench_run(&config, &results, bench_name("select", Simd_Level_Names[level]).c_str(), record_count, bitfield_bytes, reset_outputs, [&]()
+        {
+            Select_Kernels[level](Table_Mask, outputs, Table_Cols, first_id, bitfields, record_count);
+            if (!implicit_ids) materialize_outputs();
+        });
+        bench_report(run, outputs_match(reference), "the scalar kernel");
+    }
+    run = bench_run(&config, &results, "select/materialize", record_count, bitfield_bytes, reset_outputs, [&]()
+    {
+        Select_Kernels[simd_level](Table_Mask, outputs, Table_Cols, 0, bitfields, record_count);
+        materialize_outputs();
+    });
+    bench_report(run, outputs_match(reference), "the scalar kernel");
+
+    // a two-stage filter: the first stage selects the records with both proofs,
+    // and the second classifies the approval columns for the survivors only.
+    // The -generate variants also evaluate the predicates; there the first
+    // stage evaluates only the proof predicates, a block at a time, and the
+    // second evaluates the rest for the block's survivors.
+    if (bench_selected(&config, "select"))
+    {
+        static const rule_e Both_Proofs[Table_Rows] = { CONDITION_TRUE, CONDITION_TRUE, CONDITION_NULL, CONDITION_NULL, CONDITION_NULL };
+        query_mask_t both_proofs;
+        selection_t  survivors;
+        selection_t *survivor_output  = &survivors;
+        uint32_t    *stage_bits       = (uint32_t*) memory_alloc(bitfield_bytes);
+        memory_touch(stage_bits, bitfield_bytes);
+        build_column_mask(&both_proofs, Both_Proofs, Table_Rows);
+        table_init(&survivors, (uint32_t) record_count);
+        auto reset_stages = [&]()
+        {
+            reset_outputs();
+            table_clear(&survivors);
+        };
+        auto approvals_match = [&]()
+        {
+            return table_equal(&Output_Manual, &reference[1]) && table_equal(&Output_Immediate, &reference[2]);
+        };
+        run = bench_run(&config, &results, "select/one-stage", record_count, classify_bytes, reset_stages, [&]()
+        {
+            Classify_Kernels[simd_level](&Table_Mask[2], &outputs[2], Table_Cols - 2, All_IDs.storage, bitfields, record_count);
+        });
+        bench_report(run, approvals_match(), "the scalar kernel");
+        run = bench_run(&config, &results, "select/two-stage", record_count, bitfield_bytes, reset_stages, [&]()
+        {
+            Select_Kernels[simd_level](&both_proofs, &survivor_output, 1, 0, bitfields, record_count);
+            classify_selection(Classify_Kernels[simd_level], &Table_Mask[2], &outputs[2], Table_Cols - 2, &survivors, bitfields, stage_bits);
+            selection_materialize(&Output_Manual   , All_IDs.storage);
+            selection_materialize(&Output_Immediate, All_IDs.storage);
+        });
+        bench_report(run, approvals_match(), "the scalar kernel");
+        run = bench_run(&config, &results, "select/one-stage-generate", record_count, store_bytes + classify_bytes, reset_stages, [&]()
+        {
+            generate_bitfields(stage_bits, &Record_Store, 0, record_count);
+            Classify_Kernels[simd_level](&Table_Mask[2], &outputs[2], Table_Cols - 2, All_IDs.storage, stage_bits, record_count);
+        });
+        bench_report(run, approvals_match(), "the scalar kernel");
+        run = bench_run(&config, &results, "select/two-stage-generate", record_count, store_bytes + bitfield_bytes, reset_stages, [&]()
+        {
+            for (size_t i = 0; i < record_count; i += Fused_Block_Size)
+            {
+                // the second stage runs on each block's survivors while the block is in cache.
+                size_t      n     = (record_count - i) < Fused_Block_Size ? (record_count - i) : Fused_Block_Size;
+                selection_t fresh = survivors;
+                generate_predicates(stage_bits, &Record_Store, i, n, (1U << PROOF_OF_ADDRESS) | (1U << PROOF_OF_IDENTITY));
+                Select_Kernels[simd_level](&both_proofs, &survivor_output, 1, (uint32_t) i, stage_bits, n);
+                fresh.storage = survivors.storage + fresh.count;
+                fresh.count   = survivors.count   - fresh.count;
+                generate_bitfields_selected(stage_bits, &Record_Store, &fresh);
+                Classify_Kernels[simd_level](&Table_Mask[2], &outputs[2], Table_Cols - 2, fresh.storage, stage_bits, fresh.count);
+            }
+            selection_materialize(&Output_Manual   , All_IDs.storage);
+            selection_materialize(&Output_Immediate, All_IDs.storage);
+        });
+        bench_report(run, approvals_match(), "the scalar kernel");
+        printf("Selection: IDs are %s; %u of %u records (%.1f%%) survive the first stage.\n", implicit_ids ? "implicit in positions" : "looked up by position",
+            (uint32_t) survivors.count, (uint32_t) record_count, record_count ? 100.0 * double(survivors.count) / double(record_count) : 0.0);
+        table_free(&survivors);
+        memory_free(stage_bits, bitfield_bytes);
+    }
+
+    // measure the cost of telemetry: the best kernel and the bitfield generator
+    // with and without their counters, then check one counted pass.
+    if (bench_selected(&config, "telemetry"))
+    {
+        size_t    classify_id    = telemetry_kernel_id(bench_name("classify", Simd_Level_Names[simd_level]).c_str());
+        size_t    generate_id    = telemetry_kernel_id("generate/soa");
+        uint32_t *telemetry_bits = (uint32_t*) memory_alloc(bitfield_bytes);
+        memory_touch(telemetry_bits, bitfield_bytes);
+        static char const *pairs[2][2] =
+        {
+            { "telemetry/classify-off", "telemetry/classify-on" },
+            { "telemetry/generate-off", "telemetry/generate-on" }
+        };
+        run = bench_run(&config, &results, pairs[0][0], record_count, classify_bytes, reset_outputs, [&]()
+        {
+            Classify_Kernels[simd_level](Table_Mask, outputs, Table_Cols, All_IDs.storage, bitfields, record_count);
+        });
+        bench_report(run, outputs_match(reference), "the scalar kernel");
+        run = bench_run(&config, &results, pairs[0][1], record_count, classify_bytes, reset_outputs, [&]()
+        {
+            classify_counted(classify_id, simd_level, Table_Mask, outputs, Table_Cols, All_IDs.storage, bitfields, record_count);
+        });
+        bench_report(run, outputs_match(reference), "the scalar kernel");
+        bench_run(&config, &results, pairs[1][0], record_count, store_bytes + bitfield_bytes, no_reset, [&]()
+        {
+            generate_bitfields(telemetry_bits, &Record_Store, 0, record_count);
+        });
+        bench_run(&config, &results, pairs[1][1], record_count, store_bytes + bitfield_bytes, no_reset, [&]()
+        {
+            generate_bitfields_counted(generate_id, telemetry_bits, &Record_Store, 0, record_count);
+        });
+        for (size_t k = 0; k < 2; ++k)
+        {
+            double off = bench_median_sec(results, pairs[k][0]);
+            double on  = bench_median_sec(results, pairs[k][1]);
+            if (off > 0.0 && on > 0.0)
+            {
+                // counting only adds work, so a counted pass that runs faster
+                // than the plain one is noise or code placement, not a pass.
+                double overhead = (on - off) / off;
+                printf("Telemetry overhead (%s): %+.1f%%, %s the %.0f%% limit.\n", k == 0 ? "classify" : "generate", 100.0 * overhead,
+                    overhead < 0.0 ? "a bad measurement against" : overhead < Telemetry_Max_Overhead ? "within" : "EXCEEDS", 100.0 * Telemetry_Max_Overhead);
+            }
+        }
+
+        // the counts over one pass must agree with the outputs and the bitfields.
+        telemetry_snapshot_t before, after, delta;
+        uint64_t             expected_bits[Condition_Name_Count] = { 0 };
+        uint64_t             expected_hits[Table_Cols] = { 0 };
+        telemetry_snapshot(&before);
+        reset_outputs();
+        generate_bitfields_counted(generate_id, telemetry_bits, &Record_Store, 0, record_count);
+        classify_counted(classify_id, simd_level, Table_Mask, outputs, Table_Cols, All_IDs.storage, telemetry_bits, record_count);
+        telemetry_snapshot(&after);
+        telemetry_delta(&delta, &before, &after);
+        for (size_t i = 0; i < record_count; ++i)
+        {
+            for (size_t b = 0; b < Condition_Name_Count; ++b)
+                expected_bits[b] += (bitfields[i] >> b) & 1;
+        }
+        // the head of each table is counted from the table's growth, so check
+        // every column against an independent count as well as the totals.
+        count_column_hits(Table_Mask, Table_Cols, telemetry_bits, record_count, expected_hits);
+        bool counts_match = delta.column_hits[0] + delta.column_hits[1] == Output_Reject.count &&
+                            delta.column_hits[2] + delta.column_hits[3] == Output_Immediate.count &&
+                            delta.column_hits[4] == Output_Manual.count;
+        for (size_t j = 0; j < Table_Cols; ++j)
+        {
+            counts_match = counts_match && delta.column_hits[j] == expected_hits[j];
+        }
+        for (size_t b = 0; b < Condition_Name_Count; ++b)
+        {
+            counts_match = counts_match && delta.condition_bits[b] == expected_bits[b];
+        }
+        telemetry_print(&delta, Table_Cols);
+        printf("Telemetry counts %s the outputs and bitfields.\n", counts_match ? "match" : "DO NOT MATCH");
+        memory_free(telemetry_bits, bitfield_bytes);
+    }
+
+    // rerun the best kernel with its inputs and outputs on each page size;
+    // compare the tlbmiss/rec column under --perf.
+    for (int policy = 0; policy < PAGE_POLICY_COUNT; ++policy)
+    {
+        std::string name = bench_name("pages", Page_Policy_Names[policy]);
+        if (!bench_selected(&config, name.c_str()))
+        {
+            continue;
+        }
+        page_policy_e saved_policy = Page_Policy;
+        table_t       page_outputs[3];
+        Page_Policy = (page_policy_e) policy;
+        uint32_t *page_bits = (uint32_t*) memory_alloc(bitfield_bytes);
+        id_t     *page_ids  = (id_t    *) memory_alloc(record_count * sizeof(id_t));
+        memory_touch(page_bits, bitfield_bytes);
+        memory_touch(page_ids , record_count * sizeof(id_t));
+        table_init(&page_outputs[0], (uint32_t)(record_count * 2));
+        table_init(&page_outputs[1], (uint32_t)(record_count * 1));
+        table_init(&page_outputs[2], (uint32_t)(record_count * 2));
+        Page_Policy = saved_policy;
+        memcpy(page_bits, bitfields, bitfield_bytes);
+        memcpy(page_ids , All_IDs.storage, record_count * sizeof(id_t));
+        table_t *page_columns[Table_Cols] = { &page_outputs[0], &page_outputs[0], &page_outputs[2], &page_outputs[2], &page_outputs[1] };
+        bench_result_t *r = bench_run(&config, &results, name.c_str(), record_count, classify_bytes, [&]()
+        {
+            for (size_t t = 0; t < 3; ++t) table_clear(&page_outputs[t]);
+        }, [&]()
+        {
+            Classify_Kernels[simd_level](Table_Mask, page_columns, Table_Cols, page_ids, page_bits, record_count);
+        });
+        bench_report(r, table_equal(&page_outputs[0], &reference[0]) && table_equal(&page_outputs[1], &reference[1]) &&
+            table_equal(&page_outputs[2], &reference[2]), "the scalar kernel");
+        for (size_t t = 0; t < 3; ++t)
+        {
+            table_free(&page_outputs[t]);
+        }
+        memory_free(page_ids , record_count * sizeof(id_t));
+        memory_free(page_bits, bitfield_bytes);
+    }
+
+    // summarize each block of bitfields while generating them, then skip or
+    // bulk-write the blocks the summaries decide. Clustered data (--cluster)
+    // produces blocks that can be decided without reading their bitfields.
+    if (bench_selected(&config, "zonemap"))
+    {
+        zone_map_t   zones;
+        zone_stats_t zone_stats;
+        uint32_t    *zone_bits = (uint32_t*) memory_alloc(bitfield_bytes);
+        memory_touch(zone_bits, bitfield_bytes);
+        zone_map_init(&zones);
+        generate_bitfields(zone_bits, &Record_Store, 0, record_count, &zones);
+        bench_run(&config, &results, "zonemap/generate", record_count, uint64_t(double(record_count) * record_store_bytes_per_record()) + bitfield_bytes, no_reset, [&]()
+        {
+            generate_bitfields(zone_bits, &Record_Store, 0, record_count, &zones);
+        });
+        run = bench_run(&config, &results, "zonemap/classify", record_count, classify_bytes, reset_outputs, [&]()
+        {
+            classify_zone_map(&zones, Classify_Kernels[simd_level], Table_Mask, outputs, Table_Cols, All_IDs.storage, zone_bits, record_count, NULL);
+        });
+        bench_report(run, outputs_match(reference), "the scalar kernel");
+        zone_stats_clear(&zone_stats);
+        reset_outputs();
+        classify_zone_map(&zones, Classify_Kernels[simd_level], Table_Mask, outputs, Table_Cols, All_IDs.storage, zone_bits, record_count, &zone_stats);
+        printf("Zone maps: %u blocks of %u records, bitfields %s; %.1f%% of blocks skipped, %.1f%% written without scanning, %.1f%% of block columns skipped.\n",
+            (uint32_t) zone_stats.blocks, (uint32_t) Zone_Block_Size, memcmp(zone_bits, bitfields, bitfield_bytes) == 0 ? "match" : "DO NOT MATCH",
+            zone_stats.blocks  ? 100.0 * double(zone_stats.skipped) / double(zone_stats.blocks) : 0.0,
+            zone_stats.blocks  ? 100.0 * double(zone_stats.emitted) / double(zone_stats.blocks) : 0.0,
+            zone_stats.columns ? 100.0 * double(zone_stats.column_skipped) / double(zone_stats.columns) : 0.0);
+        zone_map_free(&zones);
+        memory_free(zone_bits, bitfield_bytes);
+    }
+
+    // measure scaling of the parallel classifier from one thread up to the
+    // requested thread count, using the best available kernel.
+    parallel_classify_t parallel;
+    parallel_classify_init(&parallel, thread_count);
+    size_t  max_threads = parallel.thread_count;
+    parallel_classify_free(&parallel);
+
+    std::vector<size_t>      scaling_threads;
+    std::vector<std::string> scaling_names;
+    for (size_t t = 1; ; t *= 2)
+    {
+        if (t > max_threads) t = max_threads;
+        char variant[64];
+        snprintf(variant, sizeof(variant), "%s-t%u", Simd_Level_Names[simd_level], (uint32_t) t);
+        std::string name = bench_name("parallel", variant);
+        parallel_classify_init(&parallel, t);
+        run = bench_run(&config, &results, name.c_str(), record_count, classify_bytes, reset_outputs, [&]()
+        {
+            classify_parallel(&parallel, Classify_Kernels[simd_level], Table_Mask, outputs, Table_Cols, All_IDs.storage, bitfields, record_count);
+        });
+        bench_report(run, outputs_match(reference), "the scalar kernel");
+        parallel_classify_free(&parallel);
+        scaling_threads.push_back(t);
+        scaling_names.push_back(name);
+        if (t == max_threads) break;
+    }
+
+    parallel_classify_init(&parallel, max_threads);
+    run = bench_run(&config, &results, "parallel/branchy", record_count, record_count * sizeof(record_t), reset_outputs, [&]()
+    {
+        check_records_parallel(&parallel, outputs, &Records[0], record_count);
+    });
+    bench_report(run, outputs_match(reference), "the scalar kernel");
+    parallel_classify_free(&parallel);
+
+    // generate bitfields and classify with every node scanning only its own
+    // shard, against the same work over the shared record store.
+    if (bench_selected(&config, "numa"))
+    {
+        numa_partition_t numa;
+        numa_partition_init(&numa, numa_nodes, thread_count, &Records[0], record_count);
+        size_t numa_threads = 0;
+        for (size_t n = 0; n < numa.topology.node_count; ++n)
+        {
+            numa_threads += numa.shards[n].workers.thread_count;
+        }
+        printf("NUMA: %u node(s)%s, %u threads in total; threads %s pinned.\n", (uint32_t) numa.topology.node_count,
+            numa.topology.emulated ? " (emulated)" : "", (uint32_t) numa_threads, numa.pinned ? "are" : "could NOT be");
+        for (size_t n = 0; n < numa.topology.node_count; ++n)
+        {
+            printf("  node %u: %u CPUs, %u workers, records [%u, %u)\n", (uint32_t) n, (uint32_t) numa.topology.cpus[n].size(),
+                (uint32_t) numa.shards[n].workers.thread_count, (uint32_t) numa.shards[n].first, (uint32_t)(numa.shards[n].first + numa.shards[n].count));
+        }
+        uint64_t numa_bytes = uint64_t(double(record_count) * record_store_bytes_per_record()) + record_count * sizeof(id_t) + 2 * bitfield_bytes;
+        run = bench_run(&config, &results, "numa/partitioned", record_count, numa_bytes, reset_outputs, [&]()
+        {
+            classify_numa(&numa, Classify_Kernels[simd_level], Table_Mask, outputs, Table_Cols);
+        });
+        bench_report(run, outputs_match(reference), "the scalar kernel");
+        numa_partition_free(&numa);
+
+        uint32_t *shared_bits = (uint32_t*) memory_alloc(bitfield_bytes);
+        memory_touch(shared_bits, bitfield_bytes);
+        parallel_classify_init(&parallel, numa_threads);
+        run = bench_run(&config, &results, "numa/shared", record_count, numa_bytes, reset_outputs, [&]()
+        {
+            classify_shared(&parallel, Classify_Kernels[simd_level], Table_Mask, outputs, Table_Cols, &Record_Store, shared_bits);
+        });
+        bench_report(run, outputs_match(reference), "the scalar kernel");
+        parallel_classify_free(&parallel);
+        memory_free(shared_bits, bitfield_bytes);
+    }
+
+    // stream applications through the ring, one record at a time, and
+    // measure how long each waits for its decision.
+    if (bench_selected(&config, "stream/ingest"))
+    {
+        size_t   stream_count = record_count < 1000000 ? record_count : 1000000;
+        table_t  stream_reference[3];
+        stream_t stream;
+        for (size_t t = 0; t < 3; ++t)
+        {
+            table_init(&stream_reference[t], (uint32_t)(stream_count * 2));
+        }
+        table_t *reference_outputs[Table_Cols] = { &stream_reference[0], &stream_reference[0], &stream_reference[2], &stream_reference[2], &stream_reference[1] };
+        classify(Table_Mask, reference_outputs, Table_Cols, All_IDs.storage, bitfields, stream_count);
+        stream_init(&stream, &stream_config, Classify_Kernels[simd_level], Table_Mask, outputs, Table_Cols);
+        run = bench_run(&config, &results, "stream/ingest", stream_count, stream_count * sizeof(stream_item_t), reset_outputs, [&]()
+        {
+            stream_run(&stream, &Records[0], stream_count);
+        });
+        bench_report(run, outputs_match_unordered(stream_reference), "the scalar kernel (order by arrival)");
+        printf("Stream of %u records: batch %u, flush %.1f us, %u producer(s), %u worker(s), rate %s.\n",
+            (uint32_t) stream_count, (uint32_t) stream.config.batch_size, double(stream.config.flush_ns) / double(NANOS_PER_USEC),
+            (uint32_t) stream.config.producers, (uint32_t) stream.config.workers,
+            stream.config.rate ? (std::to_string(stream.config.rate) + " records/s").c_str() : "unlimited");
+        printf("Push-to-decision latency (last pass): p50 %.2f us, p99 %.2f us, p99.9 %.2f us, max %.2f us.\n\n",
+            double(latency_histogram_percentile(&stream.latency, 0.50 )) / double(NANOS_PER_USEC),
+            double(latency_histogram_percentile(&stream.latency, 0.99 )) / double(NANOS_PER_USEC),
+            double(latency_histogram_percentile(&stream.latency, 0.999)) / double(NANOS_PER_USEC),
+            double(stream.latency.max_ns) / double(NANOS_PER_USEC));
+        stream_free(&stream);
+        for (size_t t = 0; t < 3; ++t)
+        {
+            table_free(&stream_reference[t]);
+        }
+    }
+
+    // load a condition table at runtime, if one was specified, and classify
+    // with it. Reloads of an unchanged file are served from the caches.
+    if (table_path != NULL)
+    {
+        table_cache_t    cache;
+        table_cache_t    cold_cache;
+        prepared_table_t table;
+        table_source_e   source;
+        char             error[256];
+        bench_timer_t    load_time;
+        cache.directory      = cache_dir;
+        cold_cache.directory = cache_dir;
+        for (int attempt = 0; attempt < 3; ++attempt)
+        {
+            // the third load uses a fresh cache object to measure a disk cache hit.
+            table_cache_t *c = (attempt == 2) ? &cold_cache : &cache;
+            timer_start(&load_time);
+            bool loaded = table_cache_load(c, table_path, &table, &source, error, sizeof(error));
+            timer_stop(&load_time);
+            if (!loaded)
+            {
+                printf("ERROR: %s\n", error);
+                return 1;
+            }
+            printf("Loaded %s (%u rules, %u conditions, %u issues) from %s in %.1f us.\n", table_path,
+                (uint32_t) table.column_count, (uint32_t) table.row_count, (uint32_t) table.issue_count,
+                Table_Source_Names[source], double(duration(&load_time)) / 1000.0);
+        }
+
+        char const           *action_names[]  = { "immediate", "manual", "reject" };
+        table_t              *action_tables[] = { &Output_Immediate, &Output_Manual, &Output_Reject };
+        std::vector<table_t*> table_outputs;
+        if (!prepared_table_bind(&table, action_names, action_tables, 3, &table_outputs, error, sizeof(error)))
+        {
+            printf("ERROR: %s\n", error);
+            return 1;
+        }
+        reset_outputs();
+        if (table.hit_policy == HIT_POLICY_COLLECT)
+            Classify_Kernels[simd_level](&table.masks[0], &table_outputs[0], table.column_count, All_IDs.storage, bitfields, record_count);
+        else // actions are prioritized in declaration order.
+            classify_hit_policy(table.hit_policy, &table.masks[0], &table_outputs[0], table.column_count, &table.column_action[0], All_IDs.storage, bitfields, record_count);
+        printf("Hit policy: %s.\n", Hit_Policy_Names[table.hit_policy]);
+        printf("Reject:    %u.\n", (uint32_t) Output_Reject.count);
+        printf("Manual:    %u.\n", (uint32_t) Output_Manual.count);
+        printf("Immediate: %u.\n", (uint32_t) Output_Immediate.count);
+        if (table.hit_policy == HIT_POLICY_COLLECT)
+            printf("Output %s the compiled-in table.\n", outputs_match(reference) ? "matches" : "differs from");
+
+        // first and priority must agree with the compiled-in table whichever
+        // policy the file names; both tables prioritize actions in the order
+        // they are declared.
+        table_t const *policy_references[2] = { first_reference, priority_reference };
+        hit_policy_e   policies[2]          = { HIT_POLICY_FIRST, HIT_POLICY_PRIORITY };
+        for (size_t p = 0; p < 2; ++p)
+        {
+            reset_outputs();
+            classify_hit_policy(policies[p], &table.masks[0], &table_outputs[0], table.column_count, &table.column_action[0], All_IDs.storage, bitfields, record_count);
+            printf("Output under the %s hit policy %s the compiled-in table.\n", Hit_Policy_Names[policies[p]],
+                outputs_match(policy_references[p]) ? "matches" : "differs from");
+        }
+        printf("\n");
+    }
+
+    // classify against several rulebooks: the compiled-in table and random
+    // tables over the same predicates. Each rulebook on its own needs a full
+    // generate and classify pass; the shared scan evaluates the predicates
+    // once per block and classifies every rulebook from cache.
+    if (bench_selected(&config, "multi"))
+    {
+        static const size_t Multi_Max_Tables = 8;
+        char const         *multi_actions[]  = { "reject", "manual", "immediate" };
+        size_t              multi_count      = record_count < 2000000 ? record_count : 2000000;
+        prepared_table_t    books[Multi_Max_Tables];
+        uint32_t            state            = 0x2545F491U;
+        record_store_t      multi_store      = Record_Store;
+        multi_store.count = multi_count;
+        for (size_t b = 0; b < Multi_Max_Tables; ++b)
+        {
+            std::vector<rule_e>   rules(Table_Cols * Table_Rows);
+            std::vector<uint32_t> actions(Table_Cols);
+            for (size_t j = 0; j < Table_Cols; ++j)
+            {
+                for (size_t i = 0; i < Table_Rows; ++i)
+                {
+                    uint32_t r = xorshift32(&state) % 4;
+                    rules[j * Table_Rows + i] = (b == 0) ? Condition_Table[j][i] : ((r == 0) ? CONDITION_FALSE : ((r == 1) ? CONDITION_TRUE : CONDITION_NULL));
+                }
+                actions[j] = (b == 0) ? (uint32_t) Condition_Actions[j] : (uint32_t)(j % 3);
+            }
+            prepared_table_build(&books[b], &rules[0], &actions[0], Table_Cols, Table_Rows, multi_actions, 3);
+        }
+        table_t   multi_outputs[Multi_Max_Tables][3];
+        table_t   multi_expected[Multi_Max_Tables][3];
+        table_t  *multi_columns[Multi_Max_Tables][Table_Cols];
+        uint32_t *multi_bits = (uint32_t*) memory_alloc(multi_count * sizeof(uint32_t));
+        memory_touch(multi_bits, multi_count * sizeof(uint32_t));
+        for (size_t b = 0; b < Multi_Max_Tables; ++b)
+        {
+            for (size_t a = 0; a < 3; ++a)
+            {
+                table_init(&multi_outputs [b][a]);
+                table_init(&multi_expected[b][a]);
+            }
+            for (size_t j = 0; j < Table_Cols; ++j)
+            {
+                multi_columns[b][j] = &multi_outputs[b][books[b].column_action[j]];
+            }
+        }
+        for (size_t n = 1; n <= Multi_Max_Tables; n *= 2)
+        {
+            char variant[32];
+            auto reset_multi = [&]()
+            {
+                for (size_t b = 0; b < n; ++b)
+                    for (size_t a = 0; a < 3; ++a)
+                        table_clear(&multi_outputs[b][a]);
+            };
+            auto separate_passes = [&]()
+            {
+                for (size_t b = 0; b < n; ++b)
+                {
+                    generate_bitfields(multi_bits, &multi_store, 0, multi_count);
+                    Classify_Kernels[simd_level](&books[b].masks[0], multi_columns[b], Table_Cols, multi_store.id, multi_bits, multi_count);
+                }
+            };
+            snprintf(variant, sizeof(variant), "separate-%u", (uint32_t) n);
+            std::string separate_name = bench_name("multi", variant);
+            bench_run(&config, &results, separate_name.c_str(), multi_count, n * (uint64_t(double(multi_count) * record_store_bytes_per_record()) + 2 * multi_count * sizeof(uint32_t)), reset_multi, separate_passes);
+            reset_multi();
+            separate_passes();
+            for (size_t b = 0; b < n; ++b)
+                for (size_t a = 0; a < 3; ++a)
+                    table_copy(&multi_expected[b][a], &multi_outputs[b][a]);
+
+            multi_query_t mq;
+            multi_query_init(&mq, block_size);
+            for (size_t b = 0; b < n; ++b)
+            {
+                multi_query_add(&mq, &books[b], multi_columns[b]);
+            }
+            snprintf(variant, sizeof(variant), "shared-%u", (uint32_t) n);
+            std::string shared_name = bench_name("multi", variant);
+            run = bench_run(&config, &results, shared_name.c_str(), multi_count, uint64_t(double(multi_count) * record_store_bytes_per_record()) + multi_count * sizeof(id_t), reset_multi, [&]()
+            {
+                multi_query_run(&mq, Classify_Kernels[simd_level], &multi_store);
+            });
+            bool match = true;
+            for (size_t b = 0; b < n; ++b)
+                for (size_t a = 0; a < 3; ++a)
+                    match = match && table_equal(&multi_outputs[b][a], &multi_expected[b][a]);
+            bench_report(run, match, "separate passes");
+            multi_query_free(&mq);
+
+            double separate_sec = bench_median_sec(results, separate_name.c_str());
+            double shared_sec   = bench_median_sec(results, shared_name.c_str());
+            if (separate_sec > 0.0 && shared_sec > 0.0)
+            {
+                printf("Multi-table (%u tables, %u records): shared scan %.3f ms vs separate passes %.3f ms, %.2fx; %.3f ms per table.\n",
+                    (uint32_t) n, (uint32_t) multi_count, shared_sec * 1000.0, separate_sec * 1000.0, separate_sec / shared_sec, shared_sec * 1000.0 / double(n));
+            }
+        }
+        for (size_t b = 0; b < Multi_Max_Tables; ++b)
+        {
+            for (size_t a = 0; a < 3; ++a)
+            {
+                table_free(&multi_outputs [b][a]);
+                table_free(&multi_expected[b][a]);
+            }
+        }
+        memory_free(multi_bits, multi_count * sizeof(uint32_t));
+        printf("\n");
+    }
+
+    // compare the hit policies; a column's priority is the declaration index
+    // of its action, so reject outranks manual outranks immediate.
+    uint32_t column_priorities[Table_Cols];
+    table_t  unique[3];
+    for (size_t j = 0; j < Table_Cols; ++j)
+    {
+        column_priorities[j] = (uint32_t) Condition_Actions[j];
+    }
+    for (size_t t = 0; t < 3; ++t)
+    {
+        // unique output is the collect output with repeated IDs removed.
+        table_init(&unique[t]);
+        table_copy(&unique[t], &reference[t]);
+        unique[t].count = (size_t)(std::unique(unique[t].storage, unique[t].storage + unique[t].count) - unique[t].storage);
+    }
+    for (int policy = 0; policy < HIT_POLICY_COUNT; ++policy)
+    {
+        bench_result_t *r = bench_run(&config, &results, bench_name("policy", Hit_Policy_Names[policy]).c_str(), record_count, classify_bytes, reset_outputs, [&]()
+        {
+            classify_hit_policy((hit_policy_e) policy, Table_Mask, outputs, Table_Cols, column_priorities, All_IDs.storage, bitfields, record_count);
+        });
+        if (policy == HIT_POLICY_COLLECT)
+            bench_report(r, outputs_match(reference), "the scalar kernel");
+        else if (policy == HIT_POLICY_UNIQUE)
+            bench_report(r, outputs_match(unique), "the de-duplicated scalar kernel");
+        else if (policy == HIT_POLICY_FIRST)
+            bench_report(r, outputs_match(first_reference), "the rule-order reference");
+        else
+            bench_report(r, outputs_match(priority_reference), "the action-order reference");
+    }
+
+    // maintain the unique outputs incrementally under a batch of updated
+    // records spread across the record set.
+    incremental_classifier_t inc;
+    size_t                   batch_size = record_count < 5000 ? record_count : 5000;
+    std::vector<record_t>    updates(batch_size);
+    std::vector<record_t>    originals(batch_size);
+    std::vector<uint32_t>    updated_bits(bitfields, bitfields + record_count);
+    generator_params_t       delta_gen = gen;
+    delta_gen.seed = gen.seed + 1;
+    for (size_t i = 0; i < batch_size; ++i)
+    {
+        size_t r = (size_t)((uint64_t) i * record_count / batch_size);
+        generate_records(&updates[i], NULL, r, 1, record_count, 0, &delta_gen);
+        updates[i].id = Records[r].id;
+        originals[i]  = Records[r];
+        generate_bitfields(&updated_bits[r], &updates[i], 1);
+    }
+    incremental_classifier_init(&inc, Table_Mask, outputs, Table_Cols, All_IDs.storage, bitfields, record_count);
+    printf("Incremental classifier initial output %s the unique hit policy.\n", outputs_match(unique) ? "matches" : "DOES NOT MATCH");
+    bench_result_t *inc_result = bench_run(&config, &results, "incremental/apply", batch_size, batch_size * sizeof(record_t), [&]()
+    {
+        incremental_apply(&inc, &originals[0], batch_size);
+        incremental_begin_batch(&inc);
+    }, [&]()
+    {
+        incremental_apply(&inc, &updates[0], batch_size);
+    });
+    if (inc_result != NULL)
+    {
+        bench_stats_t inc_stats;
+        bench_compute_stats(inc_result, &inc_stats);
+        double full_sec = bench_median_sec(results, "policy/unique");
+        printf("Applied %u updates in %" PRIu64 " ns median", (uint32_t) batch_size, inc_stats.median_ns);
+        if (full_sec > 0.0)
+            printf(" (%.0fx faster than reclassifying every record)", full_sec * double(NANOS_PER_SECOND) / double(inc_stats.median_ns));
+        printf(".\n");
+    }
+    incremental_apply(&inc, &originals[0], batch_size);
+    incremental_begin_batch(&inc);
+    incremental_apply(&inc, &updates[0], batch_size);
+    {
+        size_t  added = 0, removed = 0;
+        table_t expected[3];
+        for (size_t t = 0; t < 3; ++t)
+        {
+            table_init(&expected[t]);
+        }
+        table_t *expected_outputs[Table_Cols] = { &expected[0], &expected[0], &expected[2], &expected[2], &expected[1] };
+        classify_hit_policy(HIT_POLICY_UNIQUE, Table_Mask, expected_outputs, Table_Cols, NULL, All_IDs.storage, &updated_bits[0], record_count);
+        for (size_t g = 0; g < inc.groups.group_count; ++g)
+        {
+            added   += inc.added  [g].count;
+            removed += inc.removed[g].count;
+        }
+        printf("Incremental output after %u updates (%u IDs added, %u removed) %s a full reclassification.\n",
+            (uint32_t) batch_size, (uint32_t) added, (uint32_t) removed, outputs_match_unordered(expected) ? "matches" : "DOES NOT MATCH");
+
+        // withdraw every other updated record; the tables must then hold the
+        // full reclassification without the withdrawn IDs.
+        std::vector<id_t> withdrawn;
+        for (size_t i = 0; i < batch_size; i += 2)
+        {
+            withdrawn.push_back(updates[i].id);
+        }
+        incremental_begin_batch(&inc);
+        incremental_remove(&inc, withdrawn.data(), withdrawn.size());
+        std::sort(withdrawn.begin(), withdrawn.end());
+        for (size_t t = 0; t < 3; ++t)
+        {
+            size_t n = 0;
+            for (size_t i = 0; i < expected[t].count; ++i)
+            {
+                if (!std::binary_search(withdrawn.begin(), withdrawn.end(), expected[t].storage[i]))
+                    expected[t].storage[n++] = expected[t].storage[i];
+            }
+            expected[t].count = n;
+        }
+        removed = 0;
+        for (size_t g = 0; g < inc.groups.group_count; ++g)
+        {
+            removed += inc.removed[g].count;
+        }
+        printf("Incremental output after withdrawing %u records (%u IDs removed) %s a full reclassification.\n",
+            (uint32_t) withdrawn.size(), (uint32_t) removed, outputs_match_unordered(expected) ? "matches" : "DOES NOT MATCH");
+        for (size_t t = 0; t < 3; ++t)
+        {
+            table_free(&expected[t]);
+        }
+    }
+    incremental_classifier_free(&inc);
+    printf("\n");
+
+    // write the unique outputs as plain and compressed bitmaps.
+    id_t id_limit = 0;
+    for (size_t i = 0; i < record_count; ++i)
+    {
+        id_limit = All_IDs.storage[i] >= id_limit ? All_IDs.storage[i] + 1 : id_limit;
+    }
+    bitset_t         bitsets[3];
+    roaring_bitmap_t roarings[3];
+    for (size_t t = 0; t < 3; ++t)
+    {
+        bitset_init(&bitsets[t], id_limit);
+        roaring_init(&roarings[t]);
+    }
+    bitset_t         *bitset_outputs[Table_Cols]  = { &bitsets[0] , &bitsets[0] , &bitsets[2] , &bitsets[2] , &bitsets[1]  };
+    roaring_bitmap_t *roaring_outputs[Table_Cols] = { &roarings[0], &roarings[0], &roarings[2], &roarings[2], &roarings[1] };
+    classify_bitset_func_t bitset_kernel = simd_level >= SIMD_LEVEL_AVX2 ? classify_bitset_avx2 : classify_bitset;
+    bench_run(&config, &results, "bitmap/bitset", record_count, classify_bytes + bitsets[0].word_count * 3 * sizeof(uint64_t), [&]()
+    {
+        for (size_t t = 0; t < 3; ++t) bitset_clear(&bitsets[t]);
+    }, [&]()
+    {
+        bitset_kernel(Table_Mask, bitset_outputs, Table_Cols, All_IDs.storage, bitfields, record_count);
+    });
+    bench_run(&config, &results, "bitmap/roaring", record_count, classify_bytes, [&]()
+    {
+        for (size_t t = 0; t < 3; ++t) roaring_clear(&roarings[t]);
+    }, [&]()
+    {
+        classify_roaring(Table_Mask, roaring_outputs, Table_Cols, All_IDs.storage, bitfields, record_count, bitset_kernel);
+    });
+    for (size_t t = 0; t < 3; ++t)
+    {
+        bitset_clear(&bitsets[t]);
+        roaring_clear(&roarings[t]);
+    }
+    bitset_kernel   (Table_Mask, bitset_outputs , Table_Cols, All_IDs.storage, bitfields, record_count);
+    classify_roaring(Table_Mask, roaring_outputs, Table_Cols, All_IDs.storage, bitfields, record_count, bitset_kernel);
+    {
+        char const *names[3] = { "Reject", "Manual", "Immediate" };
+        for (size_t t = 0; t < 3; ++t)
+        {
+            table_t decoded[2];
+            table_init(&decoded[0], (uint32_t) bitset_count (&bitsets[t]));
+            table_init(&decoded[1], (uint32_t) roaring_count(&roarings[t]));
+            bitset_for_each (&bitsets[t] , [&decoded](id_t id) { decoded[0].storage[decoded[0].count++] = id; });
+            roaring_for_each(&roarings[t], [&decoded](id_t id) { decoded[1].storage[decoded[1].count++] = id; });
+            printf("%-9s %9u IDs: table %8.2f MB, bitset %8.2f MB, roaring %8.2f MB (%u containers); bitmaps %s the unique hit policy.\n",
+                names[t], (uint32_t) decoded[0].count,
+                double(unique[t].count * sizeof(id_t)) / (1024.0 * 1024.0),
+                double(bitsets[t].word_count * sizeof(uint64_t)) / (1024.0 * 1024.0),
+                double(roaring_bytes(&roarings[t])) / (1024.0 * 1024.0), (uint32_t) roarings[t].containers.size(),
+                (table_equal(&decoded[0], &unique[t]) && table_equal(&decoded[1], &unique[t])) ? "match" : "DO NOT MATCH");
+            table_free(&decoded[1]);
+            table_free(&decoded[0]);
+        }
+
+        // combine actions, for example applicants routed both to immediate
+        // approval and to manual review.
+        bitset_t         set_result;
+        roaring_bitmap_t roaring_result;
+        bitset_init(&set_result, id_limit);
+        roaring_init(&roaring_result);
+        for (int op = 0; op < SET_OP_COUNT; ++op)
+        {
+            bench_timer_t set_time, roaring_time;
+            timer_start(&set_time);
+            if (op == SET_OP_AND)      bitset_and   (&set_result, &bitsets[2], &bitsets[1]);
+            else if (op == SET_OP_OR)  bitset_or    (&set_result, &bitsets[2], &bitsets[1]);
+            else                       bitset_andnot(&set_result, &bitsets[2], &bitsets[1]);
+            size_t set_count = bitset_count(&set_result);
+            timer_stop(&set_time);
+            timer_start(&roaring_time);
+            roaring_set_op(&roaring_result, &roarings[2], &roarings[1], (set_op_e) op);
+            size_t roaring_result_count = roaring_count(&roaring_result);
+            timer_stop(&roaring_time);
+            // equal counts and every roaring ID present in the bitset means
+            // the two results hold the same IDs.
+            bool agree = set_count == roaring_result_count;
+            roaring_for_each(&roaring_result, [&set_result, &agree](id_t id)
+            {
+                agree = agree && id < set_result.bit_count && (set_result.words[id / 64] >> (id % 64)) & 1;
+            });
+            printf("Immediate %-6s Manual: %u IDs; bitset %.1f us, roaring %.1f us; results %s.\n", Set_Op_Names[op], (uint32_t) set_count,
+                double(duration(&set_time)) / 1000.0, double(duration(&roaring_time)) / 1000.0,
+                agree ? "agree" : "DISAGREE");
+        }
+        roaring_free(&roaring_result);
+        bitset_free(&set_result);
+    }
+    for (size_t t = 0; t < 3; ++t)
+    {
+        roaring_free(&roarings[t]);
+        bitset_free(&bitsets[t]);
+        table_free(&unique[t]);
+    }
+    printf("\n");
+
+    // write the outputs as delta-encoded, bit-packed ID lists.
+    packed_id_list_t packed[3];
+    for (size_t t = 0; t < 3; ++t)
+    {
+        packed_ids_init(&packed[t]);
+    }
+    packed_id_list_t *packed_outputs[Table_Cols] = { &packed[0], &packed[0], &packed[2], &packed[2], &packed[1] };
+    bench_run(&config, &results, "packed/classify", record_count, classify_bytes, [&]()
+    {
+        for (size_t t = 0; t < 3; ++t) packed_ids_clear(&packed[t]);
+    }, [&]()
+    {
+        classify_packed(Table_Mask, packed_outputs, Table_Cols, All_IDs.storage, bitfields, record_count);
+    });
+    for (size_t t = 0; t < 3; ++t)
+    {
+        packed_ids_clear(&packed[t]);
+    }
+    classify_packed(Table_Mask, packed_outputs, Table_Cols, All_IDs.storage, bitfields, record_count);
+    {
+        char const *names[3] = { "Reject", "Manual", "Immediate" };
+        table_t     decoded[3];
+        size_t      packed_bytes = 0;
+        size_t      packed_count = 0;
+        for (size_t t = 0; t < 3; ++t)
+        {
+            table_init(&decoded[t], (uint32_t) packed[t].count + 1);
+            packed_bytes += packed_ids_bytes(&packed[t]);
+            packed_count += packed[t].count;
+        }
+        bench_run(&config, &results, "packed/decode", packed_count, packed_bytes + packed_count * sizeof(id_t), no_reset, [&]()
+        {
+            for (size_t t = 0; t < 3; ++t)
+            {
+                packed_ids_decode(&packed[t], decoded[t].storage);
+                decoded[t].count = packed[t].count;
+            }
+        });
+        for (size_t t = 0; t < 3; ++t)
+        {
+            packed_ids_decode(&packed[t], decoded[t].storage);
+            decoded[t].count = packed[t].count;
+            printf("%-9s %9u IDs: table %8.2f MB, packed %8.2f MB (%5.2f bits per ID); decoded list %s the scalar kernel.\n",
+                names[t], (uint32_t) packed[t].count,
+                double(reference[t].count * sizeof(id_t)) / (1024.0 * 1024.0),
+                double(packed_ids_bytes(&packed[t])) / (1024.0 * 1024.0),
+                packed[t].count ? double(packed_ids_bytes(&packed[t]) * 8) / double(packed[t].count) : 0.0,
+                table_equal(&decoded[t], &reference[t]) ? "matches" : "DOES NOT MATCH");
+        }
+        for (size_t t = 0; t < 3; ++t)
+        {
+            table_free(&decoded[t]);
+            packed_ids_free(&packed[t]);
+        }
+    }
+    printf("\n");
+
+    // classify via the truth table compiled from the condition table.
+    lut_classifier_t lut;
+    lut_classifier_build(&lut, Table_Mask, outputs, Table_Cols, Table_Rows, Classify_Kernels[simd_level]);
+    for (int mode = 0; mode < LUT_MODE_COUNT; ++mode)
+    {
+        bench_result_t *r = bench_run(&config, &results, bench_name("lut", Lut_Mode_Names[mode]).c_str(), record_count, classify_bytes, reset_outputs, [&]()
+        {
+            classify_lut(&lut, (lut_mode_e) mode, Table_Mask, outputs, Table_Cols, All_IDs.storage, bitfields, record_count);
+        });
+        if (mode == LUT_MODE_GATHER)
+            bench_report(r, outputs_match(reference), "the scalar kernel");
+        else
+            bench_report(r, outputs_match_unordered(reference), "the scalar kernel (order by bitfield value)");
+    }
+    lut_classifier_free(&lut);
+    size_t lut_columns[2]   = { Table_Cols, 64 };
+    size_t lut_crossover[2] = { 0, 0 };
+    bool   run_crossover    = bench_selected(&config, "lut/crossover");
+    for (size_t c = 0; c < 2 && run_crossover; ++c)
+    {
+        lut_crossover[c] = benchmark_lut_crossover(Classify_Kernels[simd_level], lut_columns[c], record_count < 4000000 ? record_count : 4000000, 3);
+        printf("\n");
+    }
+
+    // choose a kernel per block, on the generated order and on records
+    // sorted by bitfield, where branches become predictable; compare against
+    // each kernel run on every block.
+    if (bench_selected(&config, "adaptive"))
+    {
+        lut_classifier_t      adaptive_lut;
+        adaptive_classifier_t adaptive;
+        lut_classifier_build(&adaptive_lut, Table_Mask, outputs, Table_Cols, Table_Rows, Classify_Kernels[simd_level]);
+        adaptive_classifier_init(&adaptive, Classify_Kernels[simd_level], &adaptive_lut);
+
+        std::vector<std::pair<uint32_t, id_t> > order(record_count);
+        for (size_t i = 0; i < record_count; ++i)
+        {
+            order[i] = std::make_pair(bitfields[i], All_IDs.storage[i]);
+        }
+        std::stable_sort(order.begin(), order.end(), [](std::pair<uint32_t, id_t> const &a, std::pair<uint32_t, id_t> const &b) { return a.first < b.first; });
+        std::vector<uint32_t> sorted_bits(record_count);
+        std::vector<id_t>     sorted_ids (record_count);
+        for (size_t i = 0; i < record_count; ++i)
+        {
+            sorted_bits[i] = order[i].first;
+            sorted_ids [i] = order[i].second;
+        }
+        std::vector<std::pair<uint32_t, id_t> >().swap(order);
+
+        char const     *dataset_names[2] = { "generated", "sorted" };
+        uint32_t const *dataset_bits [2] = { bitfields, &sorted_bits[0] };
+        id_t const     *dataset_ids  [2] = { All_IDs.storage, &sorted_ids[0] };
+        FILE           *log_fp           = adaptive_log ? fopen(adaptive_log, "w") : NULL;
+        if (log_fp != NULL)
+        {
+            fprintf(log_fp, "dataset,first,count,selectivity,transitions,class,kernel,explored,cycles_per_record\n");
+        }
+        for (size_t ds = 0; ds < 2; ++ds)
+        {
+            table_t expected[3];
+            for (size_t t = 0; t < 3; ++t)
+            {
+                table_init(&expected[t], (uint32_t)(record_count * 2));
+            }
+            table_t *expected_outputs[Table_Cols] = { &expected[0], &expected[0], &expected[2], &expected[2], &expected[1] };
+            classify(Table_Mask, expected_outputs, Table_Cols, dataset_ids[ds], dataset_bits[ds], record_count);
+
+            double best_fixed = 0.0;
+            int    best_k     = -1;
+            for (int k = -1; k < ADAPTIVE_KERNEL_COUNT; ++k)
+            {
+                if (k == ADAPTIVE_KERNEL_LUT && adaptive.lut == NULL)
+                {
+                    continue;
+                }
+                std::string variant = std::string(dataset_names[ds]) + "-" + (k < 0 ? "auto" : Adaptive_Kernel_Names[k]);
+                std::string name    = bench_name("adaptive", variant.c_str());
+                adaptive.forced     = k;
+                run = bench_run(&config, &results, name.c_str(), record_count, classify_bytes, reset_outputs, [&]()
+                {
+                    classify_adaptive(&adaptive, Table_Mask, outputs, Table_Cols, dataset_ids[ds], dataset_bits[ds], record_count);
+                });
+                bench_report(run, outputs_match(expected), "the scalar kernel");
+                double sec = bench_median_sec(results, name);
+                if (k >= 0 && sec > 0.0 && (best_k < 0 || sec < best_fixed))
+                {
+                    best_fixed = sec;
+                    best_k     = k;
+                }
+            }
+
+            // report the decisions made for the final adaptive pass.
+            adaptive.forced = -1;
+            reset_outputs();
+            classify_adaptive(&adaptive, Table_Mask, outputs, Table_Cols, dataset_ids[ds], dataset_bits[ds], record_count);
+            size_t chosen[ADAPTIVE_KERNEL_COUNT] = { 0 };
+            size_t explored = 0;
+            for (size_t b = 0; b < adaptive.decisions.size(); ++b)
+            {
+                adaptive_decision_t const &d = adaptive.decisions[b];
+                chosen[d.kernel]++;
+                explored += d.explored;
+                if (log_fp != NULL)
+                {
+                    fprintf(log_fp, "%s,%u,%u,%.4f,%.4f,%u,%s,%u,%.2f\n", dataset_names[ds], d.first, d.count, d.selectivity, d.transitions,
+                        (uint32_t) d.block_class, Adaptive_Kernel_Names[d.kernel], (uint32_t) d.explored, d.cycles);
+                }
+            }
+            printf("Adaptive (%s): %u blocks;", dataset_names[ds], (uint32_t) adaptive.decisions.size());
+            for (int k = 0; k < ADAPTIVE_KERNEL_COUNT; ++k)
+            {
+                if (chosen[k]) printf(" %s %u,", Adaptive_Kernel_Names[k], (uint32_t) chosen[k]);
+            }
+            printf(" %u explored.\n", (uint32_t) explored);
+            double auto_sec = bench_median_sec(results, bench_name("adaptive", (std::string(dataset_names[ds]) + "-auto").c_str()));
+            if (auto_sec > 0.0 && best_k >= 0)
+            {
+                printf("Adaptive (%s): %.3f ms vs best fixed kernel (%s) %.3f ms, %+.1f%%.\n", dataset_names[ds], auto_sec * 1000.0,
+                    Adaptive_Kernel_Names[best_k], best_fixed * 1000.0, (best_fixed / auto_sec - 1.0) * 100.0);
+            }
+            printf("\n");
+            for (size_t t = 0; t < 3; ++t)
+            {
+                table_free(&expected[t]);
+            }
+        }
+        if (log_fp != NULL)
+        {
+            fclose(log_fp);
+        }
+        lut_classifier_free(&adaptive_lut);
+    }
+
+    // classify via the decision diagram compiled from the condition table.
+    decision_diagram_t dd;
+    decision_diagram_build(&dd, &Condition_Table[0][0], outputs, Table_Cols, Table_Rows, Classify_Kernels[simd_level]);
+    printf("Decision diagram has %u nodes, %u leaves.\n", (uint32_t) dd.node_count, (uint32_t) dd.leaf_count);
+    run = bench_run(&config, &results, "dd/table", record_count, classify_bytes, reset_outputs, [&]()
+    {
+        classify_decision_diagram(&dd, Table_Mask, outputs, Table_Cols, All_IDs.storage, bitfields, record_count);
+    });
+    bench_report(run, outputs_match(reference), "the scalar kernel");
+    decision_diagram_free(&dd);
+    if (bench_selected(&config, "dd/random"))
+    {
+        printf("Decision diagram vs %s mask kernel on random rulebooks:\n", Simd_Level_Names[simd_level]);
+        for (size_t rules = 16; rules <= 1024; rules *= 4)
+        {
+            benchmark_decision_diagram(Classify_Kernels[simd_level], rules, 24, record_count < 2000000 ? record_count : 2000000, 1);
+        }
+        printf("\n");
+    }
+
+    // measure the cost of wider condition rows.
+    if (bench_selected(&config, "width/all"))
+    {
+        size_t width_check_count = record_count < 1000000 ? record_count : 1000000;
+        bool   width_match       = verify_bitfield_width<uint64_t >(&Records[0], All_IDs.storage, width_check_count) &&
+                                   verify_bitfield_width<bits128_t>(&Records[0], All_IDs.storage, width_check_count) &&
+                                   verify_bitfield_width<bits256_t>(&Records[0], All_IDs.storage, width_check_count);
+        printf("Wide bitfield output %s the 32-bit kernel.\n", width_match ? "matches" : "DOES NOT MATCH");
+        benchmark_bitfield_widths(16, record_count < 4000000 ? record_count : 4000000, 3);
+        printf("\n");
+    }
+
+    // compare regenerating the bitfield array on every pass against fusing
+    // predicate evaluation into the classify loop one block at a time.
+    run = bench_run(&config, &results, "pipeline/precomputed", record_count, pipeline_bytes_per_pass(PIPELINE_PRECOMPUTED, record_count, true), reset_outputs, [&]()
+    {
+        generate_bitfields(bitfields, &Records[0], record_count);
+        Classify_Kernels[simd_level](Table_Mask, outputs, Table_Cols, All_IDs.storage, bitfields, record_count);
+    });
+    bench_report(run, outputs_match(reference), "the scalar kernel");
+    run = bench_run(&config, &results, "pipeline/fused", record_count, pipeline_bytes_per_pass(PIPELINE_FUSED, record_count, true), reset_outputs, [&]()
+    {
+        classify_fused(Classify_Kernels[simd_level], Table_Mask, outputs, Table_Cols, All_IDs.storage, &Records[0], record_count, block_size);
+    });
+    bench_report(run, outputs_match(reference), "the scalar kernel");
+    run = bench_run(&config, &results, "pipeline/fused-soa", record_count, uint64_t(double(record_count) * record_store_bytes_per_record()), reset_outputs, [&]()
+    {
+        classify_fused(Classify_Kernels[simd_level], Table_Mask, outputs, Table_Cols, &Record_Store, block_size);
+    });
+    bench_report(run, outputs_match(reference), "the scalar kernel");
+
+    bench_print(results);
+    printf("\n");
+    for (size_t c = 0; c < 2 && run_crossover; ++c)
+    {
+        if (lut_crossover[c])
+            printf("LUT crossover (%2u columns): mask kernel faster from %u condition rows.\n", (uint32_t) lut_columns[c], (uint32_t) lut_crossover[c]);
+        else
+            printf("LUT crossover (%2u columns): LUT faster for every measured width.\n", (uint32_t) lut_columns[c]);
+    }
+    printf("Classify only     (%-11s) moves ~%.1f MB per pass once bitfields are built.\n", Pipeline_Mode_Names[PIPELINE_PRECOMPUTED],
+        double(pipeline_bytes_per_pass(PIPELINE_PRECOMPUTED, record_count, false)) / (1024.0 * 1024.0));
+    double scaling_base = bench_median_sec(results, scaling_names[0]);
+    for (size_t i = 0; i < scaling_threads.size(); ++i)
+    {
+        double seconds = bench_median_sec(results, scaling_names[i]);
+        if (seconds > 0.0 && scaling_base > 0.0)
+        {
+            printf("Parallel %-8s on %3u thread(s) took: %f seconds (%.2fx).\n", Simd_Level_Names[simd_level],
+                (uint32_t) scaling_threads[i], seconds, scaling_base / seconds);
+        }
+    }
+    if (json_path != NULL)
+    {
+        if (bench_write_json(json_path, &config, results, record_count, &gen, Simd_Level_Names[simd_level]))
+            printf("Wrote results to %s.\n", json_path);
+        else
+            printf("ERROR: Unable to write results to %s.\n", json_path);
+    }
+
+    perf_counters_close(&config.counters);
+    record_file_close(&record_file);
+    for (size_t a = 0; a < ACTION_COUNT; ++a)
+    {
+        table_free(&priority_reference[a]);
+        table_free(&first_reference[a]);
+    }
+    table_free(&reference[2]);
+    table_free(&reference[1]);
+    table_free(&reference[0]);
+    memory_free(bitfields, bitfield_bytes);
+    record_store_free(&Record_Store);
+    table_free(&All_IDs);
+    table_free(&Output_Reject);
+    table_free(&Output_Manual);
+    table_free(&Output_Immediate);
+
+    return 0;
+}